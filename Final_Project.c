@@ -10,63 +10,71 @@
 #include "pico/stdlib.h"
 #include "hardware/i2c.h"
 #include "hardware/timer.h"
+#include "hardware/irq.h"
 #include "pico/multicore.h"
 #include "pt_cornell_rp2040_v1_4.h"
 #include "TFTMaster.h"
 #include "dac.h"
 #include "adc.h"
 #include "trigger.h"
-
-// ==========================================
-// --- ROTARY ENCODER DEFINITIONS ---
-// ==========================================
-#define PICO_ENC_CLK    14
-#define PICO_ENC_DT     15
-#define PICO_ENC_SW     6
-
-// --- I2C/Seesaw Definitions ---
-#define SEESAW_I2C_ADDR         0x50 
-#define I2C_PORT                i2c1  
-#define I2C_SDA_PIN             2     
-#define I2C_SCL_PIN             3     
-
-// Seesaw Registers
-#define SEESAW_GPIO_BASE        0x01
-#define SEESAW_GPIO_BULK_SET    0x05 
-#define SEESAW_GPIO_BULK        0x04 
-#define SEESAW_ADC_BASE         0x09
-#define SEESAW_ADC_OFFSET       0x07
-
-// --- PIN MAPPING (Adafruit Mini Gamepad PID 5743) ---
-#define PIN_BTN_SELECT  0
-#define PIN_BTN_B       1   
-#define PIN_BTN_Y       2   
-#define PIN_BTN_A       5   
-#define PIN_BTN_X       6   
-#define PIN_BTN_START   16
-#define PIN_JOY_X       14
-#define PIN_JOY_Y       15
-
-// Bitmasks
-#define MASK_SELECT     (1UL << PIN_BTN_SELECT)
-#define MASK_B          (1UL << PIN_BTN_B)
-#define MASK_Y          (1UL << PIN_BTN_Y)
-#define MASK_A          (1UL << PIN_BTN_A)
-#define MASK_X          (1UL << PIN_BTN_X)
-#define MASK_START      (1UL << PIN_BTN_START)
+#include "seesaw.h"
+#include "rotary.h"
+#include "input.h"
+#include "ui.h"
+#include "scale.h"
+#include "stream.h"
+#include "scpi.h"
+#include "measure.h"
+#include "recorder.h"
+#include "segments.h"
+#include "deep.h"
+#include "viewer.h"
+#include "interp.h"
+#include "ets.h"
+#include "persist.h"
+#include "awg.h"
+#include "autoset.h"
+#include "calib.h"
+#include "settings.h"
+#include "hist.h"
+#include "mask.h"
+#include "decode.h"
+#include "xy.h"
+#include "multi.h"
 
 // Logical Buttons
-#define BTN_CONFIRM     MASK_B      
-#define BTN_BACK        MASK_A      
-#define BTN_MENU        MASK_SELECT 
-#define BTN_RECORD      MASK_START  
-#define BTN_FFT         MASK_X      
-
-// Joystick Constants
-#define JOY_CENTER      512         
-#define JOY_DEADZONE    400         
-#define JOY_THRESHOLD_HIGH (JOY_CENTER + JOY_DEADZONE) 
-#define JOY_THRESHOLD_LOW  (JOY_CENTER - JOY_DEADZONE) 
+#define BTN_CONFIRM     KEY_B
+#define BTN_BACK        KEY_A
+#define BTN_MENU        KEY_SELECT
+#define BTN_RECORD      KEY_START
+#define BTN_FFT         KEY_X
+#define BTN_REPLAY      KEY_Y
+
+// Frame pacing
+#define FRAME_PERIOD_US      16667      // 60FPS
+#define IDLE_FRAME_PERIOD_US 100000     // 10FPS once idle
+#define IDLE_TIMEOUT_US      10000000   // no input for this long = idle
+#define ENCODER_POLL_US      2000
+#define IDLE_ENCODER_POLL_US 20000
+#define REPLAY_MAX_GAP_US    1000000    // long pauses in a recording play back as 1s
+#define VIEW_PAN_COLUMNS     8          // stopped view pan per encoder detent
+#define PERSIST_FLUSH_COLUMNS 96        // persistence columns sent to the panel per frame
+
+// Histogram view: one column per code
+#define HIST_X               32
+#define HIST_BOTTOM          220
+#define HIST_HEIGHT          180
+#define HIST_STATS_US        250000     // stats text refresh
+
+// Auto trigger level and auto-setup
+#define AUTOLEVEL_PERIOD_US  50000      // level tracker snapshot rate
+#define AUTOSET_SNAPSHOTS    8          // merged per gain step, so slow signals show their swing
+#define AUTOSET_SNAPSHOT_US  5000
+#define AUTOSET_SETTLE_US    20000      // relay and front end after a gain change
+#define AUTOSET_GAIN_PASSES  3
+#define AUTOSET_PERIODS      3          // cycles across the plot
+#define AUTOSET_HALF_DIVS    2.0f       // divisions from the center line to the plot edge
+#define AUTOSET_MAX_TDIV     10.0f      // past this the plot runs out of samples
 
 // Colors 
 #define TFT_BLACK       ILI9340_BLACK
@@ -89,6 +97,33 @@ float timePerDiv = 10.0;
 bool showCursors = false;
 float cursorV1_volts = 2.5;
 float cursorV2_volts = 0.5;
+int interpMode = INTERP_SINC;   // how columns between samples are filled in
+
+// --- Persistence ---
+enum PersistMode {
+    PERSIST_OFF = 0,
+    PERSIST_500MS,
+    PERSIST_1S,
+    PERSIST_2S,
+    PERSIST_5S,
+    PERSIST_INFINITE,
+    PERSIST_MODE_COUNT
+};
+
+const char* persistNames[] = { "OFF", "0.5s", "1s", "2s", "5s", "INF" };
+// Time for a fully lit pixel to fade out, 0 = never
+const uint16_t persistTimesMs[] = { 0, 500, 1000, 2000, 5000, 0 };
+
+#define RGB565(r, g, b) ((((r) & 0xF8) << 8) | (((g) & 0xFC) << 3) | ((b) >> 3))
+// Hit level -> color, cold to hot. Level 0 is the bare grid.
+const uint16_t persistPalette[PERSIST_LEVELS] = {
+    0,                      RGB565(0, 0, 96),       RGB565(0, 0, 160),      RGB565(0, 0, 255),
+    RGB565(0, 96, 255),     RGB565(0, 160, 255),    RGB565(0, 255, 255),    RGB565(0, 255, 160),
+    RGB565(0, 255, 0),      RGB565(160, 255, 0),    RGB565(255, 255, 0),    RGB565(255, 192, 0),
+    RGB565(255, 128, 0),    RGB565(255, 0, 0),      RGB565(255, 128, 128),  RGB565(255, 255, 255)
+};
+
+int persistMode = PERSIST_OFF;
 
 // --- Gain Settings (FIXED) ---
 #define SCOPE_GAIN_LOW  0
@@ -96,7 +131,48 @@ float cursorV2_volts = 0.5;
 #define SCOPE_GAIN_HIGH 2
 
 int currentGainMode = SCOPE_GAIN_MED; 
-float hardwareGainFactor = 0.39; // Default for Med
+float hardwareGainFactor = 0.39; // Default for Med, calibrated value set by updateGainState
+float gainFactors[CALIB_MODES];
+
+// Trigger comparator threshold, at the ADC pin (so it tracks the gain)
+float triggerPinVolts = 1.65f;
+bool autoTrigLevel = false;     // keep it at the 50% point of the signal
+bool autosetPending = false;
+
+// Calibration asks for the probe on the offset output before it starts
+bool calibPrompt = false;
+#define CALIB_POLL_US 1000
+
+#define SETTINGS_POLL_US 250000
+
+// --- Function Generator ---
+// Shape names, in awg_shape_t order. The rest of its state lives in awg.c.
+const char* awgNames[] = { "OFF", "SINE", "SQUARE", "TRI", "SWEEP", "ARB" };
+
+// --- Mask Testing ---
+enum MaskMode {
+    MASK_OFF = 0,
+    MASK_ON,            // count passes and fails
+    MASK_STOP,          // and stop on the first fail, holding it on screen
+    MASK_MODE_COUNT
+};
+const char* maskNames[] = { "OFF", "ON", "STOP" };
+int maskMode = MASK_OFF;
+bool maskExport = false;        // failing frames also go out over USB
+#define MASK_LEARN_TOL 8        // codes either side of a learned trace
+
+// --- Protocol Decode ---
+const char* decodeNames[] = { "OFF", "UART", "I2C", "SPI" };
+int decodeMode = DECODE_OFF;
+uint32_t decodeBaud = 0;            // UART, 0 measures it
+bool decodeRequest = false;     // what's shown changed, decode it again
+uint32_t decodeGen = 0;             // bumped when a decode finishes
+bool isDecodeTable = false;
+uint32_t decodeSeam = 0;            // frame_buf slot the live decode started from
+int decodeScroll = 0;
+#define DECODE_CHUNK      512       // samples per slice of a long decode
+#define DECODE_TABLE_ROWS 20
+#define DECODE_STRIP_H    9         // byte labels along the bottom of the plot
 
 // --- Menu System ---
 enum MenuIndex {
@@ -107,29 +183,89 @@ enum MenuIndex {
     MENU_CURSORS_EN,
     MENU_CUR_V1,
     MENU_CUR_V2,
+    MENU_ACQ_MODE,
+    MENU_INTERP,
+    MENU_PERSIST,
+    MENU_AUTOSET,
+    MENU_TRIG_AUTO,
+    MENU_TRIG_LEVEL,
+    MENU_GEN,
+    MENU_GEN_FREQ,
+    MENU_CALIBRATE,
+    MENU_MASK,
+    MENU_DECODE,
+    MENU_CHANNELS,
+    MENU_TRIG_SRC,
     MENU_COUNT 
 };
 
 const char* menuNames[] = {
-    "Run/Stop", "V / Div", "T / Div", "Gain", "Cursors", "Cur V1", "Cur V2"
+    "Run/Stop", "V / Div", "T / Div", "Gain", "Cursors", "Cur V1", "Cur V2", "Acquire", "Interp", "Persist",
+    "Autoset", "Trig Auto", "Trig Lvl", "Gen", "Gen Hz", "Calibrate",
+    "Mask", "Decode", "Channels", "Trig Src"
 };
 
+// Rows that fit on screen, the list scrolls past that
+#define MENU_VISIBLE_ROWS 7
+
+// --- Acquisition Modes ---
+enum AcqMode {
+    ACQ_NORMAL = 0,     // continuous, one frame per trigger
+    ACQ_SEGMENTED,      // a burst of short segments, shown when complete
+    ACQ_DEEP,           // one long single-shot record to zoom and pan through
+    ACQ_ETS,            // repetitive signals rebuilt at ETS_FACTOR x the ADC rate
+    ACQ_XY,             // probe against a second input, free-running
+    ACQ_MULTI,          // two or three inputs sharing the ADC, one trace each
+    ACQ_COUNT
+};
+
+const char* acqNames[] = { "NORMAL", "SEGMENT", "DEEP", "EQUIV", "XY", "MULTI" };
+#define XY_FADE_MS 500          // XY fades even with persistence off
+
+// --- Multi-channel ---
+// CH1 is the probe at the current V/div. CH2 and CH3 are GPIO27 and
+// GPIO28 read at the pin, each with its own scale and position.
+int multiChannels = 2;
+int multiTrigSrc = 0;
+float chanVoltsPerDiv[MULTI_MAX_CHANNELS] = { 0.0f, 1.0f, 1.0f };     // CH1 uses voltsPerDiv
+float chanOffset[MULTI_MAX_CHANNELS] = { 0.0f, 0.0f, 0.0f };
+const uint16_t chanColors[MULTI_MAX_CHANNELS] = { TFT_YELLOW, TFT_CYAN, TFT_MAGENTA };
+
 // --- State Machine ---
 bool isMenuOpen = false;
 bool isEditing = false; 
 int selectedMenuItem = 0;
+int menuScroll = 0;
+int acqMode = ACQ_NORMAL;
+int segSelected = -1;   // segment shown on its own, -1 overlays them all
+
+
+// --- Stopped Viewer ---
+// What the encoder adjusts, stepped through with the encoder switch
+enum ViewKnob {
+    KNOB_H_PAN = 0,
+    KNOB_H_ZOOM,
+    KNOB_V_PAN,
+    KNOB_V_ZOOM,
+    KNOB_COUNT
+};
+
+const char* knobNames[] = { "PAN", "ZOOM", "V-PAN", "V-ZOOM" };
+
+#define VIEW_MAX_V_ZOOM 4
+
+bool isViewing = false;     // a finished acquisition is on screen to inspect
+int viewKnob = KNOB_H_PAN;
+int viewVZoom = 0;          // trace stretched 1 << viewVZoom times vertically
+float viewVOffset = 0.0f;   // volts moved onto the center line
+bool viewDirty = false;     // pan/zoom moved, columns need updating
+
 bool forceFullRedraw = true; 
 bool isRecording = false; 
-bool menuDirty = true; 
+bool isReplaying = false;
 
 // --- Input State ---
-bool btnMenuPressed = false;
-bool btnConfirmPressed = false; 
-bool btnBackPressed = false;    
-bool btnRecordPressed = false;  
-bool joyUpHeld = false;
-bool joyDownHeld = false;
-bool encSwPressed = false; 
+bool inputIdle = false;
 
 // --- Waveform Buffer ---
 short oldWaveY[320]; 
@@ -141,7 +277,10 @@ int8_t real_component[NUM_SAMPLES];
 int8_t imag_component[NUM_SAMPLES];
 int fft_output[NUM_SAMPLES/2];   
 bool isFFTMode = false;
-bool btnXPressed = true; 
+
+// --- Histogram Variables ---
+bool isHistMode = false;
+short histDrawn[HIST_BINS];     // bar heights on the panel
 float hanning_window[NUM_SAMPLES];
 bool windowInitialized = false;
 
@@ -158,9 +297,6 @@ bool gameOver = false;
 bool gameOverDrawn = false; // Prevents Flicker
 absolute_time_t lastSnakeMove;
 
-// --- Rotary Encoder Global ---
-volatile int rotaryDelta = 0;
-
 // semaphore
 struct pt_sem trigger_semaphore ;
 
@@ -171,33 +307,31 @@ void updateSnake();
 void drawSnake();
 
 // ==========================================
-// --- INTERRUPT FOR ENCODER ---
+// --- INTERRUPT FOR TRIGGER ---
 // ==========================================
-void gpio_callback(uint gpio, uint32_t events) {
-    if (gpio == PICO_ENC_CLK) {
-        if (gpio_get(PICO_ENC_DT)) {
-            rotaryDelta--;
-        } else {
-            rotaryDelta++;
+// The encoder is decoded by PIO now, so the trigger has this ISR to itself.
+// In RAM like ets_trigger_isr, a flash cache miss here would skew the ETS phase.
+void __time_critical_func(gpio_callback)(uint gpio, uint32_t events) {
+    if (gpio == TRIG){
+        if (acqMode == ACQ_SEGMENTED) {
+            seg_trigger_isr();
+            return;
+        }
+        if (acqMode == ACQ_DEEP) {
+            deep_trigger_isr();
+            return;
+        }
+        if (acqMode == ACQ_ETS) {
+            ets_trigger_isr();
+            return;
         }
-    } else if (gpio == TRIG){
+        // Free-running, or triggered in software on core 1
+        if (acqMode == ACQ_XY || acqMode == ACQ_MULTI) return;
         trigger_isr();
         PT_SEM_SIGNAL(pt, &trigger_semaphore);
     }
 }
 
-// --- Helper Functions ---
-void seesaw_pin_mode_bulk(uint32_t pins);
-uint32_t seesaw_read_buttons();
-uint16_t seesaw_read_analog(uint8_t pin);
-
-void rotary_init() {
-    gpio_init(PICO_ENC_CLK); gpio_set_dir(PICO_ENC_CLK, GPIO_IN); gpio_pull_up(PICO_ENC_CLK);
-    gpio_init(PICO_ENC_DT);  gpio_set_dir(PICO_ENC_DT, GPIO_IN);  gpio_pull_up(PICO_ENC_DT);
-    gpio_init(PICO_ENC_SW);  gpio_set_dir(PICO_ENC_SW, GPIO_IN);  gpio_pull_up(PICO_ENC_SW); 
-    gpio_set_irq_enabled_with_callback(PICO_ENC_CLK, GPIO_IRQ_EDGE_RISE, true, &gpio_callback);
-}
-
 // --- UPDATE GAIN HELPER ---
 void updateGainState(int direction) {
     int nextMode = currentGainMode + direction;
@@ -207,63 +341,82 @@ void updateGainState(int direction) {
     currentGainMode = nextMode;
     set_gain((gain_mode_t)currentGainMode); 
     
-    switch(currentGainMode) {
-        case SCOPE_GAIN_LOW:  hardwareGainFactor = 0.21f; break;
-        case SCOPE_GAIN_MED:  hardwareGainFactor = 0.39f; break;
-        case SCOPE_GAIN_HIGH: hardwareGainFactor = 1.98f; break;
-    }
+    for (int i = 0; i < CALIB_MODES; i++) gainFactors[i] = calib_gain_factor(i);
+    hardwareGainFactor = gainFactors[currentGainMode];
+}
+
+// Trigger level is set at the pin but shown at the probe
+float pinToProbeVolts(float pin) {
+    return calib_pin_to_probe(currentGainMode, pin);
 }
 
 // --- ADC TO VOLT ---
-float raw_to_real_volts(uint8_t raw_val) {
-    float pin_voltage = (raw_val / 255.0f) * 3.3f;
-    return pin_voltage / hardwareGainFactor;
+// V/div the plot is drawn at, the same figure for the trace, cursors and
+// labels. The stopped viewer's zoom can't go finer than the scale tables.
+float shownVoltsPerDiv() {
+    float vdiv = isViewing ? voltsPerDiv / (1 << viewVZoom) : voltsPerDiv;
+    return (vdiv < SCALE_MIN_VOLTS_PER_DIV) ? SCALE_MIN_VOLTS_PER_DIV : vdiv;
 }
 
-short voltToPixel(float volts) {
-    float centerVolts = 1.65f / hardwareGainFactor; 
-    float pixelsPerDiv = 48.0;
+// Rebuild the sample->pixel tables if the vertical settings moved.
+// The stopped viewer can stretch and shift the trace on top of V/div.
+void updateScale() {
     if (voltsPerDiv < 0.1) voltsPerDiv = 0.1;
-    
-    float diff = volts - centerVolts;
-    float divsFromCenter = diff / voltsPerDiv;
-    short y = 120 - (short)(divsFromCenter * pixelsPerDiv);
-    return y;
+    const calib_gain_t *cal = calib_get(currentGainMode);
+    scale_update(shownVoltsPerDiv(), cal->uv_per_code, cal->zero_q8, isViewing ? viewVOffset : 0.0f);
+}
+
+short voltToPixel(float volts) {
+    updateScale();
+    return scale_volts_to_y(volts);
 }
 
 // --- Drawing Functions ---
 #define PIXELS_PER_DIV 48 
+#define GRID_CENTER_Y  120
+#define GRID_AXIS_COLOR 0x7BEF
 
-void drawGrid(short width) {
-    tft_fillRect(0, 0, width, 240, TFT_BLACK);
-    tft_setTextSize(1);
-    tft_setTextColor(TFT_LIGHTGREY);
+short scopeWidth = 320; // plot width, the menu takes the right 80px when open
 
-    short centerX = width / 2;
-    short centerY = 120;
-    float trueCenterV = 1.65f / hardwareGainFactor;
+static void vLineClipped(short lx, short ly, short lh, uint16_t color, short x, short y, short w, short h) {
+    if (lx < x || lx >= x + w) return;
+    short y0 = (ly < y) ? y : ly;
+    short y1 = (ly + lh > y + h) ? (y + h) : (ly + lh);
+    if (y1 > y0) tft_drawFastVLine(lx, y0, y1 - y0, color);
+}
+
+static void hLineClipped(short lx, short ly, short lw, uint16_t color, short x, short y, short w, short h) {
+    if (ly < y || ly >= y + h) return;
+    short x0 = (lx < x) ? x : lx;
+    short x1 = (lx + lw > x + w) ? (x + w) : (lx + lw);
+    if (x1 > x0) tft_drawFastHLine(x0, ly, x1 - x0, color);
+}
 
+// Bare grid (no labels) inside a rectangle. This is the background layer
+// the compositor paints under anything that gets redrawn.
+void drawGridRegion(short x, short y, short w, short h) {
+    if (x < 0) { w += x; x = 0; }
+    if (y < 0) { h += y; y = 0; }
+    if (x + w > scopeWidth) w = scopeWidth - x;
+    if (y + h > 240) h = 240 - y;
+    if (w <= 0 || h <= 0) return;
+
+    tft_fillRect(x, y, w, h, TFT_BLACK);
+
+    short centerX = scopeWidth / 2;
     for (int i = -4; i <= 4; i++) {
-        short x = centerX + (i * PIXELS_PER_DIV);
-        if (x > 0 && x < width) {
-            uint16_t color = (i == 0) ? 0x7BEF : TFT_DARKGREY;
-            tft_drawFastVLine(x, 0, 240, color);
-            tft_drawFastVLine(x, centerY - 4, 9, TFT_WHITE); 
-            float t = (float)i * timePerDiv; 
-            char buf[10]; sprintf(buf, "%.0f", t); 
-            tft_setCursor(x + 2, 230); tft_writeString(buf);
+        short gx = centerX + (i * PIXELS_PER_DIV);
+        if (gx > 0 && gx < scopeWidth) {
+            uint16_t color = (i == 0) ? GRID_AXIS_COLOR : TFT_DARKGREY;
+            vLineClipped(gx, 0, 240, color, x, y, w, h);
+            vLineClipped(gx, GRID_CENTER_Y - 4, 9, TFT_WHITE, x, y, w, h);
         }
     }
     for (int i = -2; i <= 2; i++) {
-        short y = centerY + (i * PIXELS_PER_DIV);
-        if (y >= 0 && y < 240) {
-            uint16_t color = (i == 0) ? 0x7BEF : TFT_DARKGREY;
-            tft_drawFastHLine(0, y, width, color);
-            tft_drawFastHLine(centerX - 4, y, 9, TFT_WHITE); 
-            float v = trueCenterV - ((float)i * voltsPerDiv);
-            char buf[10]; sprintf(buf, "%.1fV", v);
-            tft_setCursor(2, y - 10); tft_writeString(buf);
-        }
+        short gy = GRID_CENTER_Y + (i * PIXELS_PER_DIV);
+        uint16_t color = (i == 0) ? GRID_AXIS_COLOR : TFT_DARKGREY;
+        hLineClipped(0, gy, scopeWidth, color, x, y, w, h);
+        hLineClipped(centerX - 4, gy, 9, TFT_WHITE, x, y, w, h);
     }
 }
 
@@ -273,35 +426,42 @@ void drawGrid(short width) {
 #define MARGIN_TOP    25
 #define MARGIN_BOTTOM 20
 
+// Last column the trace reached, and whether oldWaveY holds a real trace yet
+short traceEndX = MARGIN_LEFT;
+bool traceValid = false;
+
+// Sample shown at each column, interpolated when columns outnumber samples
+uint8_t columnSample[320];
+
+// Fill columnSample from frame_buf, column x showing sample x * timeScale.
+// Returns the first column past the end of the data.
+int sampleColumns(short width) {
+    float timeScale = timePerDiv / 10.0f;
+    // Rounded: a truncated step walks off the time labels across the plot
+    uint32_t step = (uint32_t)(timeScale * (1 << INTERP_FRAC_BITS) + 0.5f);
+    int mode = (timeScale < 1.0f) ? interpMode : INTERP_NONE;
+    return MARGIN_LEFT + interp_resample(frame_buf, CAPTURE_DEPTH, MARGIN_LEFT * step, step,
+                                         &columnSample[MARGIN_LEFT], width - MARGIN_RIGHT - MARGIN_LEFT, mode);
+}
+
 // Optimized Waveform Drawer 
 void drawWaveformFromBuffer(short width) {
-    float timeScale = timePerDiv / 10.0f; 
     short centerX = width / 2;
     short centerY = 120;
     const int hGridYs[] = {120, 72, 24, 168, 216};
     const int numHGrids = 5;
 
     int prevX = MARGIN_LEFT;
-    int buffIdx0 = (int)(prevX * timeScale); 
-    if (buffIdx0 >= CAPTURE_DEPTH) buffIdx0 = CAPTURE_DEPTH - 1;
+    int lastX = sampleColumns(width);
+    if (lastX == MARGIN_LEFT) return;
 
-    float firstVolts = raw_to_real_volts(frame_buf[buffIdx0]);
-    int prevY_new = voltToPixel(firstVolts);
-    
-    if (prevY_new < MARGIN_TOP) prevY_new = MARGIN_TOP;
-    if (prevY_new > 240 - MARGIN_BOTTOM) prevY_new = 240 - MARGIN_BOTTOM;
+    updateScale();
+    int prevY_new = scale_raw_to_y(columnSample[MARGIN_LEFT]);
 
     int prevY_old = oldWaveY[prevX]; 
 
-    for (int x = MARGIN_LEFT + 1; x < width - MARGIN_RIGHT; x++) {
-        int buffIdx = (int)(x * timeScale);
-        if (buffIdx >= CAPTURE_DEPTH) break; 
-        
-        float volts = raw_to_real_volts(frame_buf[buffIdx]);
-        int currY_new = voltToPixel(volts);
-        
-        if (currY_new < MARGIN_TOP) currY_new = MARGIN_TOP;
-        if (currY_new > 240 - MARGIN_BOTTOM) currY_new = 240 - MARGIN_BOTTOM;
+    for (int x = MARGIN_LEFT + 1; x < lastX; x++) {
+        int currY_new = scale_raw_to_y(columnSample[x]);
 
         int currY_old = oldWaveY[x]; 
 
@@ -329,65 +489,920 @@ void drawWaveformFromBuffer(short width) {
         prevY_old = currY_old; 
     }
     if (prevX < 320) oldWaveY[prevX] = prevY_new;
+    traceEndX = prevX;
+    traceValid = true;
+}
+
+// --- PERSISTENCE ---
+bool persistActive() {
+    if (acqMode == ACQ_XY) return true;
+    return persistMode != PERSIST_OFF && acqMode == ACQ_NORMAL && !isViewing;
 }
 
-void restoreCursorBg(short y, short width) {
-    if (y < 0 || y >= 240) return;
-    uint16_t color = TFT_BLACK;
-    if (y > 0 && (y % 48 == 0)) color = TFT_DARKGREY;
-    if (y == 120) color = 0x7BEF; 
-    tft_drawFastHLine(0, y, width, color);
-    for (int x = 48; x < width; x += 48) {
-        uint16_t vColor = (x == 144) ? 0x7BEF : TFT_DARKGREY;
-        tft_drawPixel(x, y, vColor);
+// Add the frame in frame_buf to the histogram, called once per capture
+void persistAddFrame() {
+    // XY points come from xy.c instead
+    if (acqMode == ACQ_XY) return;
+    int lastX = sampleColumns(scopeWidth);
+    updateScale();
+    short prevY = scale_raw_to_y(columnSample[MARGIN_LEFT]);
+    for (int x = MARGIN_LEFT; x < lastX; x++) {
+        short y = scale_raw_to_y(columnSample[x]);
+        persist_add_span(x - MARGIN_LEFT, prevY - MARGIN_TOP, y - MARGIN_TOP);
+        prevY = y;
     }
 }
 
-void drawCursors(short width) {
-    static bool wasShowing = false;
-    static short oldY1 = -1;
-    static short oldY2 = -1;
-    static float oldDeltaV = -1.0;
+// One histogram column as runs of equal level. Unlit runs get the grid
+// back, unless the caller has just painted it.
+void drawPersistColumn(int c, bool gridDrawn) {
+    short x = MARGIN_LEFT + c;
+    int rows = 240 - MARGIN_TOP - MARGIN_BOTTOM + 1;
+    int runStart = 0;
+    uint8_t runLevel = persist_level(c, 0);
+    for (int r = 1; r <= rows; r++) {
+        uint8_t level = (r < rows) ? persist_level(c, r) : 0xFF;
+        if (level == runLevel) continue;
+        if (runLevel != 0) tft_drawFastVLine(x, MARGIN_TOP + runStart, r - runStart, persistPalette[runLevel]);
+        else if (!gridDrawn) drawGridRegion(x, MARGIN_TOP + runStart, 1, r - runStart);
+        runStart = r;
+        runLevel = level;
+    }
+}
 
-    if (!showCursors) {
-        if (wasShowing) {
-            if (oldY1 != -1) restoreCursorBg(oldY1, width);
-            if (oldY2 != -1) restoreCursorBg(oldY2, width);
-            tft_fillRect(5, 25, 100, 15, TFT_BLACK); 
-            wasShowing = false;
+// Send up to budget changed columns to the panel, carrying on from where
+// the last call stopped so a busy histogram still refreshes evenly
+void flushPersist(int budget) {
+    static int cursor = 0;
+    int plotW = scopeWidth - MARGIN_LEFT - MARGIN_RIGHT;
+    bool wrapped = false;
+    if (cursor >= plotW) cursor = 0;
+    for (int n = 0; n < budget; ) {
+        int c = persist_take_dirty(cursor, plotW);
+        if (c < 0) {
+            if (wrapped) break;
+            wrapped = true;
+            cursor = 0;
+            continue;
         }
-        return;
+        drawPersistColumn(c, false);
+        cursor = c + 1;
+        n++;
     }
-    wasShowing = true;
+}
 
-    short newY1 = voltToPixel(cursorV1_volts);
-    short newY2 = voltToPixel(cursorV2_volts);
+// Fade one level every persistTime / 15
+void decayPersist() {
+    static uint32_t lastDecayUs = 0;
+    uint32_t fadeMs = persistTimesMs[persistMode];
+    if (acqMode == ACQ_XY && persistMode == PERSIST_OFF) fadeMs = XY_FADE_MS;
+    if (fadeMs == 0) return;
+    uint32_t now = time_us_32();
+    if (now - lastDecayUs < fadeMs * 1000 / (PERSIST_LEVELS - 1)) return;
+    lastDecayUs = now;
+    persist_decay();
+}
 
-    if (newY1 != oldY1) {
-        if (oldY1 != -1) restoreCursorBg(oldY1, width);
-        tft_drawFastHLine(0, newY1, width, TFT_MAGENTA);
-        oldY1 = newY1;
-    } else tft_drawFastHLine(0, newY1, width, TFT_MAGENTA);
+// --- XY ---
+void xyHit(int column, int row) {
+    persist_add_span(column, row, row);
+}
 
-    if (newY2 != oldY2) {
-        if (oldY2 != -1) restoreCursorBg(oldY2, width);
-        tft_drawFastHLine(0, newY2, width, TFT_CYAN);
-        oldY2 = newY2;
-    } else tft_drawFastHLine(0, newY2, width, TFT_CYAN);
-    
+// X spans the plot for 0 to 3.3V at GPIO27, Y is the probe at the current
+// V/div. Cheap enough to redo every frame rather than track what changed.
+void plotXY() {
+    int16_t cols[256], rows[256];
+    int plotW = scopeWidth - MARGIN_LEFT - MARGIN_RIGHT;
+    updateScale();
+    for (int c = 0; c < 256; c++) {
+        cols[c] = c * (plotW - 1) / 255;
+        int r = scale_raw_to_y(c) - MARGIN_TOP;
+        rows[c] = (r >= 0 && r < PERSIST_ROWS) ? r : -1;
+    }
+    xy_set_maps(cols, rows);
+    xy_drain(xyHit);
+}
+
+// --- UI WIDGETS ---
+#define NUM_TIME_LABELS 9   // one per vertical grid line, i = -4..4
+#define NUM_VOLT_LABELS 5   // one per horizontal grid line, i = -2..2
+
+widget_t wGrid, wTrace, wCursor1, wCursor2, wCursorReadout;
+widget_t wTimeLabels[NUM_TIME_LABELS], wVoltLabels[NUM_VOLT_LABELS];
+widget_t wVoltsStatus, wTimeStatus, wRecStatus;
+widget_t wSegView, wView, wOverview, wEtsView, wMultiView, wPersist, wAcqStatus, wDecode;
+widget_t wMenuPanel, wMenuRows[MENU_VISIBLE_ROWS];
+
+// What the widgets currently show, so changes can be mapped to the
+// widgets that depend on them
+typedef struct view_state {
+    float voltsPerDiv;
+    float timePerDiv;
+    float gainFactor;
+    float cursorV1;
+    float cursorV2;
+    int gainMode;
+    int selected;
+    bool running;
+    bool cursors;
+    bool recording;
+    bool replaying;
+    bool editing;
+    bool menuOpen;
+    int menuScroll;
+    int acqMode;
+    int segCount;
+    int segSelected;
+    int deepState;
+    bool viewing;
+    uint32_t viewStep;
+    uint32_t viewStart;
+    int viewKnob;
+    int viewVZoom;
+    float viewVOffset;
+    int interpMode;
+    int etsFilled;
+    uint32_t etsTriggers;
+    int persistMode;
+    bool trigAuto;
+    bool autoset;
+    float trigLevel;
+    int genShape;
+    float genFreq;
+    int calibState;
+    int calibProgress;
+    bool calibPrompt;
+    int maskMode;
+    uint32_t maskTested;
+    uint32_t maskFailed;
+    int decodeMode;
+    uint32_t decodeGen;
+    int multiChannels;
+    int multiTrigSrc;
+} view_state_t;
+
+view_state_t shownState;
+bool shownStateValid = false;
+
+void drawGridWidget(widget_t *w) {
+    drawGridRegion(w->x, w->y, w->w, w->h);
+}
+
+// Replays the cached trace, used when something uncovered it while stopped
+void drawTraceWidget(widget_t *w) {
+    if (!traceValid) return;
+    short endX = (traceEndX < scopeWidth - MARGIN_RIGHT) ? traceEndX : scopeWidth - MARGIN_RIGHT - 1;
+    for (int x = MARGIN_LEFT + 1; x <= endX; x++) {
+        tft_drawLine(x - 1, oldWaveY[x - 1], x, oldWaveY[x], TFT_YELLOW);
+    }
+}
+
+void drawCursorLine(widget_t *w) {
+    tft_drawFastHLine(w->x, w->y, w->w, (w->id == 1) ? TFT_MAGENTA : TFT_CYAN);
+}
+
+void drawCursorReadout(widget_t *w) {
     float deltaV = cursorV1_volts - cursorV2_volts;
     if (deltaV < 0) deltaV = -deltaV; 
-    
-    if (deltaV != oldDeltaV || forceFullRedraw) {
-        tft_fillRect(5, 25, 100, 15, TFT_BLACK); 
-        tft_setTextSize(1);
-        tft_setTextColor(TFT_WHITE);
-        tft_setCursor(5, 25); 
-        char buf[20];
-        sprintf(buf, "dV: %.2f V", deltaV);
+    tft_fillRect(w->x, w->y, w->w, w->h, TFT_BLACK);
+    tft_setTextSize(1);
+    tft_setTextColor(TFT_WHITE);
+    tft_setCursor(w->x, w->y); 
+    char buf[20];
+    sprintf(buf, "dV: %.2f V", deltaV);
+    tft_writeString(buf);
+}
+
+// ETS always spans ETS_SPAN samples across the plot, whatever T/Div says
+float etsMicrosPerColumn() {
+    short plotW = scopeWidth - MARGIN_LEFT - MARGIN_RIGHT;
+    return ETS_SPAN * 1e6f / ADC_SAMPLE_RATE_HZ / plotW;
+}
+
+void drawTimeLabel(widget_t *w) {
+    tft_setTextSize(1);
+    tft_setTextColor(TFT_LIGHTGREY);
+    if (acqMode == ACQ_ETS && !isViewing) {
+        // Microseconds from the trigger
+        short plotW = scopeWidth - MARGIN_LEFT - MARGIN_RIGHT;
+        short trigX = MARGIN_LEFT + ETS_TRIGGER_BIN * plotW / ETS_BINS;
+        char buf[10]; sprintf(buf, "%.2g", (w->x - 2 - trigX) * etsMicrosPerColumn());
+        tft_setCursor(w->x, w->y); tft_writeString(buf);
+        return;
+    }
+    // Stopped and zoomed, a division is however many samples 48 columns now cover
+    float tdiv = isViewing ? 10.0f * viewer_step() / VIEWER_ONE : timePerDiv;
+    float t = (float)w->id * tdiv; 
+    char buf[10]; sprintf(buf, "%.0f", t); 
+    tft_setCursor(w->x, w->y); tft_writeString(buf);
+}
+
+void drawVoltLabel(widget_t *w) {
+    tft_setTextSize(1);
+    tft_setTextColor(TFT_LIGHTGREY);
+    float trueCenterV = calib_center_volts(currentGainMode);
+    if (isViewing) trueCenterV += viewVOffset;
+    float v = trueCenterV - ((float)w->id * shownVoltsPerDiv());
+    char buf[10]; sprintf(buf, "%.1fV", v);
+    tft_setCursor(w->x, w->y); tft_writeString(buf);
+}
+
+void drawVoltsStatus(widget_t *w) {
+    tft_fillRect(w->x, w->y, w->w, w->h, TFT_BLACK); tft_setTextSize(2); tft_setCursor(w->x, w->y);
+    tft_setTextColor(TFT_GREEN); 
+    char buf[32]; sprintf(buf, "%.1f V/d", voltsPerDiv); tft_writeString(buf);
+}
+
+void drawTimeStatus(widget_t *w) {
+    tft_fillRect(w->x, w->y, w->w, w->h, TFT_BLACK); tft_setTextSize(2); tft_setCursor(w->x, w->y);
+    tft_setTextColor(TFT_YELLOW); 
+    char buf[32];
+    if (acqMode == ACQ_ETS && !isViewing) sprintf(buf, "%.1f us/d", etsMicrosPerColumn() * PIXELS_PER_DIV);
+    else sprintf(buf, "%.0f ms/d", timePerDiv);
+    tft_writeString(buf);
+}
+
+void drawRecStatus(widget_t *w) {
+    tft_fillRect(w->x, w->y, w->w, w->h, TFT_BLACK);
+    if (isRecording) { tft_setTextSize(2); tft_setTextColor(TFT_RED); tft_setCursor(w->x, w->y); tft_writeString((char*)"REC"); }
+    else if (isReplaying) { tft_setTextSize(2); tft_setTextColor(TFT_GREEN); tft_setCursor(w->x, w->y); tft_writeString((char*)"PLY"); }
+}
+
+void drawMenuPanel(widget_t *w) {
+    tft_fillRect(w->x, w->y, w->w, w->h, TFT_NAVY);
+}
+
+void drawMenuRow(widget_t *w) {
+    int i = menuScroll + w->id;
+    if (i >= MENU_COUNT) { tft_fillRect(w->x, w->y, w->w, w->h, TFT_NAVY); return; }
+    short yPos = w->y + 2;
+    uint16_t boxColor = TFT_NAVY; uint16_t textColor = TFT_LIGHTGREY;
+    if (i == selectedMenuItem) { boxColor = isEditing ? TFT_RED : TFT_DARKGREY; textColor = TFT_WHITE; }
+    tft_fillRect(w->x, w->y, w->w, w->h, boxColor);
+    tft_setTextSize(1);
+    tft_setTextColor(textColor); tft_setCursor(245, yPos + 8); tft_writeString((char*)menuNames[i]);
+    tft_setCursor(245, yPos + 18); tft_setTextColor(TFT_WHITE); 
+    char buf[32];
+    if (i == MENU_V_DIV) sprintf(buf, "%.1fV", voltsPerDiv);
+    else if (i == MENU_T_DIV && acqMode == ACQ_ETS) sprintf(buf, "fixed");
+    else if (i == MENU_T_DIV) sprintf(buf, "%.0fms", timePerDiv); 
+    else if (i == MENU_GAIN) {
+        if (currentGainMode == SCOPE_GAIN_LOW) sprintf(buf, "LOW");
+        else if (currentGainMode == SCOPE_GAIN_MED) sprintf(buf, "MED");
+        else sprintf(buf, "HIGH");
+    }
+    else if (i == MENU_CUR_V1) sprintf(buf, "%.1fV", cursorV1_volts);
+    else if (i == MENU_CUR_V2) sprintf(buf, "%.1fV", cursorV2_volts);
+    else if (i == MENU_RUN_STOP) sprintf(buf, "%s", isRunning ? "RUN" : "STOP");
+    else if (i == MENU_CURSORS_EN) sprintf(buf, "%s", showCursors ? "ON" : "OFF");
+    else if (i == MENU_INTERP) sprintf(buf, "%s", (interpMode == INTERP_SINC) ? "SINC" : (interpMode == INTERP_LINEAR) ? "LINEAR" : "OFF");
+    else if (i == MENU_PERSIST) sprintf(buf, "%s", persistNames[persistMode]);
+    else if (i == MENU_AUTOSET) sprintf(buf, "%s", autosetPending ? "..." : "GO");
+    else if (i == MENU_TRIG_AUTO) sprintf(buf, "%s", autoTrigLevel ? "ON" : "OFF");
+    else if (i == MENU_TRIG_LEVEL) sprintf(buf, "%.2fV", pinToProbeVolts(triggerPinVolts));
+    else if (i == MENU_CALIBRATE) {
+        calib_state_t cs = calib_state();
+        if (cs == CALIB_RUNNING) sprintf(buf, "%d/%d", calib_progress(), CALIB_MODES * 2);
+        else if (calibPrompt) sprintf(buf, "PROBE>B");
+        else if (cs == CALIB_DONE) sprintf(buf, "SAVED");
+        else if (cs == CALIB_FAILED) sprintf(buf, "FAILED");
+        else sprintf(buf, "%s", calib_from_flash() ? "OK" : "NONE");
+    }
+    else if (i == MENU_GEN) sprintf(buf, "%s", awgNames[awg_shape()]);
+    else if (i == MENU_GEN_FREQ) {
+        float hz = awg_frequency();
+        if (hz >= 1000.0f) sprintf(buf, "%.1fk", hz / 1000.0f); else sprintf(buf, "%.0f", hz);
+    }
+    else if (i == MENU_ACQ_MODE) sprintf(buf, "%s", acqNames[acqMode]);
+    else if (i == MENU_MASK) sprintf(buf, "%s", maskNames[maskMode]);
+    else if (i == MENU_DECODE) sprintf(buf, "%s", decodeNames[decodeMode]);
+    else if (i == MENU_CHANNELS) sprintf(buf, "%d", multiChannels);
+    else if (i == MENU_TRIG_SRC) sprintf(buf, "CH%d", multiTrigSrc + 1);
+    else sprintf(buf, " ");
+    tft_writeString(buf);
+}
+
+// Segmented mode: every segment overlaid, or one of them picked with the
+// encoder. Segments are stretched across the plot.
+void drawSegView(widget_t *w) {
+    drawGridRegion(w->x, w->y, w->w, w->h);
+    if (!seg_complete()) return;
+
+    short plotW = w->w;
+    short trigX = w->x + (SEG_PRE_TRIGGER * plotW) / SEG_LEN;
+    tft_drawFastVLine(trigX, w->y, 6, TFT_ORANGE);
+
+    updateScale();
+    int first = (segSelected < 0) ? 0 : segSelected;
+    int last = (segSelected < 0) ? seg_count() - 1 : segSelected;
+    uint16_t color = (segSelected < 0) ? TFT_ORANGE : TFT_YELLOW;
+    for (int s = first; s <= last; s++) {
+        const uint8_t *seg = seg_data(s);
+        short prevX = w->x;
+        short prevY = scale_raw_to_y(seg[0]);
+        for (int i = 1; i < SEG_LEN; i++) {
+            short x = w->x + (i * plotW) / SEG_LEN;
+            short y = scale_raw_to_y(seg[i]);
+            tft_drawLine(prevX, prevY, x, y, color);
+            prevX = x; prevY = y;
+        }
+    }
+}
+
+// Min/max sample code for one plot column, false if it's empty
+typedef bool (*column_source_t)(int column, uint8_t *lo, uint8_t *hi, bool *trig);
+
+// What each plot column shows, so only columns that change get redrawn.
+// Top/bottom are screen rows, -1 for an empty column.
+short colTop[320];
+short colBot[320];
+bool colTrig[320];
+
+// One vertical span per column, from any column source
+void drawColumns(bool full, column_source_t source) {
+    short plotW = scopeWidth - MARGIN_LEFT - MARGIN_RIGHT;
+    updateScale();
+
+    for (int c = 0; c < plotW; c++) {
+        short x = MARGIN_LEFT + c;
+        short top = -1, bot = -1;
+        bool isTrig = false;
+        uint8_t lo, hi;
+        if (source(c, &lo, &hi, &isTrig)) {
+            top = scale_raw_to_y(hi);
+            bot = scale_raw_to_y(lo);
+        }
+        if (!full && top == colTop[c] && bot == colBot[c] && isTrig == colTrig[c]) continue;
+
+        if (!full) {
+            if (colTrig[c]) drawGridRegion(x, MARGIN_TOP, 1, 6);
+            if (colTop[c] >= 0) drawGridRegion(x, colTop[c], 1, colBot[c] - colTop[c] + 1);
+        }
+        if (top >= 0) tft_drawFastVLine(x, top, bot - top + 1, TFT_YELLOW);
+        if (isTrig) tft_drawFastVLine(x, MARGIN_TOP, 6, TFT_ORANGE);
+        colTop[c] = top;
+        colBot[c] = bot;
+        colTrig[c] = isTrig;
+    }
+}
+
+void drawView(widget_t *w) {
+    drawGridRegion(w->x, w->y, w->w, w->h);
+    if (isViewing) drawColumns(true, viewer_column);
+}
+
+// Equivalent-time bins stretched across the plot. Each column also takes
+// the bin before it so the trace joins up; bins nothing landed in yet are
+// skipped, so gaps close as it fills.
+bool etsColumn(int column, uint8_t *lo, uint8_t *hi, bool *trig) {
+    short plotW = scopeWidth - MARGIN_LEFT - MARGIN_RIGHT;
+    int b0 = column * ETS_BINS / plotW;
+    int b1 = (column + 1) * ETS_BINS / plotW;
+    if (b1 <= b0) b1 = b0 + 1;
+    *trig = (ETS_TRIGGER_BIN >= b0 && ETS_TRIGGER_BIN < b1);
+    *lo = 255; *hi = 0;
+    bool any = false;
+    for (int b = (b0 > 0) ? b0 - 1 : 0; b < b1; b++) {
+        uint8_t v;
+        if (!ets_bin(b, &v)) continue;
+        if (v < *lo) *lo = v;
+        if (v > *hi) *hi = v;
+        any = true;
+    }
+    return any;
+}
+
+void drawPersistView(widget_t *w) {
+    drawGridRegion(w->x, w->y, w->w, w->h);
+    for (int c = 0; c < w->w; c++) drawPersistColumn(c, true);
+}
+
+void drawEtsView(widget_t *w) {
+    drawGridRegion(w->x, w->y, w->w, w->h);
+    drawColumns(true, etsColumn);
+}
+
+// --- MULTI-CHANNEL TRACES ---
+// Each channel's samples per column and row table, kept from the last
+// frame so the plot can be put back without a new one
+uint8_t multiSample[MULTI_MAX_CHANNELS][320];
+uint8_t multiLut[MULTI_MAX_CHANNELS][256];
+int multiShown = 0;         // channels in multiSample
+int multiCols = 0;          // columns with data
+bool multiTrig = false;     // last frame triggered, not auto
+short multiTop[MULTI_MAX_CHANNELS][320];
+short multiBot[MULTI_MAX_CHANNELS][320];
+
+// Same time per column as the single trace, so each channel moves along
+// its own samples 1/n as fast
+static uint32_t multiStep() {
+    uint32_t step = (uint32_t)(timePerDiv / 10.0f / multiChannels * (1 << INTERP_FRAC_BITS) + 0.5f);
+    return step ? step : 1;
+}
+
+// Enough per channel for the plot either side of the trigger
+uint32_t multiFrameLength() {
+    uint32_t plotW = scopeWidth - MARGIN_LEFT - MARGIN_RIGHT;
+    return ((multiStep() * plotW) >> INTERP_FRAC_BITS) + INTERP_TAPS;
+}
+
+// The DAC level is at the pin, and every channel is read at its pin
+uint8_t multiTriggerCode() {
+    float code = triggerPinVolts * 255.0f / SCALE_ADC_FULL_SCALE + 0.5f;
+    return (code < 0.0f) ? 0 : (code > 255.0f) ? 255 : (uint8_t)code;
+}
+
+// Resample the frame core 1 just finished, trigger on the center column,
+// so it can have its buffers back straight away
+void loadMultiFrame() {
+    int plotW = scopeWidth - MARGIN_LEFT - MARGIN_RIGHT;
+    uint32_t step = multiStep();
+    uint32_t len = multi_length();
+    uint32_t center = (len / 2) << INTERP_FRAC_BITS;
+    uint32_t half = step * (plotW / 2);
+    uint32_t start = (center > half) ? center - half : 0;
+    int mode = (step < (1 << INTERP_FRAC_BITS)) ? interpMode : INTERP_NONE;
+
+    multiShown = multi_channels();
+    for (int ch = 0; ch < multiShown; ch++) {
+        multiCols = interp_resample(multi_frame(ch), len, start, step, multiSample[ch], plotW, mode);
+    }
+    multiTrig = multi_triggered();
+
+    updateScale();
+    memcpy(multiLut[0], scale_y_lut, sizeof(multiLut[0]));
+    for (int ch = 1; ch < multiShown; ch++) {
+        scale_build_lut(multiLut[ch], chanVoltsPerDiv[ch], SCALE_PIN_UV_PER_CODE, 0, chanOffset[ch]);
+    }
+}
+
+// Every channel in one sweep across the plot. A column's old spans all come
+// off before any new one goes on, so erasing one channel can't cut into
+// another's fresh trace. Columns where nothing moved are left alone.
+void drawMultiColumns(bool full) {
+    short plotW = scopeWidth - MARGIN_LEFT - MARGIN_RIGHT;
+    short trigC = plotW / 2;
+
+    for (int c = 0; c < plotW; c++) {
+        short x = MARGIN_LEFT + c;
+        short top[MULTI_MAX_CHANNELS], bot[MULTI_MAX_CHANNELS];
+        bool same = true;
+        for (int ch = 0; ch < MULTI_MAX_CHANNELS; ch++) {
+            top[ch] = bot[ch] = -1;
+            if (ch < multiShown && c < multiCols) {
+                uint8_t y0 = multiLut[ch][multiSample[ch][(c > 0) ? c - 1 : 0]];
+                uint8_t y1 = multiLut[ch][multiSample[ch][c]];
+                top[ch] = (y0 < y1) ? y0 : y1;
+                bot[ch] = (y0 < y1) ? y1 : y0;
+            }
+            if (top[ch] != multiTop[ch][c] || bot[ch] != multiBot[ch][c]) same = false;
+        }
+        // The trigger mark's column is always redone, it may have changed colour
+        if (!full && same && c != trigC) continue;
+
+        if (!full) {
+            for (int ch = 0; ch < MULTI_MAX_CHANNELS; ch++) {
+                if (multiTop[ch][c] >= 0) drawGridRegion(x, multiTop[ch][c], 1, multiBot[ch][c] - multiTop[ch][c] + 1);
+            }
+        }
+        for (int ch = MULTI_MAX_CHANNELS - 1; ch >= 0; ch--) {
+            if (top[ch] >= 0) tft_drawFastVLine(x, top[ch], bot[ch] - top[ch] + 1, chanColors[ch]);
+            multiTop[ch][c] = top[ch];
+            multiBot[ch][c] = bot[ch];
+        }
+        if (c == trigC) tft_drawFastVLine(x, MARGIN_TOP, 6, multiTrig ? TFT_ORANGE : TFT_DARKGREY);
+    }
+}
+
+void drawMultiView(widget_t *w) {
+    drawGridRegion(w->x, w->y, w->w, w->h);
+    drawMultiColumns(true);
+}
+
+// Whole record as a bar under the plot, the part on screen filled in
+void drawOverview(widget_t *w) {
+    tft_fillRect(w->x, w->y, w->w, w->h, TFT_BLACK);
+    uint32_t len = viewer_length();
+    if (len == 0) return;
+    tft_drawRect(w->x, w->y, w->w, w->h, TFT_DARKGREY);
+    uint32_t first, count;
+    viewer_window(&first, &count);
+    short barW = (count * w->w) / len;
+    if (barW < 2) barW = 2;
+    tft_fillRect(w->x + (first * w->w) / len, w->y + 1, barW, w->h - 2, TFT_CYAN);
+    tft_drawFastVLine(w->x + (viewer_trigger() * w->w) / len, w->y, w->h, TFT_ORANGE);
+}
+
+// Mode-specific status line under the V/div readout
+void drawAcqStatus(widget_t *w) {
+    tft_fillRect(w->x, w->y, w->w, w->h, TFT_BLACK);
+    tft_setTextSize(1);
+    tft_setTextColor(TFT_ORANGE);
+    tft_setCursor(w->x, w->y);
+    char buf[32];
+    if (isViewing) {
+        sprintf(buf, "%s %s %.3g/px", (acqMode == ACQ_DEEP) ? "DEEP" : "STOP", knobNames[viewKnob], (float)viewer_step() / VIEWER_ONE);
+    }
+    else if (acqMode == ACQ_DEEP) {
+        static const char *const stateNames[] = { "IDLE", "FILL", "ARMED", "TRIG'D", "DONE" };
+        sprintf(buf, "DEEP %luK %s", (unsigned long)(deep_length() / 1024), stateNames[deep_state()]);
+    }
+    else if (acqMode == ACQ_ETS) {
+        sprintf(buf, "ETS %dMS/s %d%% %lu", ADC_SAMPLE_RATE_HZ * ETS_FACTOR / 1000000,
+                ets_filled() * 100 / ETS_BINS, (unsigned long)ets_triggers());
+    }
+    else if (acqMode == ACQ_XY) sprintf(buf, "XY X=GP27 lost %lu", (unsigned long)xy_dropped());
+    else if (acqMode == ACQ_MULTI) {
+        sprintf(buf, "MULTI %dch %lukS/s T:CH%d", multi_channels(), (unsigned long)(multi_rate() / 1000), multiTrigSrc + 1);
+    }
+    else if (acqMode == ACQ_NORMAL) {
+        const mask_counts_t *mc = mask_counts();
+        if (mc->failed) tft_setTextColor(TFT_RED);
+        sprintf(buf, "MASK %lu/%lu FAIL", (unsigned long)mc->failed, (unsigned long)mc->tested);
+    }
+    else if (!seg_complete()) sprintf(buf, "ARMED %d/%d", seg_count(), seg_target());
+    else if (segSelected < 0) sprintf(buf, "SEG ALL %d", seg_count());
+    else sprintf(buf, "SEG %d +%luus", segSelected + 1, (unsigned long)(seg_time_us(segSelected) - seg_time_us(0)));
+    tft_writeString(buf);
+}
+
+// Screen column showing a sample, -1 if it's off the plot
+short decodeSampleX(uint32_t sample) {
+    short right = scopeWidth - MARGIN_RIGHT;
+    if (isViewing) {
+        uint32_t pos = sample << VIEWER_FRAC_BITS;
+        if (pos < viewer_start()) return -1;
+        uint32_t c = (pos - viewer_start()) / viewer_step();
+        return (c < (uint32_t)(right - MARGIN_LEFT)) ? MARGIN_LEFT + c : -1;
+    }
+    // Live trace: column x shows slot x * timeScale
+    sample = (sample + decodeSeam) % CAPTURE_DEPTH;
+    uint32_t step = (uint32_t)(timePerDiv / 10.0f * VIEWER_ONE);
+    uint32_t x = ((uint64_t)sample << VIEWER_FRAC_BITS) / step;
+    return (x >= MARGIN_LEFT && x < (uint32_t)right) ? x : -1;
+}
+
+// Decoded bytes in hex under where they start, skipping any that would
+// overlap the one before
+void drawDecodeStrip(widget_t *w) {
+    tft_fillRect(w->x, w->y, w->w, w->h, TFT_BLACK);
+    tft_setTextSize(1);
+    short nextFree = w->x;
+    char buf[4];
+    for (int i = 0; i < decode_count(); i++) {
+        const decode_event_t *e = decode_event(i);
+        short x = decodeSampleX(e->start);
+        if (x < nextFree || x > w->x + w->w - 12) continue;
+        uint16_t color = (e->flags & (DECODE_FLAG_NACK | DECODE_FLAG_ERROR)) ? TFT_RED :
+                         (e->flags & DECODE_FLAG_START) ? TFT_CYAN : TFT_GREEN;
+        tft_drawFastVLine(x, w->y, w->h, color);
+        tft_setTextColor(color);
+        tft_setCursor(x + 2, w->y + 1);
+        sprintf(buf, "%02X", e->value);
+        tft_writeString(buf);
+        nextFree = x + 15;
+    }
+}
+
+static void initWidget(widget_t *w, short x, short y, short width, short height, bool opaque, widget_draw_t draw, int id) {
+    w->x = x; w->y = y; w->w = width; w->h = height;
+    w->visible = true;
+    w->opaque = opaque;
+    w->draw = draw;
+    w->id = id;
+    ui_add(w);
+}
+
+// Back to front: anything repainted gets the widgets above it repainted too
+void initWidgets() {
+    ui_init(drawGridRegion);
+    initWidget(&wGrid, 0, 0, 320, 240, true, drawGridWidget, 0);
+    initWidget(&wTrace, MARGIN_LEFT, MARGIN_TOP, 320 - MARGIN_LEFT - MARGIN_RIGHT, 240 - MARGIN_TOP - MARGIN_BOTTOM + 1, true, drawTraceWidget, 0);
+    initWidget(&wSegView, MARGIN_LEFT, MARGIN_TOP, 320 - MARGIN_LEFT - MARGIN_RIGHT, 240 - MARGIN_TOP - MARGIN_BOTTOM + 1, true, drawSegView, 0);
+    initWidget(&wView, MARGIN_LEFT, MARGIN_TOP, 320 - MARGIN_LEFT - MARGIN_RIGHT, 240 - MARGIN_TOP - MARGIN_BOTTOM + 1, true, drawView, 0);
+    initWidget(&wPersist, MARGIN_LEFT, MARGIN_TOP, 320 - MARGIN_LEFT - MARGIN_RIGHT, 240 - MARGIN_TOP - MARGIN_BOTTOM + 1, true, drawPersistView, 0);
+    initWidget(&wEtsView, MARGIN_LEFT, MARGIN_TOP, 320 - MARGIN_LEFT - MARGIN_RIGHT, 240 - MARGIN_TOP - MARGIN_BOTTOM + 1, true, drawEtsView, 0);
+    initWidget(&wMultiView, MARGIN_LEFT, MARGIN_TOP, 320 - MARGIN_LEFT - MARGIN_RIGHT, 240 - MARGIN_TOP - MARGIN_BOTTOM + 1, true, drawMultiView, 0);
+    initWidget(&wDecode, MARGIN_LEFT, 240 - MARGIN_BOTTOM - DECODE_STRIP_H, 320 - MARGIN_LEFT - MARGIN_RIGHT, DECODE_STRIP_H, true, drawDecodeStrip, 0);
+    initWidget(&wOverview, MARGIN_LEFT, 240 - MARGIN_BOTTOM + 2, 320 - MARGIN_LEFT - MARGIN_RIGHT, 5, true, drawOverview, 0);
+    initWidget(&wCursor1, 0, 0, 320, 1, true, drawCursorLine, 1);
+    initWidget(&wCursor2, 0, 0, 320, 1, true, drawCursorLine, 2);
+    for (int i = 0; i < NUM_TIME_LABELS; i++) initWidget(&wTimeLabels[i], 0, 230, 24, 8, false, drawTimeLabel, i - 4);
+    for (int i = 0; i < NUM_VOLT_LABELS; i++) initWidget(&wVoltLabels[i], 2, 0, 36, 8, false, drawVoltLabel, i - 2);
+    initWidget(&wVoltsStatus, 5, 5, 110, 20, true, drawVoltsStatus, 0);
+    initWidget(&wTimeStatus, 120, 5, 110, 20, true, drawTimeStatus, 0);
+    initWidget(&wRecStatus, 280, 5, 40, 20, true, drawRecStatus, 0);
+    initWidget(&wCursorReadout, 5, 25, 100, 15, true, drawCursorReadout, 0);
+    initWidget(&wAcqStatus, 120, 25, 150, 10, true, drawAcqStatus, 0);
+    initWidget(&wMenuPanel, 240, 0, 80, 240, true, drawMenuPanel, 0);
+    for (int i = 0; i < MENU_VISIBLE_ROWS; i++) initWidget(&wMenuRows[i], 240, 5 + (i * 32) - 2, 80, 28, true, drawMenuRow, i);
+}
+
+// Cursor lines sit at whatever row their voltage maps to
+void placeCursors() {
+    short y1 = voltToPixel(cursorV1_volts);
+    short y2 = voltToPixel(cursorV2_volts);
+    ui_move(&wCursor1, 0, y1, scopeWidth, 1);
+    ui_move(&wCursor2, 0, y2, scopeWidth, 1);
+    ui_set_visible(&wCursor1, showCursors && y1 >= 0 && y1 < 240);
+    ui_set_visible(&wCursor2, showCursors && y2 >= 0 && y2 < 240);
+    ui_set_visible(&wCursorReadout, showCursors);
+}
+
+// Everything that depends on the plot width (menu open or closed)
+void layoutWidgets() {
+    scopeWidth = isMenuOpen ? 240 : 320;
+    short centerX = scopeWidth / 2;
+
+    wGrid.w = scopeWidth;
+    wTrace.w = scopeWidth - MARGIN_LEFT - MARGIN_RIGHT;
+    wSegView.w = wTrace.w;
+    wEtsView.w = wTrace.w;
+    wMultiView.w = wTrace.w;
+    wPersist.w = wTrace.w;
+    wView.w = wTrace.w;
+    wOverview.w = wTrace.w;
+    wTrace.visible = (acqMode == ACQ_NORMAL && !isViewing && persistMode == PERSIST_OFF);
+    wPersist.visible = persistActive();
+    wSegView.visible = (acqMode == ACQ_SEGMENTED);
+    wEtsView.visible = (acqMode == ACQ_ETS);
+    wMultiView.visible = (acqMode == ACQ_MULTI);
+    wView.visible = isViewing || acqMode == ACQ_DEEP;
+    wOverview.visible = isViewing;
+    wAcqStatus.visible = (acqMode != ACQ_NORMAL || isViewing || maskMode != MASK_OFF);
+    wDecode.w = wTrace.w;
+    wDecode.visible = decodeMode != DECODE_OFF && (acqMode == ACQ_NORMAL || isViewing);
+    if (isViewing) viewer_set_columns(wView.w);
+    for (int i = 0; i < NUM_TIME_LABELS; i++) {
+        short x = centerX + (wTimeLabels[i].id * PIXELS_PER_DIV);
+        wTimeLabels[i].x = x + 2;
+        wTimeLabels[i].visible = (x > 0 && x < scopeWidth && acqMode != ACQ_XY);
+    }
+    for (int i = 0; i < NUM_VOLT_LABELS; i++) {
+        wVoltLabels[i].y = GRID_CENTER_Y + (wVoltLabels[i].id * PIXELS_PER_DIV) - 10;
+    }
+    wRecStatus.x = scopeWidth - 40;
+    wMenuPanel.visible = isMenuOpen;
+    for (int i = 0; i < MENU_VISIBLE_ROWS; i++) wMenuRows[i].visible = isMenuOpen;
+    placeCursors();
+}
+
+// Repaint the row showing a menu item, if it's scrolled into view
+static void invalidateMenuItem(int item) {
+    int row = item - menuScroll;
+    if (row >= 0 && row < MENU_VISIBLE_ROWS) ui_invalidate(&wMenuRows[row]);
+}
+
+// Scroll just far enough to keep the selection on screen
+static void scrollMenuToSelection() {
+    if (selectedMenuItem < menuScroll) menuScroll = selectedMenuItem;
+    if (selectedMenuItem >= menuScroll + MENU_VISIBLE_ROWS) menuScroll = selectedMenuItem - MENU_VISIBLE_ROWS + 1;
+}
+
+// Anything finished and not about to be overwritten can be zoomed into
+static bool viewWanted() {
+    if (acqMode == ACQ_DEEP) return deep_state() == DEEP_DONE;
+    return acqMode == ACQ_NORMAL && !isRunning && !isReplaying;
+}
+
+// Point the viewer at what's to be inspected, starting from a view that
+// matches what was on screen
+static void openView() {
+    viewer_set_columns(scopeWidth - MARGIN_LEFT - MARGIN_RIGHT);
+    if (acqMode == ACQ_DEEP) {
+        viewer_set_source(deep_length(), deep_trigger_pos(), deep_minmax, deep_sample);
+        viewer_fit();
+    } else {
+        // The live trace puts sample x * timeScale at screen column x
+        uint32_t step = (uint32_t)(timePerDiv / 10.0f * VIEWER_ONE);
+        viewer_load_frame(frame_buf, CAPTURE_DEPTH, frame_trigger_index);
+        viewer_set(step, MARGIN_LEFT * step);
+    }
+    decodeRequest = true;
+    viewKnob = KNOB_H_PAN;
+    viewVZoom = 0;
+    viewVOffset = 0.0f;
+}
+
+static view_state_t currentViewState() {
+    view_state_t s = {
+        voltsPerDiv, timePerDiv, hardwareGainFactor, cursorV1_volts, cursorV2_volts,
+        currentGainMode, selectedMenuItem, isRunning, showCursors, isRecording, isReplaying, isEditing, isMenuOpen,
+        menuScroll, acqMode, seg_count(), segSelected, deep_state(),
+        isViewing, viewer_step(), viewer_start(), viewKnob, viewVZoom, viewVOffset, interpMode,
+        ets_filled(), ets_triggers(), persistMode,
+        autoTrigLevel, autosetPending, triggerPinVolts,
+        awg_shape(), awg_frequency(),
+        calib_state(), calib_progress(), calibPrompt,
+        maskMode, mask_counts()->tested, mask_counts()->failed,
+        decodeMode, decodeGen,
+        multiChannels, multiTrigSrc
+    };
+    return s;
+}
+
+// Compare the settings against what's on screen and invalidate only the
+// widgets that show something that changed
+void syncWidgets() {
+    bool viewing = viewWanted();
+    if (viewing && !isViewing) openView();
+    isViewing = viewing;
+
+    view_state_t now = currentViewState();
+    view_state_t *old = &shownState;
+
+    if (!shownStateValid || forceFullRedraw || now.menuOpen != old->menuOpen || now.acqMode != old->acqMode ||
+        now.viewing != old->viewing || now.persistMode != old->persistMode || now.maskMode != old->maskMode ||
+        now.decodeMode != old->decodeMode) {
+        // Width or mode changed, old hits no longer line up
+        persist_clear();
+        layoutWidgets();
+        ui_invalidate_all();
+        forceFullRedraw = false;
+        shownState = now;
+        shownStateValid = true;
+        return;
+    }
+
+    bool vScaleChanged = (now.voltsPerDiv != old->voltsPerDiv || now.gainFactor != old->gainFactor ||
+                          now.viewVZoom != old->viewVZoom || now.viewVOffset != old->viewVOffset);
+    bool cursorsChanged = (now.cursorV1 != old->cursorV1 || now.cursorV2 != old->cursorV2);
+
+    if (vScaleChanged) {
+        ui_invalidate(&wVoltsStatus);
+        for (int i = 0; i < NUM_VOLT_LABELS; i++) ui_invalidate(&wVoltLabels[i]);
+        invalidateMenuItem(MENU_V_DIV);
+        ui_invalidate(&wSegView);
+        ui_invalidate(&wView);
+        ui_invalidate(&wEtsView);
+        ui_invalidate(&wMultiView);
+        persist_clear();
+        ui_invalidate(&wPersist);
+    }
+    // Bins summed at the old gain would mix two scales
+    if (now.gainFactor != old->gainFactor && acqMode == ACQ_ETS) ets_reset();
+    if (now.timePerDiv != old->timePerDiv || now.viewStep != old->viewStep) {
+        if (now.timePerDiv != old->timePerDiv) { persist_clear(); ui_invalidate(&wPersist); }
+        ui_invalidate(&wTimeStatus);
+        for (int i = 0; i < NUM_TIME_LABELS; i++) ui_invalidate(&wTimeLabels[i]);
+        invalidateMenuItem(MENU_T_DIV);
+    }
+    if (now.gainMode != old->gainMode) invalidateMenuItem(MENU_GAIN);
+    if (vScaleChanged || cursorsChanged || now.cursors != old->cursors) placeCursors();
+    if (cursorsChanged) {
+        ui_invalidate(&wCursorReadout);
+        invalidateMenuItem(MENU_CUR_V1);
+        invalidateMenuItem(MENU_CUR_V2);
+    }
+    if (now.cursors != old->cursors) invalidateMenuItem(MENU_CURSORS_EN);
+    if (now.running != old->running) invalidateMenuItem(MENU_RUN_STOP);
+    if (now.recording != old->recording || now.replaying != old->replaying) ui_invalidate(&wRecStatus);
+    if (now.menuScroll != old->menuScroll) {
+        for (int i = 0; i < MENU_VISIBLE_ROWS; i++) ui_invalidate(&wMenuRows[i]);
+    } else if (now.selected != old->selected) {
+        invalidateMenuItem(old->selected);
+        invalidateMenuItem(now.selected);
+    }
+    if (now.editing != old->editing) invalidateMenuItem(now.selected);
+    if (now.segCount != old->segCount || now.segSelected != old->segSelected) {
+        ui_invalidate(&wAcqStatus);
+        // The plot only changes once the whole burst is in
+        if (seg_complete()) ui_invalidate(&wSegView);
+    }
+    if (now.deepState != old->deepState || now.viewStep != old->viewStep || now.viewKnob != old->viewKnob) ui_invalidate(&wAcqStatus);
+    if (now.viewStep != old->viewStep || now.viewStart != old->viewStart) ui_invalidate(&wOverview);
+    if (now.etsFilled != old->etsFilled || now.etsTriggers != old->etsTriggers) ui_invalidate(&wAcqStatus);
+    if (now.decodeGen != old->decodeGen || now.viewStep != old->viewStep || now.viewStart != old->viewStart ||
+        now.timePerDiv != old->timePerDiv) ui_invalidate(&wDecode);
+    if (now.maskTested != old->maskTested || now.maskFailed != old->maskFailed) ui_invalidate(&wAcqStatus);
+    if (now.multiChannels != old->multiChannels || now.multiTrigSrc != old->multiTrigSrc) {
+        invalidateMenuItem(MENU_CHANNELS);
+        invalidateMenuItem(MENU_TRIG_SRC);
+        ui_invalidate(&wAcqStatus);
+    }
+    if (now.autoset != old->autoset) invalidateMenuItem(MENU_AUTOSET);
+    if (now.trigAuto != old->trigAuto) invalidateMenuItem(MENU_TRIG_AUTO);
+    if (now.trigLevel != old->trigLevel || now.gainFactor != old->gainFactor) invalidateMenuItem(MENU_TRIG_LEVEL);
+    if (now.genShape != old->genShape) invalidateMenuItem(MENU_GEN);
+    if (now.calibState != old->calibState || now.calibProgress != old->calibProgress || now.calibPrompt != old->calibPrompt) {
+        invalidateMenuItem(MENU_CALIBRATE);
+    }
+    if (now.genFreq != old->genFreq) invalidateMenuItem(MENU_GEN_FREQ);
+    if (now.interpMode != old->interpMode) {
+        invalidateMenuItem(MENU_INTERP);
+        ui_invalidate(&wView);
+    }
+
+    shownState = now;
+}
+
+// --- HISTOGRAM ---
+// Bars are scaled to the power of two at or above the fullest bin, so the
+// scale only changes now and then and most frames touch a handful of bars.
+void drawHistogram(bool full) {
+    static absolute_time_t nextStats;
+    char buf[48];
+
+    if (full) {
+        tft_fillScreen(TFT_BLACK);
+        for (int i = 0; i < HIST_BINS; i++) histDrawn[i] = 0;
+        tft_setCursor(88, 5); tft_setTextColor(TFT_MAGENTA); tft_setTextSize(2); tft_writeString("HISTOGRAM");
+        tft_setTextSize(1); tft_setTextColor(TFT_WHITE);
+        tft_drawFastHLine(HIST_X, HIST_BOTTOM, HIST_BINS, TFT_DARKGREY);
+        tft_setCursor(HIST_X, HIST_BOTTOM + 5); tft_writeString("0");
+        tft_setCursor(HIST_X + HIST_BINS - 18, HIST_BOTTOM + 5); tft_writeString("255");
+        tft_setCursor(HIST_X + 90, HIST_BOTTOM + 5); tft_writeString("B: reset");
+        nextStats = get_absolute_time();
+    }
+
+    uint32_t peak = 0;
+    for (int i = 0; i < HIST_BINS; i++) {
+        uint32_t b = hist_bin(i);
+        if (b > peak) peak = b;
+    }
+    int shift = 0;
+    while (shift < 31 && (1u << shift) < peak) shift++;
+
+    for (int i = 0; i < HIST_BINS; i++) {
+        short h = (short)(((uint64_t)hist_bin(i) * HIST_HEIGHT) >> shift);
+        short old = histDrawn[i];
+        if (h == old) continue;
+        if (h > old) tft_drawFastVLine(HIST_X + i, HIST_BOTTOM - h, h - old, TFT_GREEN);
+        else tft_drawFastVLine(HIST_X + i, HIST_BOTTOM - old, old - h, TFT_BLACK);
+        histDrawn[i] = h;
+    }
+
+    if (!full && absolute_time_diff_us(nextStats, get_absolute_time()) < 0) return;
+    nextStats = make_timeout_time_us(HIST_STATS_US);
+
+    hist_stats_t st;
+    hist_stats(&st);
+    float sdMv = st.sd * fabsf(scale_mv_lut[255] - scale_mv_lut[0]) / 255.0f;
+    int mean = (int)(st.mean + 0.5f);
+    tft_setTextColor2(TFT_WHITE, TFT_BLACK);
+    sprintf(buf, "Mean %6.2f (%.3fV)  SD %5.2f (%.1fmV)   ", st.mean, scale_mv_lut[mean] / 1000.0f, st.sd, sdMv);
+    tft_setCursor(4, 22); tft_writeString(buf);
+    sprintf(buf, "Range %3d-%3d (%3d)  DNL %4.2f  N %llu   ", st.lo, st.hi, st.hi - st.lo, st.dnl, (unsigned long long)st.count);
+    tft_setCursor(4, 31); tft_writeString(buf);
+    sprintf(buf, "lost %lu   ", (unsigned long)hist_dropped());
+    tft_setCursor(180, HIST_BOTTOM + 5); tft_writeString(buf);
+}
+
+// --- DECODE TABLE ---
+// Decoded bytes in order, scrolled with the encoder. Rows are only
+// rewritten when a decode finishes or the list moves.
+void drawDecodeTable(bool full) {
+    static uint32_t shownGen;
+    static int shownScroll;
+    char buf[56];
+    int n = decode_count();
+
+    if (decodeScroll > n - DECODE_TABLE_ROWS) decodeScroll = n - DECODE_TABLE_ROWS;
+    if (decodeScroll < 0) decodeScroll = 0;
+    if (!full && shownGen == decodeGen && shownScroll == decodeScroll) return;
+    shownGen = decodeGen;
+    shownScroll = decodeScroll;
+
+    if (full) {
+        tft_fillScreen(TFT_BLACK);
+        tft_setCursor(100, 5); tft_setTextColor(TFT_MAGENTA); tft_setTextSize(2); tft_writeString("DECODE");
+        tft_setTextSize(1); tft_setTextColor(TFT_LIGHTGREY);
+        tft_setCursor(10, 30); tft_writeString("  #    time us  hex  chr  flags");
+    }
+
+    for (int r = 0; r < DECODE_TABLE_ROWS; r++) {
+        int i = decodeScroll + r;
+        uint16_t color = TFT_WHITE;
+        if (i < n) {
+            const decode_event_t *e = decode_event(i);
+            char c = (e->value >= 32 && e->value < 127) ? e->value : '.';
+            sprintf(buf, "%3d %10.1f   %02X   %c   %s%s%s%s", i, e->start * 1e6f / ADC_SAMPLE_RATE_HZ, e->value, c,
+                    (e->flags & DECODE_FLAG_START) ? "START " : "", (e->flags & DECODE_FLAG_NACK) ? "NACK " : "",
+                    (e->flags & DECODE_FLAG_STOP) ? "STOP " : "", (e->flags & DECODE_FLAG_ERROR) ? "ERROR" : "");
+            if (e->flags & (DECODE_FLAG_NACK | DECODE_FLAG_ERROR)) color = TFT_RED;
+            else if (e->flags & DECODE_FLAG_START) color = TFT_CYAN;
+        } else {
+            buf[0] = 0;
+        }
+        // Pad so the old row is covered
+        int len = strlen(buf);
+        while (len < 50) buf[len++] = ' ';
+        buf[len] = 0;
+        tft_setTextColor2(color, TFT_BLACK);
+        tft_setCursor(10, 42 + r * 9);
         tft_writeString(buf);
-        oldDeltaV = deltaV;
     }
+
+    uint32_t bit = decode_bit_q8();
+    if (decodeMode == DECODE_UART && bit) {
+        sprintf(buf, "%s %lu baud%s, %lu bytes   ", decodeNames[decodeMode], (unsigned long)(ADC_SAMPLE_RATE_HZ * 256ull / bit),
+                decodeBaud ? "" : " (auto)", (unsigned long)decode_total());
+    } else {
+        sprintf(buf, "%s, %lu bytes   ", decodeNames[decodeMode], (unsigned long)decode_total());
+    }
+    tft_setTextColor2(TFT_LIGHTGREY, TFT_BLACK);
+    tft_setCursor(10, 228);
+    tft_writeString(buf);
 }
 
 // --- MAIN DRAW FUNCTION ---
@@ -411,11 +1426,26 @@ void drawUI() {
     }
 
     // === NORMAL SCOPE UI ===
-    short scopeWidth = isMenuOpen ? 240 : 320;
     static bool lastModeWasFFT = false; 
+    static bool lastModeWasHist = false;
+    static bool lastModeWasTable = false;
+
+    // Deep, XY and multi-channel modes take the ring away from the histogram
+    hist_enable(isHistMode && acqMode != ACQ_DEEP && acqMode != ACQ_XY && acqMode != ACQ_MULTI);
+    xy_enable(acqMode == ACQ_XY && isRunning && !isHistMode && !isFFTMode && !isDecodeTable);
 
     // Mode Switching Logic
-    if (isFFTMode) {
+    if (isHistMode) {
+        drawHistogram(!lastModeWasHist || forceFullRedraw);
+        forceFullRedraw = false;
+        lastModeWasHist = true;
+        lastModeWasFFT = false;
+    } else if (isDecodeTable) {
+        drawDecodeTable(!lastModeWasTable || forceFullRedraw);
+        forceFullRedraw = false;
+        lastModeWasTable = true;
+        lastModeWasHist = false;
+    } else if (isFFTMode) {
         if (!lastModeWasFFT) {
             tft_fillScreen(TFT_BLACK); 
             lastModeWasFFT = true;     
@@ -443,67 +1473,51 @@ void drawUI() {
         tft_setTextColor(TFT_WHITE); tft_setCursor(20, 25); sprintf(buf, "Peak: %.1fkHz", peakFreq/1000.0); tft_writeString(buf);
 
     } else {
-        if (lastModeWasFFT) { forceFullRedraw = true; lastModeWasFFT = false; }
-        if (forceFullRedraw) {
-            drawGrid(scopeWidth);
-            if (isMenuOpen) { tft_fillRect(240, 0, 80, 240, TFT_NAVY); menuDirty = true; }
-            for(int i=0; i<320; i++) oldWaveY[i] = 120; 
-            forceFullRedraw = false; 
-        }
-        if (isRunning) drawWaveformFromBuffer(scopeWidth); 
-        drawCursors(scopeWidth); 
-    }
-
-    // Shared Text
-    if (!isFFTMode) {
-        static float oldVoltsPerDiv = -1;
-        static float oldTimePerDiv = -1;
-        tft_setTextColor(TFT_GREEN); 
-        if (voltsPerDiv != oldVoltsPerDiv) {
-            tft_fillRect(5, 5, 110, 20, TFT_BLACK); tft_setTextSize(2); tft_setCursor(5, 5);
-            char buf[32]; sprintf(buf, "%.1f V/d", voltsPerDiv); tft_writeString(buf);
-            oldVoltsPerDiv = voltsPerDiv;
-        }
-        tft_setTextColor(TFT_YELLOW); 
-        if (timePerDiv != oldTimePerDiv) {
-            tft_fillRect(120, 5, 110, 20, TFT_BLACK); tft_setTextSize(2); tft_setCursor(120, 5);
-            char buf[32]; sprintf(buf, "%.0f ms/d", timePerDiv); tft_writeString(buf);
-            oldTimePerDiv = timePerDiv;
-        }
-    }
-
-    static bool oldIsRecording = false;
-    if (isRecording != oldIsRecording) {
-        tft_fillRect(scopeWidth - 40, 5, 40, 20, TFT_BLACK);
-        if (isRecording) { tft_setTextColor(TFT_RED); tft_setCursor(scopeWidth - 40, 5); tft_writeString((char*)"REC"); }
-        oldIsRecording = isRecording;
-    }
-
-    if (isMenuOpen && menuDirty && !isFFTMode) {
-        tft_setTextSize(1);
-        for (int i = 0; i < MENU_COUNT; i++) {
-            short yPos = 5 + (i * 32); 
-            uint16_t boxColor = TFT_NAVY; uint16_t textColor = TFT_LIGHTGREY;
-            if (i == selectedMenuItem) { boxColor = isEditing ? TFT_RED : TFT_DARKGREY; textColor = TFT_WHITE; }
-            tft_fillRect(240, yPos - 2, 80, 28, boxColor);
-            tft_setTextColor(textColor); tft_setCursor(245, yPos + 8); tft_writeString((char*)menuNames[i]);
-            tft_setCursor(245, yPos + 18); tft_setTextColor(TFT_WHITE); 
-            char buf[32];
-            if (i == MENU_V_DIV) sprintf(buf, "%.1fV", voltsPerDiv);
-            else if (i == MENU_T_DIV) sprintf(buf, "%.0fms", timePerDiv); 
-            else if (i == MENU_GAIN) {
-                if (currentGainMode == SCOPE_GAIN_LOW) sprintf(buf, "LOW");
-                else if (currentGainMode == SCOPE_GAIN_MED) sprintf(buf, "MED");
-                else sprintf(buf, "HIGH");
+        if (lastModeWasFFT || lastModeWasHist || lastModeWasTable) {
+            forceFullRedraw = true;
+            lastModeWasFFT = lastModeWasHist = lastModeWasTable = false;
+        }
+        syncWidgets();
+        ui_compose();
+        bool traceDrawn = false;
+        if (persistActive()) {
+            // Stopped XY holds the last picture
+            if (acqMode != ACQ_XY) decayPersist();
+            else if (isRunning) { plotXY(); decayPersist(); }
+            flushPersist(PERSIST_FLUSH_COLUMNS);
+            traceDrawn = true;
+        } else if ((isRunning || isReplaying) && acqMode == ACQ_NORMAL) {
+            drawWaveformFromBuffer(scopeWidth); 
+            traceDrawn = true;
+        }
+        if (isViewing && viewDirty) {
+            drawColumns(false, viewer_column);
+            traceDrawn = true;
+        }
+        if (acqMode == ACQ_ETS) {
+            drawColumns(false, etsColumn);
+            traceDrawn = true;
+        }
+        if (acqMode == ACQ_MULTI) {
+            multi_set_length(multiFrameLength());
+            multi_set_trigger(multiTrigSrc, multiTriggerCode());
+            if (isRunning && multi_ready()) {
+                loadMultiFrame();
+                multi_release();
+                drawMultiColumns(false);
+                traceDrawn = true;
+            }
+        }
+        viewDirty = false;
+        // The new trace was drawn over the cursor lines, put them back on top
+        if (traceDrawn && (showCursors || wDecode.visible)) {
+            if (showCursors) {
+                ui_invalidate(&wCursor1);
+                ui_invalidate(&wCursor2);
             }
-            else if (i == MENU_CUR_V1) sprintf(buf, "%.1fV", cursorV1_volts);
-            else if (i == MENU_CUR_V2) sprintf(buf, "%.1fV", cursorV2_volts);
-            else if (i == MENU_RUN_STOP) sprintf(buf, "%s", isRunning ? "RUN" : "STOP");
-            else if (i == MENU_CURSORS_EN) sprintf(buf, "%s", showCursors ? "ON" : "OFF");
-            else sprintf(buf, " ");
-            tft_writeString(buf);
+            ui_invalidate(&wDecode);
+            ui_compose();
         }
-        menuDirty = false; 
     }
 }
 
@@ -585,104 +1599,725 @@ void drawSnake() {
     }
 }
 
-void handleInput() {
-    uint32_t buttons = seesaw_read_buttons();
-    uint16_t joyX = seesaw_read_analog(PIN_JOY_X);
-    uint16_t joyY = seesaw_read_analog(PIN_JOY_Y);
-    
-    bool currentEncSw = !gpio_get(PICO_ENC_SW);
-    int delta = rotaryDelta;
-    rotaryDelta = 0;
+// Start a deep record sized for the current timebase
+void armDeep() {
+    float timeScale = timePerDiv / 10.0f;
+    uint32_t onScreen = (uint32_t)((scopeWidth - MARGIN_LEFT - MARGIN_RIGHT) * timeScale);
+    deep_arm(deep_length_for(onScreen));
+}
+
+// Switch how triggers are captured. Segmented mode starts a fresh burst,
+// deep mode takes over the ADC ring until it's switched off again.
+void setAcqMode(int mode) {
+    if (mode == acqMode) return;
+    if (acqMode == ACQ_SEGMENTED) seg_abort();
+    if (acqMode == ACQ_DEEP) deep_release();
+    if (acqMode == ACQ_XY) adc_capture_set_inputs(1u << CAPTURE_CHANNEL);
+    if (acqMode == ACQ_MULTI) multi_stop();
+    // Set first so the trigger IRQ is routed to the new mode
+    acqMode = mode;
+    if (mode == ACQ_SEGMENTED) {
+        segSelected = -1;
+        seg_start(SEG_DEFAULT_COUNT);
+    }
+    if (mode == ACQ_DEEP) armDeep();
+    if (mode == ACQ_ETS) ets_reset();
+    if (mode == ACQ_XY) adc_capture_set_inputs((1u << CAPTURE_CHANNEL) | (1u << XY_INPUT));
+    if (mode == ACQ_MULTI) multi_start(multiChannels);
+}
+
+// Restarts the capture if it's running, the ring layout depends on it
+void setMultiChannels(int n) {
+    if (n < 2 || n > MULTI_MAX_CHANNELS) return;
+    multiChannels = n;
+    if (multiTrigSrc >= n) multiTrigSrc = 0;
+    if (acqMode == ACQ_MULTI) multi_start(n);
+}
+
+// --- TRIGGER LEVEL ---
+// Returns false if the level is outside what the DAC can reach
+bool setTriggerProbeVolts(float probeVolts) {
+    float pin = calib_probe_to_pin(currentGainMode, probeVolts);
+    if (set_trigger_voltage(pin) < 0) return false;
+    triggerPinVolts = pin;
+    return true;
+}
+
+void setTriggerCode(uint8_t code) {
+    float pin = autoset_code_to_volts(code);
+    if (set_trigger_voltage(pin) == 0) triggerPinVolts = pin;
+}
+
+// --- SETTINGS ---
+void collectSettings(settings_t *s) {
+    memset(s, 0, sizeof(*s));
+    s->volts_per_div = voltsPerDiv;
+    s->time_per_div = timePerDiv;
+    s->cursor_v1 = cursorV1_volts;
+    s->cursor_v2 = cursorV2_volts;
+    s->trigger_pin_volts = triggerPinVolts;
+    s->gain_mode = currentGainMode;
+    s->show_cursors = showCursors;
+    s->fft_mode = isFFTMode;
+    s->interp_mode = interpMode;
+    s->persist_mode = persistMode;
+    s->auto_trigger = autoTrigLevel;
+}
+
+// Boot time, before anything uses the settings. Anything out of range
+// keeps its default.
+void restoreSettings() {
+    settings_t s;
+    if (!settings_load(&s)) return;
+    if (s.volts_per_div >= 0.1f && s.volts_per_div <= 100.0f) voltsPerDiv = s.volts_per_div;
+    if (s.time_per_div >= 1.0f && s.time_per_div <= 1000.0f) timePerDiv = s.time_per_div;
+    cursorV1_volts = s.cursor_v1;
+    cursorV2_volts = s.cursor_v2;
+    if (s.trigger_pin_volts >= 0.0f && s.trigger_pin_volts <= DAC_VOLTS_MAX) triggerPinVolts = s.trigger_pin_volts;
+    if (s.gain_mode <= SCOPE_GAIN_HIGH) currentGainMode = s.gain_mode;
+    showCursors = s.show_cursors;
+    isFFTMode = s.fft_mode;
+    if (s.interp_mode < INTERP_MODE_COUNT) interpMode = s.interp_mode;
+    if (s.persist_mode < PERSIST_MODE_COUNT) persistMode = s.persist_mode;
+    autoTrigLevel = s.auto_trigger;
+}
+
+// --- CALIBRATION ---
+// The offset output is the reference, so the generator has to let go of it
+void startCalibration() {
+    awg_set_shape(AWG_OFF);
+    setAcqMode(ACQ_NORMAL);
+    calib_start();
+}
+
+// --- AUTO-SETUP ---
+uint8_t snapshotBuf[CAPTURE_DEPTH];
+
+// Copy the live ring like trigger_copy does, oldest sample at the DMA write position
+void snapshotRing(signal_stats_t *s) {
+    int start = adc_capture_write_index();
+    memcpy(snapshotBuf, capture_buf, CAPTURE_DEPTH);
+    stats_add(s, snapshotBuf, CAPTURE_DEPTH, start);
+}
+
+// Gain is already picked, fit the rest to what was measured
+void applyAutoset(const signal_stats_t *s) {
+    updateScale();
+    int hiDev = abs(scale_mv_lut[s->hi] - scale_center_mv);
+    int loDev = abs(scale_mv_lut[s->lo] - scale_center_mv);
+    float vdiv = autoset_round_125(((hiDev > loDev) ? hiDev : loDev) / 1000.0f / AUTOSET_HALF_DIVS);
+    voltsPerDiv = (vdiv < 0.1f) ? 0.1f : (vdiv > 100.0f) ? 100.0f : vdiv;
+
+    // A few cycles across the full-width plot; no period means it's slow or flat
+    float tdiv = AUTOSET_MAX_TDIV;
+    if (s->period) tdiv = roundf(10.0f * AUTOSET_PERIODS * s->period / (320 - MARGIN_LEFT - MARGIN_RIGHT));
+    timePerDiv = (tdiv < 1.0f) ? 1.0f : (tdiv > AUTOSET_MAX_TDIV) ? AUTOSET_MAX_TDIV : tdiv;
+
+    setTriggerCode(stats_trigger_code(s));
+}
+
+// --- PROTOCOL DECODE ---
+void setDecodeMode(int mode) {
+    decodeMode = mode;
+    decodeScroll = 0;
+    if (mode == DECODE_OFF) isDecodeTable = false;
+    decodeRequest = true;
+}
+
+// Whole ring in one go, thresholds from its own range. It's fed in time
+// order from the seam, the two sides of which are a whole lap apart, so
+// decoded sample k is ring slot seam + k, wrapped.
+void decodeRing(const uint8_t *ring, uint32_t count, uint32_t seam) {
+    uint8_t lo = 255, hi = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (ring[i] < lo) lo = ring[i];
+        if (ring[i] > hi) hi = ring[i];
+    }
+    decode_begin(decodeMode, lo, hi, decodeBaud, ADC_SAMPLE_RATE_HZ);
+    if (decode_needs_measure()) {
+        decode_measure(&ring[seam], count - seam);
+        decode_measure(ring, seam);
+    }
+    decode_start();
+    decode_feed(&ring[seam], count - seam);
+    decode_feed(ring, seam);
+}
+
+// --- MASK TEST ---
+// frame_buf is the ring as the DMA left it, so the trigger is at a different
+// slot every capture. The mask goes by position from the trigger instead:
+// maskFrame[k] is slot frame_trigger_index + k, wrapped.
+uint8_t maskFrame[MASK_LEN] __attribute__((aligned(4)));  // mask_test reads it a word at a time
+
+const uint8_t *alignMaskFrame() {
+    uint32_t t = frame_trigger_index % CAPTURE_DEPTH;
+    memcpy(maskFrame, &frame_buf[t], CAPTURE_DEPTH - t);
+    memcpy(&maskFrame[CAPTURE_DEPTH - t], frame_buf, t);
+    return maskFrame;
+}
+
+// Turning the test on learns the trace on screen, unless a mask was loaded
+void setMaskMode(int mode) {
+    if (mode != MASK_OFF && maskMode == MASK_OFF) {
+        if (!mask_defined()) mask_learn(alignMaskFrame(), MASK_LEARN_TOL);
+        mask_reset_counts();
+    }
+    maskMode = mode;
+}
+
+// Every live capture goes through here. True if a fail stopped the scope,
+// which leaves frame_buf alone until the stopped view has loaded it.
+bool testMaskFrame() {
+    if (maskMode == MASK_OFF || acqMode != ACQ_NORMAL || !isRunning) return false;
+    if (mask_test(alignMaskFrame())) return false;
+    // Recording already streams every frame
+    if (maskExport && !isRecording) stream_submit(frame_buf, CAPTURE_DEPTH, frame_trigger_index, currentGainMode);
+    if (maskMode != MASK_STOP) return false;
+    isRunning = false;
+    return true;
+}
+
+void handleEvent(const input_event_t *ev) {
+    bool pressed = (ev->type == EV_PRESS);
 
     if (isSnakeMode) {
-        // --- JOYSTICK INVERSION FIX ---
-        // JoyX > High = LEFT (3), JoyX < Low = RIGHT (1)
-        if(joyY < JOY_THRESHOLD_LOW && snakeDir != 2) snakeDir = 0; // Up
-        if(joyX > JOY_THRESHOLD_HIGH && snakeDir != 1) snakeDir = 3; // LEFT (Inverted from Right)
-        if(joyY > JOY_THRESHOLD_HIGH && snakeDir != 0) snakeDir = 2; // Down
-        if(joyX < JOY_THRESHOLD_LOW && snakeDir != 3) snakeDir = 1; // RIGHT (Inverted from Left)
-        
-        if(!(buttons & BTN_BACK)) {
-            isSnakeMode = false;
-            forceFullRedraw = true; 
+        if (pressed) {
+            if (ev->key == KEY_JOY_UP && snakeDir != 2) snakeDir = 0;
+            if (ev->key == KEY_JOY_LEFT && snakeDir != 1) snakeDir = 3;
+            if (ev->key == KEY_JOY_DOWN && snakeDir != 0) snakeDir = 2;
+            if (ev->key == KEY_JOY_RIGHT && snakeDir != 3) snakeDir = 1;
+            if (ev->key == BTN_BACK) {
+                isSnakeMode = false;
+                forceFullRedraw = true; 
+            }
         }
-        updateSnake();
         return; 
     }
 
-    static absolute_time_t lastStart = 0;
+    static uint32_t lastStart = 0;
     static int startCount = 0;
-    if (!(buttons & BTN_RECORD)) {
-        if (!btnRecordPressed) {
-            absolute_time_t now = get_absolute_time();
-            if(absolute_time_diff_us(lastStart, now) < 5000000) {
-                startCount++;
-            } else {
-                startCount = 1;
-            }
-            lastStart = now;
-            
-            if(startCount >= 3) {
-                isSnakeMode = true;
-                initSnake();
-                startCount = 0;
-            }
-            isRecording = !isRecording; 
+    if (pressed && ev->key == BTN_RECORD) {
+        if (ev->time_us - lastStart < 5000000) {
+            startCount++;
+        } else {
+            startCount = 1;
+        }
+        lastStart = ev->time_us;
+        
+        if(startCount >= 3) {
+            isSnakeMode = true;
+            initSnake();
+            startCount = 0;
         }
-        btnRecordPressed = true;
-    } else btnRecordPressed = false;
+        isRecording = !isRecording; 
+        if (isRecording) { isReplaying = false; rec_start(); }
+        else rec_stop();
+        return;
+    }
+
+    // Scope -> FFT -> histogram -> decode table (if decoding) -> scope
+    if (pressed && ev->key == BTN_FFT) {
+        if (isFFTMode) { isFFTMode = false; isHistMode = true; }
+        else if (isHistMode) { isHistMode = false; isDecodeTable = (decodeMode != DECODE_OFF); }
+        else if (isDecodeTable) isDecodeTable = false;
+        else isFFTMode = true;
+        return;
+    }
 
-    if ((buttons & MASK_X)) { if (!btnXPressed) { isFFTMode = !isFFTMode; btnXPressed = true; } } 
-    else { btnXPressed = false; }
+    if (isDecodeTable && !isMenuOpen && ev->type == EV_ROTATE) { decodeScroll += ev->delta; return; }
 
-    if (!(buttons & BTN_MENU)) { if (!btnMenuPressed) { isMenuOpen = !isMenuOpen; isEditing = false; forceFullRedraw = true; menuDirty = true; } btnMenuPressed = true; } else btnMenuPressed = false;
+    if (isHistMode && !isMenuOpen && pressed && ev->key == BTN_CONFIRM) { hist_reset(); return; }
 
-    bool nav_next = (joyY > JOY_THRESHOLD_HIGH); 
-    bool nav_prev = (joyY < JOY_THRESHOLD_LOW);
-    
-    if (nav_next || nav_prev || delta != 0) { if (isMenuOpen) menuDirty = true; }
-    
-    if (isMenuOpen) {
-        if (isEditing) {
-            if (delta != 0) {
-                switch(selectedMenuItem) {
-                    case MENU_V_DIV: voltsPerDiv += (delta * 0.1); if (voltsPerDiv < 0.1) voltsPerDiv = 0.1; forceFullRedraw = true; break;
-                    case MENU_T_DIV: timePerDiv += (delta * 1.0); if (timePerDiv < 1.0) timePerDiv = 1.0; forceFullRedraw = true; break;
-                    case MENU_GAIN: updateGainState(delta); forceFullRedraw = true; break;
-                    case MENU_CUR_V1: cursorV1_volts += (delta * 0.1); break;
-                    case MENU_CUR_V2: cursorV2_volts += (delta * 0.1); break;
+    if (pressed && ev->key == BTN_REPLAY) { if (!isRecording) isReplaying = !isReplaying; return; }
+
+    if (pressed && ev->key == BTN_MENU) { isMenuOpen = !isMenuOpen; isEditing = false; return; }
+
+    // Segmented mode with the menu shut: encoder browses, confirm re-arms
+    if (!isMenuOpen && acqMode == ACQ_SEGMENTED) {
+        if (ev->type == EV_ROTATE && seg_complete()) {
+            segSelected += ev->delta;
+            if (segSelected < -1) segSelected = -1;
+            if (segSelected >= seg_count()) segSelected = seg_count() - 1;
+        }
+        if (pressed && (ev->key == BTN_CONFIRM || ev->key == KEY_ENC_SW)) { segSelected = -1; seg_start(SEG_DEFAULT_COUNT); }
+        return;
+    }
+
+    // Deep mode with the menu shut: confirm takes a new record
+    if (!isMenuOpen && acqMode == ACQ_DEEP && pressed && ev->key == BTN_CONFIRM) { armDeep(); return; }
+
+    // Stopped viewer with the menu shut: the encoder does whatever its switch
+    // last picked, the stick zooms and pans, confirm goes back to the whole record
+    if (!isMenuOpen && isViewing) {
+        short quarter = (scopeWidth - MARGIN_LEFT - MARGIN_RIGHT) / 4;
+        if (ev->type == EV_ROTATE) {
+            switch (viewKnob) {
+                case KNOB_H_PAN: viewer_pan(ev->accel * VIEW_PAN_COLUMNS); break;
+                case KNOB_H_ZOOM: viewer_zoom(ev->delta); break;
+                case KNOB_V_PAN: {
+                    // No further than the edge of the input range
+                    float limit = fabsf(scale_mv_lut[255] - scale_mv_lut[0]) / 2000.0f;
+                    viewVOffset -= ev->accel * 0.25f * shownVoltsPerDiv();
+                    if (viewVOffset > limit) viewVOffset = limit;
+                    if (viewVOffset < -limit) viewVOffset = -limit;
+                    break;
                 }
+                case KNOB_V_ZOOM:
+                    viewVZoom += ev->delta;
+                    if (viewVZoom < 0) viewVZoom = 0;
+                    if (viewVZoom > VIEW_MAX_V_ZOOM) viewVZoom = VIEW_MAX_V_ZOOM;
+                    while (viewVZoom > 0 && voltsPerDiv / (1 << viewVZoom) < SCALE_MIN_VOLTS_PER_DIV) viewVZoom--;
+                    break;
             }
-            bool confirm = !(buttons & BTN_CONFIRM);
-            bool back = !(buttons & BTN_BACK);
-            if (currentEncSw && !encSwPressed) { confirm = true; encSwPressed = true; } else if (!currentEncSw) encSwPressed = false;
-            if (confirm && !btnConfirmPressed) { isEditing = false; btnConfirmPressed = true; menuDirty = true; forceFullRedraw = true; }
-            if (back && !btnBackPressed) { isEditing = false; btnBackPressed = true; menuDirty = true; forceFullRedraw = true; }
-        } else {
-            if (nav_prev) { if (!joyUpHeld) { selectedMenuItem--; if (selectedMenuItem < 0) selectedMenuItem = MENU_COUNT - 1; menuDirty = true; } joyUpHeld = true; } else joyUpHeld = false;
-            if (nav_next) { if (!joyDownHeld) { selectedMenuItem++; if (selectedMenuItem >= MENU_COUNT) selectedMenuItem = 0; menuDirty = true; } joyDownHeld = true; } else joyDownHeld = false;
-            bool confirm = !(buttons & BTN_CONFIRM);
-            if (currentEncSw && !encSwPressed) { confirm = true; encSwPressed = true; } else if (!currentEncSw) encSwPressed = false;
-            if (confirm && !btnConfirmPressed) {
-                if (selectedMenuItem == MENU_RUN_STOP) { isRunning = !isRunning; menuDirty = true; }
-                else if (selectedMenuItem == MENU_CURSORS_EN) { showCursors = !showCursors; menuDirty = true; }
-                else { isEditing = true; menuDirty = true; }
-                btnConfirmPressed = true; forceFullRedraw = true;
+        }
+        if (pressed && ev->key == KEY_ENC_SW) viewKnob = (viewKnob + 1) % KNOB_COUNT;
+        if (pressed && ev->key == KEY_JOY_UP) viewer_zoom(1);
+        if (pressed && ev->key == KEY_JOY_DOWN) viewer_zoom(-1);
+        if (pressed && ev->key == KEY_JOY_LEFT) viewer_pan(-quarter);
+        if (pressed && ev->key == KEY_JOY_RIGHT) viewer_pan(quarter);
+        if (pressed && ev->key == BTN_CONFIRM) { viewer_fit(); viewVZoom = 0; viewVOffset = 0.0f; }
+        viewDirty = true;
+        return;
+    }
+    if (!isMenuOpen && acqMode == ACQ_DEEP) return;
+
+    // Equivalent-time mode with the menu shut: confirm starts over
+    if (!isMenuOpen && acqMode == ACQ_ETS) {
+        if (pressed && ev->key == BTN_CONFIRM) ets_reset();
+        return;
+    }
+
+    if (!isMenuOpen) return;
+
+    // Everything below only cares about presses and the encoder
+    bool rotate = (ev->type == EV_ROTATE);
+    if (!pressed && !rotate) return;
+    bool confirm = pressed && (ev->key == BTN_CONFIRM || ev->key == KEY_ENC_SW);
+    bool back = pressed && ev->key == BTN_BACK;
+
+    if (isEditing) {
+        if (rotate) {
+            switch(selectedMenuItem) {
+                case MENU_V_DIV: voltsPerDiv += (ev->accel * 0.1); if (voltsPerDiv < 0.1) voltsPerDiv = 0.1; if (voltsPerDiv > 100.0f) voltsPerDiv = 100.0f; break;
+                case MENU_T_DIV: timePerDiv += (ev->accel * 1.0); if (timePerDiv < 1.0) timePerDiv = 1.0; break;
+                case MENU_GAIN: updateGainState(ev->delta); break;
+                case MENU_CUR_V1: cursorV1_volts += (ev->accel * 0.1); break;
+                case MENU_CUR_V2: cursorV2_volts += (ev->accel * 0.1); break;
+                case MENU_TRIG_LEVEL: setTriggerProbeVolts(pinToProbeVolts(triggerPinVolts) + ev->accel * 0.05f); autoTrigLevel = false; break;
+                case MENU_GEN_FREQ: awg_set_frequency(awg_frequency() * powf(1.05f, ev->accel)); break;
             }
         }
-    } 
-    if ((buttons & BTN_CONFIRM)) btnConfirmPressed = false;
-    if ((buttons & BTN_BACK)) btnBackPressed = false;
+        if (confirm || back) { isEditing = false; }
+    } else {
+        if (pressed && (ev->key == KEY_JOY_UP || ev->key == KEY_JOY_DOWN)) calibPrompt = false;
+        if (pressed && ev->key == KEY_JOY_UP) { selectedMenuItem--; if (selectedMenuItem < 0) selectedMenuItem = MENU_COUNT - 1; }
+        if (pressed && ev->key == KEY_JOY_DOWN) { selectedMenuItem++; if (selectedMenuItem >= MENU_COUNT) selectedMenuItem = 0; }
+        scrollMenuToSelection();
+        if (confirm) {
+            if (selectedMenuItem == MENU_RUN_STOP) { isRunning = !isRunning; }
+            else if (selectedMenuItem == MENU_CURSORS_EN) { showCursors = !showCursors; }
+            else if (selectedMenuItem == MENU_ACQ_MODE) { setAcqMode((acqMode + 1) % ACQ_COUNT); }
+            else if (selectedMenuItem == MENU_PERSIST) { persistMode = (persistMode + 1) % PERSIST_MODE_COUNT; }
+            else if (selectedMenuItem == MENU_AUTOSET) { autosetPending = true; }
+            else if (selectedMenuItem == MENU_CALIBRATE) {
+                // First press asks for the probe on DAC output B, second one runs
+                if (!calibPrompt) calibPrompt = true;
+                else { calibPrompt = false; startCalibration(); }
+            }
+            else if (selectedMenuItem == MENU_TRIG_AUTO) { autoTrigLevel = !autoTrigLevel; }
+            else if (selectedMenuItem == MENU_GEN) { awg_set_shape((awg_shape() + 1) % AWG_SHAPE_COUNT); }
+            else if (selectedMenuItem == MENU_DECODE) { setDecodeMode((decodeMode + 1) % DECODE_PROTO_COUNT); }
+            else if (selectedMenuItem == MENU_CHANNELS) { setMultiChannels((multiChannels - 1) % (MULTI_MAX_CHANNELS - 1) + 2); }
+            else if (selectedMenuItem == MENU_TRIG_SRC) { multiTrigSrc = (multiTrigSrc + 1) % multiChannels; }
+            else if (selectedMenuItem == MENU_MASK) { setMaskMode((maskMode + 1) % MASK_MODE_COUNT); }
+            else if (selectedMenuItem == MENU_INTERP) { interpMode = (interpMode + 1) % INTERP_MODE_COUNT; viewer_set_interp(interpMode); }
+            // The ETS span is fixed, T/Div only applies outside it
+            else if (!(selectedMenuItem == MENU_T_DIV && acqMode == ACQ_ETS)) { isEditing = true; }
+        }
+    }
+}
+
+// Drain the event queue. Only called when something is in it.
+void handleInput() {
+    input_event_t ev;
+    while (input_pop(&ev)) handleEvent(&ev);
+}
+
+// ==================== Remote control (SCPI) ==============
+// Same units as the on-screen readouts: V/div, ms/div, volts at the probe.
+// Handlers run on core 0 like the menu, so the UI picks changes up on its
+// next frame.
+#define SCPI_POLL_US            1000
+#define SCPI_MAX_CHARS_PER_POLL 64
+
+static const char *const gainChoices[] = { "LOW", "MEDium", "HIGH" };
+static const char *const onOffChoices[] = { "OFF", "ON" };
+
+void scpiTimebaseScale(const char *p) {
+    float v;
+    if (!scpi_param_float(&p, &v)) return;
+    if (v < 1.0f || v > 1000.0f) { scpi_error(SCPI_ERR_OUT_OF_RANGE); return; }
+    timePerDiv = v;
 }
+void scpiTimebaseScaleQ(const char *p) { printf("%g\n", timePerDiv); }
+
+void scpiChannelScale(const char *p) {
+    float v;
+    if (!scpi_param_float(&p, &v)) return;
+    if (v < 0.1f || v > 100.0f) { scpi_error(SCPI_ERR_OUT_OF_RANGE); return; }
+    voltsPerDiv = v;
+}
+void scpiChannelScaleQ(const char *p) { printf("%g\n", voltsPerDiv); }
+
+void scpiChannelGain(const char *p) {
+    int idx;
+    if (!scpi_param_choice(&p, gainChoices, 3, &idx)) return;
+    updateGainState(idx - currentGainMode);
+}
+void scpiChannelGainQ(const char *p) { printf("%s\n", (currentGainMode == SCOPE_GAIN_LOW) ? "LOW" : (currentGainMode == SCOPE_GAIN_MED) ? "MED" : "HIGH"); }
+
+void scpiTriggerLevel(const char *p) {
+    float v;
+    if (!scpi_param_float(&p, &v)) return;
+    if (!setTriggerProbeVolts(v)) { scpi_error(SCPI_ERR_OUT_OF_RANGE); return; }
+    autoTrigLevel = false;
+}
+void scpiTriggerLevelQ(const char *p) { printf("%g\n", pinToProbeVolts(triggerPinVolts)); }
+void scpiTriggerLevelAuto(const char *p) {
+    int idx;
+    if (scpi_param_choice(&p, onOffChoices, 2, &idx)) autoTrigLevel = idx;
+}
+void scpiTriggerLevelAutoQ(const char *p) { printf("%d\n", autoTrigLevel ? 1 : 0); }
+void scpiAutoscale(const char *p) { autosetPending = true; }
+
+// Probe on the offset output first. STATe? reports IDLE, RUNNING, DONE or FAILED.
+static const char *const calibStateNames[] = { "IDLE", "RUNNING", "DONE", "FAILED" };
+void scpiCalibrationStart(const char *p) {
+    if (calib_state() == CALIB_RUNNING) { scpi_error(SCPI_ERR_EXECUTION); return; }
+    startCalibration();
+}
+void scpiCalibrationStateQ(const char *p) { printf("%s\n", calibStateNames[calib_state()]); }
+// Per gain mode: uV per code, zero in codes
+void scpiCalibrationDataQ(const char *p) {
+    for (int i = 0; i < CALIB_MODES; i++) {
+        const calib_gain_t *c = calib_get(i);
+        printf("%s%lu,%.2f", i ? "," : "", (unsigned long)c->uv_per_code, c->zero_q8 / 256.0f);
+    }
+    printf("\n");
+}
+
+void scpiRun(const char *p) { isRunning = true; }
+void scpiStop(const char *p) { isRunning = false; }
+
+void scpiCursorV1(const char *p) { scpi_param_float(&p, &cursorV1_volts); }
+void scpiCursorV1Q(const char *p) { printf("%g\n", cursorV1_volts); }
+void scpiCursorV2(const char *p) { scpi_param_float(&p, &cursorV2_volts); }
+void scpiCursorV2Q(const char *p) { printf("%g\n", cursorV2_volts); }
+void scpiCursorState(const char *p) {
+    int idx;
+    if (scpi_param_choice(&p, onOffChoices, 2, &idx)) showCursors = idx;
+}
+void scpiCursorStateQ(const char *p) { printf("%d\n", showCursors ? 1 : 0); }
+
+// Binary data goes out as a stream frame (see stream.h), not as text
+void scpiWaveformData(const char *p) {
+    if (!stream_submit(frame_buf, CAPTURE_DEPTH, frame_trigger_index, currentGainMode)) scpi_error(SCPI_ERR_EXECUTION);
+}
+
+static void measureCurrentFrame(measurements_t *m) {
+    measure_frame(frame_buf, CAPTURE_DEPTH, frame_trigger_index, SAMPLE_RATE_HZ, m);
+}
+void scpiMeasureVpp(const char *p) { measurements_t m; measureCurrentFrame(&m); printf("%.3f\n", m.vpp_mv / 1000.0f); }
+void scpiMeasureVmax(const char *p) { measurements_t m; measureCurrentFrame(&m); printf("%.3f\n", m.vmax_mv / 1000.0f); }
+void scpiMeasureVmin(const char *p) { measurements_t m; measureCurrentFrame(&m); printf("%.3f\n", m.vmin_mv / 1000.0f); }
+void scpiMeasureVavg(const char *p) { measurements_t m; measureCurrentFrame(&m); printf("%.3f\n", m.vavg_mv / 1000.0f); }
+void scpiMeasureFreq(const char *p) { measurements_t m; measureCurrentFrame(&m); printf("%.1f\n", m.freq_hz); }
+
+// Function generator on the offset output. Volts are at the DAC pin.
+static const char *const awgChoices[] = { "OFF", "SINusoid", "SQUare", "TRIangle", "SWEep", "ARBitrary" };
+
+void scpiSourceFunction(const char *p) {
+    int idx;
+    if (scpi_param_choice(&p, awgChoices, AWG_SHAPE_COUNT, &idx)) awg_set_shape(idx);
+}
+void scpiSourceFunctionQ(const char *p) { printf("%s\n", awgNames[awg_shape()]); }
+void scpiSourceFrequency(const char *p) {
+    float v;
+    if (!scpi_param_float(&p, &v)) return;
+    if (v < AWG_MIN_FREQ_HZ || v > AWG_MAX_FREQ_HZ) { scpi_error(SCPI_ERR_OUT_OF_RANGE); return; }
+    awg_set_frequency(v);
+}
+void scpiSourceFrequencyQ(const char *p) { printf("%g\n", awg_frequency()); }
+void scpiSourceVoltage(const char *p) {
+    float v;
+    if (!scpi_param_float(&p, &v)) return;
+    if (v < 0.0f || v > DAC_VOLTS_MAX) { scpi_error(SCPI_ERR_OUT_OF_RANGE); return; }
+    awg_set_amplitude(v);
+}
+void scpiSourceOffset(const char *p) {
+    float v;
+    if (!scpi_param_float(&p, &v)) return;
+    if (v < 0.0f || v > DAC_VOLTS_MAX) { scpi_error(SCPI_ERR_OUT_OF_RANGE); return; }
+    awg_set_offset(v);
+}
+// Stop frequency and sweep time: SOUR:SWE 10000,2
+void scpiSourceSweep(const char *p) {
+    float stop, seconds;
+    if (!scpi_param_float(&p, &stop) || !scpi_param_float(&p, &seconds)) return;
+    if (stop < AWG_MIN_FREQ_HZ || stop > AWG_MAX_FREQ_HZ || seconds <= 0.0f) { scpi_error(SCPI_ERR_OUT_OF_RANGE); return; }
+    awg_set_sweep(stop, seconds);
+}
+// One period of points from -1 to 1, as many as fit on the line
+void scpiSourceData(const char *p) {
+    float points[SCPI_LINE_MAX / 2];
+    int n = 0;
+    while (*p && n < (int)count_of(points)) {
+        if (!scpi_param_float(&p, &points[n])) return;
+        n++;
+    }
+    if (n < 2) { scpi_error(SCPI_ERR_MISSING_PARAM); return; }
+    awg_load_table(points, n);
+}
+
+// Mask limits are raw ADC codes, same as WAVeform:DATA?. DATA takes the
+// first sample then lower,upper pairs, as many as fit on a line.
+void scpiMaskState(const char *p) {
+    int idx;
+    if (!scpi_param_choice(&p, onOffChoices, 2, &idx)) return;
+    if (!idx) setMaskMode(MASK_OFF);
+    else if (maskMode == MASK_OFF) setMaskMode(MASK_ON);
+}
+void scpiMaskStateQ(const char *p) { printf("%d\n", maskMode != MASK_OFF); }
+// Stop on fail, turns the test on if it isn't
+void scpiMaskStop(const char *p) {
+    int idx;
+    if (!scpi_param_choice(&p, onOffChoices, 2, &idx)) return;
+    if (idx) setMaskMode(MASK_STOP);
+    else if (maskMode == MASK_STOP) setMaskMode(MASK_ON);
+}
+void scpiMaskExport(const char *p) {
+    int idx;
+    if (scpi_param_choice(&p, onOffChoices, 2, &idx)) maskExport = idx;
+}
+// Learn from the current frame, tolerance in probe volts
+void scpiMaskCreate(const char *p) {
+    float v;
+    if (!scpi_param_float(&p, &v)) return;
+    float mvPerCode = fabsf(scale_mv_lut[255] - scale_mv_lut[0]) / 255.0f;
+    float codes = v * 1000.0f / mvPerCode;
+    if (codes < 0.0f || codes > 255.0f) { scpi_error(SCPI_ERR_OUT_OF_RANGE); return; }
+    mask_learn(alignMaskFrame(), (uint8_t)(codes + 0.5f));
+    mask_reset_counts();
+}
+// Limits by sample from the trigger, as alignMaskFrame lays them out
+void scpiMaskData(const char *p) {
+    float first, v[2];
+    uint8_t lo[SCPI_LINE_MAX / 4], hi[SCPI_LINE_MAX / 4];
+    int n = 0;
+    if (!scpi_param_float(&p, &first)) return;
+    while (*p && n < (int)count_of(lo)) {
+        if (!scpi_param_float(&p, &v[0]) || !scpi_param_float(&p, &v[1])) return;
+        if (v[0] < 0.0f || v[1] > 255.0f || v[0] > v[1]) { scpi_error(SCPI_ERR_OUT_OF_RANGE); return; }
+        lo[n] = v[0];
+        hi[n] = v[1];
+        n++;
+    }
+    if (first < 0.0f || first + n > MASK_LEN) { scpi_error(SCPI_ERR_OUT_OF_RANGE); return; }
+    mask_set((int)first, lo, hi, n);
+}
+void scpiMaskDataQ(const char *p) {
+    for (int i = 0; i < MASK_LEN; i++) printf("%s%d,%d", i ? "," : "", mask_lower(i), mask_upper(i));
+    printf("\n");
+}
+void scpiMaskClear(const char *p) { mask_clear(); }
+// Tested, passed, failed, samples outside, first bad sample of the last fail
+void scpiMaskCountQ(const char *p) {
+    const mask_counts_t *mc = mask_counts();
+    printf("%lu,%lu,%lu,%lu,%d\n", (unsigned long)mc->tested, (unsigned long)mc->passed,
+           (unsigned long)mc->failed, (unsigned long)mc->violations, mc->first_fail);
+}
+void scpiMaskReset(const char *p) { mask_reset_counts(); }
+
+// Protocol decode. BAUD 0 measures it from the capture.
+static const char *const decodeChoices[] = { "OFF", "UART", "I2C", "SPI" };
+void scpiDecodeProtocol(const char *p) {
+    int idx;
+    if (scpi_param_choice(&p, decodeChoices, DECODE_PROTO_COUNT, &idx)) setDecodeMode(idx);
+}
+void scpiDecodeProtocolQ(const char *p) { printf("%s\n", decodeNames[decodeMode]); }
+void scpiDecodeBaud(const char *p) {
+    float v;
+    if (!scpi_param_float(&p, &v)) return;
+    if (v < 0.0f || v > ADC_SAMPLE_RATE_HZ / 2) { scpi_error(SCPI_ERR_OUT_OF_RANGE); return; }
+    decodeBaud = (uint32_t)v;
+    decodeRequest = true;
+}
+// The rate in use, measured or not
+void scpiDecodeBaudQ(const char *p) {
+    uint32_t bit = decode_bit_q8();
+    printf("%lu\n", bit ? (unsigned long)(ADC_SAMPLE_RATE_HZ * 256ull / bit) : 0ul);
+}
+// Sample index (live: from the oldest sample), value and flags for every byte kept
+void scpiDecodeDataQ(const char *p) {
+    for (int i = 0; i < decode_count(); i++) {
+        const decode_event_t *e = decode_event(i);
+        printf("%s%lu,%u,%u", i ? "," : "", (unsigned long)e->start, e->value, e->flags);
+    }
+    printf("\n");
+}
+
+// Multi-channel. SCALe and OFFSet take the channel first, 2 or 3; CH1 is
+// the probe and follows CHANnel:SCALe.
+void scpiMultiChannels(const char *p) {
+    float v;
+    if (!scpi_param_float(&p, &v)) return;
+    if (v < 2.0f || v > MULTI_MAX_CHANNELS) { scpi_error(SCPI_ERR_OUT_OF_RANGE); return; }
+    setMultiChannels((int)v);
+}
+void scpiMultiChannelsQ(const char *p) { printf("%d\n", multiChannels); }
+static const char *const chanChoices[] = { "CH1", "CH2", "CH3" };
+void scpiMultiTrigSource(const char *p) {
+    int idx;
+    if (!scpi_param_choice(&p, chanChoices, MULTI_MAX_CHANNELS, &idx)) return;
+    if (idx >= multiChannels) { scpi_error(SCPI_ERR_OUT_OF_RANGE); return; }
+    multiTrigSrc = idx;
+}
+void scpiMultiTrigSourceQ(const char *p) { printf("%s\n", chanChoices[multiTrigSrc]); }
+// Channel number, checked, or -1
+static int scpiAuxChannel(const char **p) {
+    float ch;
+    if (!scpi_param_float(p, &ch)) return -1;
+    if (ch < 2.0f || ch > MULTI_MAX_CHANNELS) { scpi_error(SCPI_ERR_OUT_OF_RANGE); return -1; }
+    return (int)ch - 1;
+}
+void scpiMultiScale(const char *p) {
+    float v;
+    int ch = scpiAuxChannel(&p);
+    if (ch < 0 || !scpi_param_float(&p, &v)) return;
+    if (v < 0.1f || v > 10.0f) { scpi_error(SCPI_ERR_OUT_OF_RANGE); return; }
+    chanVoltsPerDiv[ch] = v;
+}
+void scpiMultiOffset(const char *p) {
+    float v;
+    int ch = scpiAuxChannel(&p);
+    if (ch < 0 || !scpi_param_float(&p, &v)) return;
+    if (fabsf(v) > SCALE_ADC_FULL_SCALE) { scpi_error(SCPI_ERR_OUT_OF_RANGE); return; }
+    chanOffset[ch] = v;
+}
+
+static const scpi_command_t scpiCommands[] = {
+    { "TIMebase:SCALe",     scpiTimebaseScale },
+    { "TIMebase:SCALe?",    scpiTimebaseScaleQ },
+    { "CHANnel:SCALe",      scpiChannelScale },
+    { "CHANnel:SCALe?",     scpiChannelScaleQ },
+    { "CHANnel:GAIN",       scpiChannelGain },
+    { "CHANnel:GAIN?",      scpiChannelGainQ },
+    { "TRIGger:LEVel",      scpiTriggerLevel },
+    { "TRIGger:LEVel?",     scpiTriggerLevelQ },
+    { "TRIGger:LEVel:AUTO", scpiTriggerLevelAuto },
+    { "TRIGger:LEVel:AUTO?", scpiTriggerLevelAutoQ },
+    { "AUToscale",          scpiAutoscale },
+    { "CALibration:STARt",  scpiCalibrationStart },
+    { "CALibration:STATe?", scpiCalibrationStateQ },
+    { "CALibration:DATA?",  scpiCalibrationDataQ },
+    { "RUN",                scpiRun },
+    { "STOP",               scpiStop },
+    { "CURSor:V1",          scpiCursorV1 },
+    { "CURSor:V1?",         scpiCursorV1Q },
+    { "CURSor:V2",          scpiCursorV2 },
+    { "CURSor:V2?",         scpiCursorV2Q },
+    { "CURSor:STATe",       scpiCursorState },
+    { "CURSor:STATe?",      scpiCursorStateQ },
+    { "WAVeform:DATA?",     scpiWaveformData },
+    { "MEASure:VPP?",       scpiMeasureVpp },
+    { "MEASure:VMAX?",      scpiMeasureVmax },
+    { "MEASure:VMIN?",      scpiMeasureVmin },
+    { "MEASure:VAVerage?",  scpiMeasureVavg },
+    { "MEASure:FREQuency?", scpiMeasureFreq },
+    { "SOURce:FUNCtion",    scpiSourceFunction },
+    { "SOURce:FUNCtion?",   scpiSourceFunctionQ },
+    { "SOURce:FREQuency",   scpiSourceFrequency },
+    { "SOURce:FREQuency?",  scpiSourceFrequencyQ },
+    { "SOURce:VOLTage",     scpiSourceVoltage },
+    { "SOURce:VOLTage:OFFSet", scpiSourceOffset },
+    { "SOURce:SWEep",       scpiSourceSweep },
+    { "SOURce:DATA",        scpiSourceData },
+    { "MASK:STATe",         scpiMaskState },
+    { "MASK:STATe?",        scpiMaskStateQ },
+    { "MASK:STOP",          scpiMaskStop },
+    { "MASK:EXPort",        scpiMaskExport },
+    { "MASK:CREate",        scpiMaskCreate },
+    { "MASK:DATA",          scpiMaskData },
+    { "MASK:DATA?",         scpiMaskDataQ },
+    { "MASK:CLEar",         scpiMaskClear },
+    { "MASK:COUNt?",        scpiMaskCountQ },
+    { "MASK:RESet",         scpiMaskReset },
+    { "DECode:PROTocol",    scpiDecodeProtocol },
+    { "DECode:PROTocol?",   scpiDecodeProtocolQ },
+    { "DECode:BAUD",        scpiDecodeBaud },
+    { "DECode:BAUD?",       scpiDecodeBaudQ },
+    { "DECode:DATA?",       scpiDecodeDataQ },
+    { "MULTi:CHANnels",     scpiMultiChannels },
+    { "MULTi:CHANnels?",    scpiMultiChannelsQ },
+    { "MULTi:TRIGger:SOURce", scpiMultiTrigSource },
+    { "MULTi:TRIGger:SOURce?", scpiMultiTrigSourceQ },
+    { "MULTi:SCALe",        scpiMultiScale },
+    { "MULTi:OFFSet",       scpiMultiOffset },
+};
 
 // ==================== Graphics thread ====================
 static PT_THREAD (protothread_graphics(struct pt *pt))
 {
     PT_BEGIN(pt);
     while(1){
-        handleInput();
+        if (input_pending()) handleInput();
+        if (isSnakeMode) updateSnake();
+
+        // Nothing pressed for a while: poll the gamepad slowly, and if the
+        // trace is frozen too there's no reason to redraw at 60FPS
+        bool idle = input_idle_us() > IDLE_TIMEOUT_US && !isSnakeMode;
+        if (idle != inputIdle) {
+            inputIdle = idle;
+            seesaw_set_poll_period(idle ? SEESAW_IDLE_POLL_PERIOD_US : SEESAW_POLL_PERIOD_US);
+        }
+
         drawUI();
-        PT_YIELD_usec(16667); //60FPS 
+        PT_YIELD_usec((inputIdle && !isRunning) ? IDLE_FRAME_PERIOD_US : FRAME_PERIOD_US);
+    }
+    PT_END(pt);
+}
+
+// ==================== Input thread =======================
+// The encoder is decoded in PIO with no interrupt, so poll it into the queue
+static PT_THREAD (protothread_input(struct pt *pt))
+{
+    PT_BEGIN(pt);
+    while(1){
+        input_poll_encoder();
+        PT_YIELD_usec(inputIdle ? IDLE_ENCODER_POLL_US : ENCODER_POLL_US);
+    }
+    PT_END(pt);
+}
+
+// ==================== SCPI thread ========================
+// Commands arrive over USB (or UART) stdio. Takes what's buffered without
+// waiting and parses it a character at a time.
+static PT_THREAD (protothread_scpi(struct pt *pt))
+{
+    PT_BEGIN(pt);
+    while(1){
+        int n = 0;
+        int c;
+        // Replies go out whole: core 1 holds its stream frames until we let go
+        if (stream_port_claim()) {
+            while (n < SCPI_MAX_CHARS_PER_POLL && (c = getchar_timeout_us(0)) != PICO_ERROR_TIMEOUT) {
+                scpi_feed((char)c);
+                n++;
+            }
+            stdio_flush();
+            stream_port_release();
+        }
+        PT_YIELD_usec(n ? 0 : SCPI_POLL_US);
     }
     PT_END(pt);
 }
@@ -693,7 +2328,205 @@ static PT_THREAD (protothread_trigger(struct pt *pt))
     PT_BEGIN(pt);
     while(1){
         PT_SEM_WAIT(pt, &trigger_semaphore); 
+        // Live captures wait while a recording is playing into frame_buf
+        PT_WAIT_UNTIL(pt, !isReplaying);
+        static bool fresh;
+        fresh = trigger_fired;
         trigger_copy();
+        // Hold a failing frame until the stopped view has its own copy
+        if (fresh && testMaskFrame()) PT_WAIT_UNTIL(pt, isViewing || isRunning);
+        if (fresh && isRunning && decodeMode != DECODE_OFF) decodeRequest = true;
+        if (isRunning && persistActive()) persistAddFrame();
+        // START streams every capture to the host and records it to flash
+        if (isRecording) {
+            stream_submit(frame_buf, CAPTURE_DEPTH, frame_trigger_index, currentGainMode);
+            rec_append(frame_buf, CAPTURE_DEPTH, frame_trigger_index, currentGainMode,
+                       (uint32_t)(voltsPerDiv * 1000.0f), (uint16_t)timePerDiv);
+        }
+    }
+    PT_END(pt);
+}
+
+// ==================== Decode thread ======================
+// A live frame decodes in one go, since frame_buf only changes while this
+// thread is yielded. A stopped view or deep record goes a chunk at a time,
+// copied out of the viewer's source, starting over if it changes.
+static PT_THREAD (protothread_decode(struct pt *pt))
+{
+    PT_BEGIN(pt);
+    static uint32_t pos, len;
+    static int pass;
+    static uint8_t chunk[DECODE_CHUNK];
+    while(1){
+        PT_WAIT_UNTIL(pt, decodeRequest && decodeMode != DECODE_OFF);
+        decodeRequest = false;
+        if (!isViewing) {
+            if (acqMode == ACQ_NORMAL) {
+                decodeSeam = frame_trigger_index % CAPTURE_DEPTH;
+                decodeRing(frame_buf, CAPTURE_DEPTH, decodeSeam);
+            }
+            decodeGen++;
+            // No more often than the screen shows it
+            PT_YIELD_usec(FRAME_PERIOD_US);
+            continue;
+        }
+
+        len = viewer_length();
+        uint8_t lo, hi;
+        viewer_minmax(0, len, &lo, &hi);
+        decode_begin(decodeMode, lo, hi, decodeBaud, ADC_SAMPLE_RATE_HZ);
+        for (pass = decode_needs_measure() ? 0 : 1; pass < 2 && !decodeRequest; pass++) {
+            if (pass == 1) decode_start();
+            for (pos = 0; pos < len && !decodeRequest; pos += DECODE_CHUNK) {
+                uint32_t n = (len - pos < DECODE_CHUNK) ? len - pos : DECODE_CHUNK;
+                for (uint32_t i = 0; i < n; i++) chunk[i] = viewer_sample(pos + i);
+                if (pass == 0) decode_measure(chunk, n);
+                else decode_feed(chunk, n);
+                PT_YIELD_usec(0);
+            }
+        }
+        decodeGen++;
+    }
+    PT_END(pt);
+}
+
+// ==================== Replay thread ======================
+// Plays the last flash recording back through frame_buf at the speed it
+// was recorded, with the settings it was recorded at
+static PT_THREAD (protothread_replay(struct pt *pt))
+{
+    PT_BEGIN(pt);
+    static rec_cursor_t cursor;
+    static rec_frame_header_t hdr;
+    static uint8_t replayBuf[CAPTURE_DEPTH];
+    static uint32_t lastTimeMs;
+    static float savedVoltsPerDiv, savedTimePerDiv;
+    static int savedGainMode;
+    while(1){
+        PT_WAIT_UNTIL(pt, isReplaying);
+        PT_WAIT_UNTIL(pt, rec_flushed());
+        savedVoltsPerDiv = voltsPerDiv;
+        savedTimePerDiv = timePerDiv;
+        savedGainMode = currentGainMode;
+        lastTimeMs = 0;
+
+        if (rec_replay_open(&cursor)) {
+            while (isReplaying && rec_replay_next(&cursor, replayBuf, CAPTURE_DEPTH, &hdr)) {
+                uint32_t gapUs = lastTimeMs ? (hdr.time_ms - lastTimeMs) * 1000 : 0;
+                lastTimeMs = hdr.time_ms;
+                if (gapUs < FRAME_PERIOD_US) gapUs = FRAME_PERIOD_US;
+                if (gapUs > REPLAY_MAX_GAP_US) gapUs = REPLAY_MAX_GAP_US;
+                PT_YIELD_usec(gapUs);
+                if (!isReplaying) break;
+
+                memcpy(frame_buf, replayBuf, hdr.sample_count);
+                frame_trigger_index = hdr.trigger_index;
+                voltsPerDiv = hdr.vdiv_mv / 1000.0f;
+                timePerDiv = hdr.tdiv_ms;
+                updateGainState(hdr.gain - currentGainMode);
+                if (persistActive()) persistAddFrame();
+            }
+        }
+
+        voltsPerDiv = savedVoltsPerDiv;
+        timePerDiv = savedTimePerDiv;
+        updateGainState(savedGainMode - currentGainMode);
+        isReplaying = false;
+    }
+    PT_END(pt);
+}
+
+// ==================== Auto-setup thread ==================
+// Reads the free-running ADC ring, so it works when nothing triggers.
+// Auto-setup starts at the lowest gain and lets each measurement predict
+// the best higher one, then checks it, instead of trying every setting.
+static PT_THREAD (protothread_autoset(struct pt *pt))
+{
+    PT_BEGIN(pt);
+    static signal_stats_t stats;
+    static autolevel_t level;
+    static int pass, snap;
+    static uint8_t code;
+    while(1){
+        if (autosetPending) {
+            setAcqMode(ACQ_NORMAL);
+            isRunning = true;
+            updateGainState(SCOPE_GAIN_LOW - currentGainMode);
+            for (pass = 0; pass < AUTOSET_GAIN_PASSES; pass++) {
+                PT_YIELD_usec(AUTOSET_SETTLE_US);
+                stats_reset(&stats);
+                for (snap = 0; snap < AUTOSET_SNAPSHOTS; snap++) {
+                    snapshotRing(&stats);
+                    PT_YIELD_usec(AUTOSET_SNAPSHOT_US);
+                }
+                // Last pass keeps its gain so the stats match it
+                int gain = autoset_pick_gain(&stats, currentGainMode, gainFactors, count_of(gainFactors));
+                if (gain == currentGainMode || pass == AUTOSET_GAIN_PASSES - 1) break;
+                updateGainState(gain - currentGainMode);
+            }
+            applyAutoset(&stats);
+            autolevel_reset(&level);
+            autosetPending = false;
+        } else if (autoTrigLevel && acqMode != ACQ_DEEP && acqMode != ACQ_XY && acqMode != ACQ_MULTI && !isReplaying) {
+            stats_reset(&stats);
+            snapshotRing(&stats);
+            if (autolevel_update(&level, &stats, &code)) setTriggerCode(code);
+        } else {
+            autolevel_reset(&level);
+        }
+        PT_YIELD_usec(AUTOLEVEL_PERIOD_US);
+    }
+    PT_END(pt);
+}
+
+// ==================== Calibration thread =================
+static PT_THREAD (protothread_calib(struct pt *pt))
+{
+    PT_BEGIN(pt);
+    while(1){
+        PT_WAIT_UNTIL(pt, calib_state() == CALIB_RUNNING);
+        while (calib_service()) PT_YIELD_usec(CALIB_POLL_US);
+        // The routine switched relays itself, put back the UI's gain with
+        // the new numbers
+        updateGainState(0);
+    }
+    PT_END(pt);
+}
+
+// ==================== Settings thread ====================
+// Saves the front panel once it has sat still for a few seconds. Replay
+// and auto-setup swap settings in and out, so nothing is saved during them.
+static PT_THREAD (protothread_settings(struct pt *pt))
+{
+    PT_BEGIN(pt);
+    static settings_t saved, latest, now;
+    static uint32_t changedMs, nowMs;
+    collectSettings(&saved);
+    latest = saved;
+    while(1){
+        PT_YIELD_usec(SETTINGS_POLL_US);
+        if (isReplaying || isRecording || autosetPending || calib_state() == CALIB_RUNNING) continue;
+        collectSettings(&now);
+        nowMs = to_ms_since_boot(get_absolute_time());
+        if (memcmp(&now, &latest, sizeof(now)) != 0) {
+            latest = now;
+            changedMs = nowMs;
+        } else if (memcmp(&latest, &saved, sizeof(latest)) != 0 && nowMs - changedMs >= SETTINGS_SAVE_DELAY_MS) {
+            // On a failed write try again after another delay
+            if (settings_save(&latest)) saved = latest;
+            else changedMs = nowMs;
+        }
+    }
+    PT_END(pt);
+}
+
+// ==================== Recorder Flush Thread ==============
+// Erases and programs flash for the recorder, one op per pass
+static PT_THREAD (protothread_recorder(struct pt *pt))
+{
+    PT_BEGIN(pt);
+    while(1){
+        PT_YIELD_usec(rec_service() ? 0 : 1000);
     }
     PT_END(pt);
 }
@@ -726,56 +2559,123 @@ static PT_THREAD (protothread_fft_calc(struct pt *pt))
     PT_END(pt);
 }
 
+// ==================== Acquisition Thread =================
+// Deep memory: builds the min/max pyramid behind the DMA and stops the
+// record once the post-trigger half is in. Equivalent time: bins each
+// trigger's samples once they've landed, well before the ring laps them.
+// Histogram: counts every sample the ring holds since the last pass.
+// XY: plots the interleaved pairs the same way. Multi-channel: looks for
+// the software trigger and splits the frame out per channel.
+static PT_THREAD (protothread_acquire(struct pt *pt))
+{
+    PT_BEGIN(pt);
+    while(1){
+        bool busy = deep_service();
+        busy |= ets_service();
+        busy |= hist_service();
+        busy |= xy_service();
+        busy |= multi_service();
+        PT_YIELD_usec(busy ? 0 : 200);
+    }
+    PT_END(pt);
+}
+
+// ==================== USB Stream Thread ==================
+// Drains the frame pool to USB. Sends back to back while there's a
+// backlog, otherwise checks once a millisecond.
+static PT_THREAD (protothread_stream(struct pt *pt))
+{
+    PT_BEGIN(pt);
+    while(1){
+        PT_YIELD_usec(stream_service() ? 0 : 1000);
+    }
+    PT_END(pt);
+}
+
 // Entry point for core 0
 void core0_entry() {
     pt_add_thread(protothread_trigger);
     pt_add_thread(protothread_graphics);
+    pt_add_thread(protothread_input);
+    pt_add_thread(protothread_scpi);
+    pt_add_thread(protothread_replay);
+    pt_add_thread(protothread_autoset);
+    pt_add_thread(protothread_calib);
+    pt_add_thread(protothread_settings);
+    pt_add_thread(protothread_decode);
     pt_schedule_start ;
 }
 
 // Entry point for core 1
 void core1_entry() {
+    // Calibration writes flash from core 0, which needs this core parked
+    multicore_lockout_victim_init();
     pt_add_thread(protothread_blinky);
     pt_add_thread(protothread_fft_calc); 
+    pt_add_thread(protothread_stream);
+    pt_add_thread(protothread_recorder);
+    pt_add_thread(protothread_acquire);
     pt_schedule_start ;
 }
 
 // --- Main ---
 int main() {
     stdio_init_all(); 
-    
+
+    // The panel and the gamepad both need a while after power-up. Start
+    // them first and bring everything else up in the meantime.
+    tft_init_hw();
+    tft_reset_start();
+    seesaw_init();
+    absolute_time_t seesawReady = make_timeout_time_ms(SEESAW_BOOT_MS);
+
     gpio_init(PICO_DEFAULT_LED_PIN);
     gpio_set_dir(PICO_DEFAULT_LED_PIN, GPIO_OUT);
 
-    i2c_init(I2C_PORT, 400 * 1000); 
-    gpio_set_function(I2C_SDA_PIN, GPIO_FUNC_I2C);
-    gpio_set_function(I2C_SCL_PIN, GPIO_FUNC_I2C);
-    gpio_pull_up(I2C_SDA_PIN);
-    gpio_pull_up(I2C_SCL_PIN);
+    restoreSettings();
+    calib_init();
+    initDac();
+    int dac_val = setVoltage(CHAN_TRIG, triggerPinVolts);
+    awg_init();
+    mask_clear();
+
+    stream_init(SAMPLE_RATE_HZ);
+    scpi_init("Cornell ECE5730,ScopeBoy,0,1.0", scpiCommands, count_of(scpiCommands));
+    init_adc_capture();
+    ets_init();
+    init_trigger();
+    gpio_set_irq_enabled_with_callback(TRIG, GPIO_IRQ_EDGE_RISE, true, &gpio_callback);
+    // The trigger preempts the seesaw alarm, DAC, AWG and TFT IRQs, which all
+    // sit at the default priority. ETS times the edge from IRQ entry, and one
+    // of its bins is only ~16 cycles.
+    irq_set_priority(IO_IRQ_BANK0, PICO_HIGHEST_IRQ_PRIORITY);
     
-    sleep_ms(100); 
+    // Restored (or default) gain: relays and calibrated factor
+    updateGainState(0);
+    scale_set_limits(MARGIN_TOP, 240 - MARGIN_BOTTOM);
+    updateScale(); // core 1's DFT reads the tables, build them before it starts
+    interp_init();
+    viewer_set_interp(interpMode);
+
+    // Panel reset has been running all along, this only waits for what's left.
+    // No clear here: the grid widget covers the whole panel and its first
+    // draw blacks it anyway, and each full-panel write costs ~80 ms.
+    tft_begin();
+    tft_setRotation(3); 
+    initWidgets();
+    for(int i=0; i<320; i++) oldWaveY[i] = 120;
 
+    sleep_until(seesawReady);
     uint32_t digital_pins = MASK_A | MASK_B | MASK_X | MASK_Y | MASK_START | MASK_SELECT;
     seesaw_pin_mode_bulk(digital_pins); 
+    input_init();
+    seesaw_start_polling(SEESAW_POLL_PERIOD_US);
 
     rotary_init(); 
 
-    tft_init_hw();
-    tft_begin();
-    tft_setRotation(3); 
-    tft_fillScreen(TFT_BLACK);
-    
-    initDac();
-    int dac_val = setVoltage(CHAN_TRIG, 1.65f);
-    
-    for(int i=0; i<320; i++) oldWaveY[i] = 120;
-
-    init_adc_capture();
-    init_trigger();
-    
-    // Set Initial Gain State
-    currentGainMode = SCOPE_GAIN_MED;
-    updateGainState(0); // Applies factor 0.39 and relays
+    // Core 1 writes the recording to flash, which needs core 0 parked
+    multicore_lockout_victim_init();
+    rec_init();
 
     // start core 1 
     multicore_reset_core1();
@@ -790,34 +2690,6 @@ int main() {
     return 0;
 }
 
-// --- I2C Implementations ---
-void seesaw_pin_mode_bulk(uint32_t pins) {
-    uint8_t buf[6];
-    buf[0] = SEESAW_GPIO_BASE; buf[1] = SEESAW_GPIO_BULK_SET; 
-    buf[2] = (pins >> 24) & 0xFF; buf[3] = (pins >> 16) & 0xFF;
-    buf[4] = (pins >> 8) & 0xFF; buf[5] = pins & 0xFF;
-    i2c_write_blocking(I2C_PORT, SEESAW_I2C_ADDR, buf, 6, false);
-}
-
-uint32_t seesaw_read_buttons() {
-    uint8_t write_buf[2] = {SEESAW_GPIO_BASE, SEESAW_GPIO_BULK};
-    uint8_t read_buf[4];
-    i2c_write_blocking(I2C_PORT, SEESAW_I2C_ADDR, write_buf, 2, false); 
-    sleep_us(600); 
-    i2c_read_blocking(I2C_PORT, SEESAW_I2C_ADDR, read_buf, 4, false); 
-    return ((uint32_t)read_buf[0] << 24) | ((uint32_t)read_buf[1] << 16) | 
-           ((uint32_t)read_buf[2] << 8) | (uint32_t)read_buf[3];
-}
-
-uint16_t seesaw_read_analog(uint8_t pin) {
-    uint8_t write_buf[2] = {SEESAW_ADC_BASE, (uint8_t)(SEESAW_ADC_OFFSET + pin)};
-    uint8_t read_buf[2];
-    i2c_write_blocking(I2C_PORT, SEESAW_I2C_ADDR, write_buf, 2, false);
-    sleep_us(1000); 
-    i2c_read_blocking(I2C_PORT, SEESAW_I2C_ADDR, read_buf, 2, false);
-    return ((uint16_t)read_buf[0] << 8) | read_buf[1];
-}
-
 void computeDFT() {
     if (!windowInitialized) {
         for (int i = 0; i < NUM_SAMPLES; i++) {
@@ -833,11 +2705,8 @@ void computeDFT() {
             float angle = 2 * 3.14159 * t * k / 128;
             
             // Adjust DFT for new gain scale (remove effective DC offset)
-            float sample = raw_to_real_volts(frame_buf[t]); 
-            // We need to center this. Center V is 1.65 / Gain
-            float center = 1.65f / hardwareGainFactor;
-            
-            sample -= center; // Remove DC component for FFT
+            // Centered on ADC mid-scale to remove the DC component
+            float sample = (scale_mv_lut[frame_buf[t]] - scale_center_mv) * 0.001f;
             sample *= hanning_window[t];
 
             sumReal += sample * cos(angle);
@@ -94,6 +94,14 @@ pio_spi_inst_t spi = { //The SPI instance
 
 uint offset; //Offset for the program to load
 
+//The panel can't be lit before ~125 ms from power-up: the 120 ms below is
+//the datasheet floor from reset to Sleep Out, plus 5 ms after it.
+#define TFT_RESET_WAIT_MS  120 //After reset before Sleep Out may be sent
+#define TFT_SLPOUT_WAIT_MS 5 //After Sleep Out before the next command
+
+static absolute_time_t reset_ready; //When the panel will take Sleep Out
+static bool reset_started = false;
+
 volatile char flag = 1; //flag to mark completion of an SPI transaction
 
 void pioPinHandler(){ //The PIO interrupt handler
@@ -122,7 +130,6 @@ void tft_init_hw(void){
     pio_set_irq0_source_enabled(spi.pio, PIO_INTR_SM0_LSB, true); //Enable/Disable a single source on a PIO's IRQ 0
 	irq_set_exclusive_handler(PIO0_IRQ_0, pioPinHandler); //Set an exclusive interrupt handler for an interrupt on the executing core
 	irq_set_enabled(PIO0_IRQ_0, true); //Enable or disable a specific interrupt on the executing core
-	sleep_ms(500); //Sleep for 500ms
 }
 
 static inline void _rst_low(){ //Function to set the RST pin low
@@ -149,6 +156,18 @@ static inline void _cs_high(){ //Function to set the CS pin high
 	gpio_put(CS, 1);
 }
 
+//Pulse RST and note when the panel will be ready. Call it early and bring
+//up everything else while the panel resets, tft_begin waits out the rest.
+void tft_reset_start(void){
+	_dc_low();
+	_cs_high();
+	_rst_low();
+	busy_wait_us(20); //Reset pulse only needs 10us
+	_rst_high();
+	reset_ready = make_timeout_time_ms(TFT_RESET_WAIT_MS);
+	reset_started = true;
+}
+
 //Function to transmit a word to the SPI PIO
 void __time_critical_func(pio_spi_write8_blocking)(const pio_spi_inst_t *spi, const uint8_t *src, size_t len){
     size_t tx_remain = len;
@@ -203,17 +222,9 @@ void tft_writedata16(unsigned short c) { //Send 16-bit data to the TFT screen
 }
 
 void tft_begin(void) { //Initialize the TFT screen
-	sleep_ms(500);
-	_rst_low();
-	_dc_low();
-	_cs_high();
-
-	_rst_high();
-	sleep_ms(5);
-	_rst_low();
-	sleep_ms(20);
-	_rst_high();
-	sleep_ms(150);
+	if (!reset_started) tft_reset_start();
+	sleep_until(reset_ready); //Whatever is left of the reset time
+	reset_started = false;
 
 	tft_writecommand(0xEF);
 	tft_writedata(0x03);
@@ -319,9 +330,8 @@ void tft_begin(void) { //Initialize the TFT screen
 	tft_writedata(0x0F);
 
 	tft_writecommand(ILI9340_SLPOUT); //Exit Sleep
-	sleep_ms(120);
+	sleep_ms(TFT_SLPOUT_WAIT_MS);
 	tft_writecommand(ILI9340_DISPON); //Display on
-	sleep_ms(500);
 }
 
 /* Draw a pixel at location (x,y) with given color
@@ -133,6 +133,7 @@
 #define swap(a, b) {short t = a; a = b; b = t;}
 
 void tft_init_hw(void);
+void tft_reset_start(void);
 void tft_spiwrite(unsigned char c);
 void tft_spiwrite8(unsigned char c);
 void tft_spiwrite16(unsigned short c);
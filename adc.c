@@ -10,9 +10,6 @@
 #define SEL_0 9
 #define SEL_1 8
 
-// Channel 0 is GPIO26
-#define CAPTURE_CHANNEL 0
-
 #define ADC_RESOLUTION 256.0 // 8-bit adc
 
 uint8_t capture_buf[CAPTURE_DEPTH];
@@ -22,6 +19,16 @@ volatile bool trigger_fired = false;  // set by ISR
 volatile bool capture_ready = false;  // main loop can use frame_buf when true
 volatile bool trigger_armed = true;   // allow/ignore triggers
 
+volatile uint16_t trigger_index = 0;
+uint16_t frame_trigger_index = 0;
+
+static uint ctrl_chan;
+static uint data_chan;
+
+// Ring the DMA is currently filling
+static uint8_t *ring_buf = capture_buf;
+static uint ring_len = CAPTURE_DEPTH;
+
 // Pointer to the address of the ADC array
 uint8_t * dma_address_pointer = &capture_buf[0] ;
 
@@ -56,8 +63,8 @@ void init_adc_capture(){
     // intervals). This is all timed by the 48 MHz ADC clock.
     adc_set_clkdiv(0);
 
-    uint ctrl_chan = dma_claim_unused_channel(true);
-    uint data_chan = dma_claim_unused_channel(true);
+    ctrl_chan = dma_claim_unused_channel(true);
+    data_chan = dma_claim_unused_channel(true);
 
     // Set up control channel
     // Setup the control channel
@@ -103,6 +110,92 @@ void init_adc_capture(){
 
 }
 
+// Where in the ring the next sample will land. In RAM, the ETS trigger IRQ spins on it.
+uint __time_critical_func(adc_capture_write_index)(){
+    uint idx = dma_hw->ch[data_chan].write_addr - (uintptr_t)ring_buf;
+    // Between the end of the buffer and the control channel's reload
+    if (idx >= ring_len) idx = 0;
+    return idx;
+}
+
+// Point the free-running capture at a different ring (deep memory, or back
+// to capture_buf). Sampling restarts from the start of the new ring.
+void adc_capture_retarget(uint8_t *buf, uint len){
+    adc_run(false);
+
+    // Aborting a channel can fire its chain (RP2040-E13), so abort the
+    // control channel on both sides of the data channel
+    dma_channel_abort(ctrl_chan);
+    dma_channel_abort(data_chan);
+    dma_channel_abort(ctrl_chan);
+    adc_fifo_drain();
+
+    ring_buf = buf;
+    ring_len = len;
+    dma_address_pointer = buf;
+    dma_channel_set_trans_count(data_chan, len, false);
+    dma_channel_set_write_addr(data_chan, buf, true);
+
+    adc_run(true);
+}
+
+// Take turns between inputs (bit n = channel n, GPIO 26 + n). The ring
+// starts over on the lowest one, so with two inputs the even slots are
+// that one and the odd slots the other.
+void adc_capture_set_inputs(uint mask){
+    adc_run(false);
+    // Let a conversion in flight finish so it can't land in the new ring
+    while (!(adc_hw->cs & ADC_CS_READY_BITS)) tight_loop_contents();
+    uint first = __builtin_ctz(mask);
+    for (uint ch = 0; ch < 4; ch++) if (mask & (1u << ch)) adc_gpio_init(26 + ch);
+    adc_select_input(first);
+    adc_set_round_robin((mask == (1u << first)) ? 0 : mask);
+    adc_capture_retarget(ring_buf, ring_len);
+}
+
+// Freeze the ring where it is (the DMA just waits for the next sample)
+void adc_capture_pause(){
+    adc_run(false);
+}
+
+static inline uint follow_write(const adc_follower_t *f){
+    return adc_capture_write_index() / f->group * f->group;
+}
+
+// Start following from where the DMA is now
+void adc_follow_start(adc_follower_t *f, uint group){
+    f->group = group;
+    f->read_index = follow_write(f);
+    f->last_us = time_us_32();
+}
+
+// Samples taken since the last pass, if that's room or more: the DMA may
+// have come round under the reader, so it skips to the write index.
+// Returns 0 if it's still safe to read on.
+uint32_t adc_follow_lapped(adc_follower_t *f, uint room){
+    uint32_t now = time_us_32();
+    uint32_t elapsed = (uint32_t)((uint64_t)(now - f->last_us) * ADC_SAMPLE_RATE_HZ / 1000000);
+    f->last_us = now;
+    if (elapsed < room) return 0;
+    f->read_index = follow_write(f);
+    return elapsed;
+}
+
+// Hand span() everything the DMA has finished since the last pass, split
+// where the ring wraps. Returns how many samples that was.
+uint adc_follow(adc_follower_t *f, adc_span_t span){
+    uint write = follow_write(f);
+    uint read = f->read_index;
+    f->read_index = write;
+    if (write >= read) {
+        span(&ring_buf[read], write - read);
+        return write - read;
+    }
+    span(&ring_buf[read], ring_len - read);
+    span(ring_buf, write);
+    return ring_len - read + write;
+}
+
 float adc_to_volt(uint8_t adc_val){
     return (adc_val / ADC_RESOLUTION) * 3.3;
 }
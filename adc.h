@@ -5,6 +5,22 @@
 
 #define CAPTURE_DEPTH 320
 
+// Channel 0 is GPIO26
+#define CAPTURE_CHANNEL 0
+
+// Free-running at full speed: 48MHz ADC clock / 96 cycles per conversion
+#define ADC_SAMPLE_RATE_HZ 500000
+
+// A core 1 reader following whichever ring the DMA is filling, a little
+// behind it. The ring has to be whole groups long.
+typedef struct adc_follower {
+    uint group;             // samples are handed over in whole groups of this many
+    uint read_index;        // next sample to hand over
+    uint32_t last_us;       // time of the last pass, to spot being lapped
+} adc_follower_t;
+
+typedef void (*adc_span_t)(const uint8_t *samples, uint count);
+
 typedef enum gain_mode{
     GAIN_LOW,
     GAIN_MEDIUM,
@@ -18,8 +34,25 @@ extern volatile bool trigger_fired;  // set by ISR
 extern volatile bool capture_ready;  // main loop can use frame_buf when true
 extern volatile bool trigger_armed;  // allow/ignore triggers
 
+extern volatile uint16_t trigger_index;  // DMA write position when the trigger fired
+extern uint16_t frame_trigger_index;     // trigger_index for what's in frame_buf
+
 void init_adc_capture();
 
+uint adc_capture_write_index();
+
+void adc_capture_retarget(uint8_t *buf, uint len);
+
+void adc_capture_set_inputs(uint mask);
+
+void adc_capture_pause();
+
+void adc_follow_start(adc_follower_t *f, uint group);
+
+uint32_t adc_follow_lapped(adc_follower_t *f, uint room);
+
+uint adc_follow(adc_follower_t *f, adc_span_t span);
+
 float adc_to_volt(uint8_t adc_val);
 
 void set_gain(gain_mode_t gain);
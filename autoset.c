@@ -0,0 +1,121 @@
+// Signal statistics
+// A snapshot is one pass over the ring: a histogram for the median, the
+// extremes, and rising midpoint crossings for the period. Auto-setup merges
+// several snapshots so a slow signal shows its whole swing; the level
+// tracker folds each one into peak detectors that jump out and relax back.
+
+#include "autoset.h"
+#include "pico/stdlib.h"
+#include "scale.h"
+#include <string.h>
+
+void stats_reset(signal_stats_t *s){
+    memset(s, 0, sizeof(*s));
+    s->lo = 255;
+}
+
+// ring is in DMA order, start is the oldest sample
+void stats_add(signal_stats_t *s, const uint8_t *ring, int count, int start){
+    uint8_t lo = 255, hi = 0;
+    for (int i = 0; i < count; i++) {
+        uint8_t v = ring[i];
+        s->hist[v]++;
+        if (v < lo) lo = v;
+        if (v > hi) hi = v;
+    }
+    s->samples += count;
+    if (lo < s->lo) s->lo = lo;
+    if (hi > s->hi) s->hi = hi;
+
+    // Same crossing rule as measure.c, on this snapshot's own swing
+    int mid = (lo + hi) / 2;
+    int hyst = (hi - lo) / 8;
+    if (hyst < 2) return;
+    bool above = ring[start % count] > mid;
+    int first = -1, last = -1, edges = 0;
+    for (int i = 0; i < count; i++) {
+        int v = ring[(start + i) % count];
+        if (!above && v > mid + hyst) {
+            above = true;
+            if (first < 0) first = i;
+            last = i;
+            edges++;
+        } else if (above && v < mid - hyst) {
+            above = false;
+        }
+    }
+    if (edges >= 2) s->period = (last - first) / (edges - 1);
+}
+
+uint8_t stats_median(const signal_stats_t *s){
+    uint32_t half = s->samples / 2, seen = 0;
+    for (int v = 0; v < 256; v++) {
+        seen += s->hist[v];
+        if (seen > half) return v;
+    }
+    return 128;
+}
+
+// 50% point of the swing, or the median when there's no real swing
+uint8_t stats_trigger_code(const signal_stats_t *s){
+    if (s->hi < s->lo || s->hi - s->lo < AUTOLEVEL_MIN_SPAN) return stats_median(s);
+    return (s->lo + s->hi) / 2;
+}
+
+void autolevel_reset(autolevel_t *a){
+    a->valid = false;
+}
+
+// Fold a snapshot in. Returns true with a new level once the 50% point has
+// moved further than the hysteresis from the current one.
+bool autolevel_update(autolevel_t *a, const signal_stats_t *snap, uint8_t *level){
+    int lo = snap->lo << AUTOLEVEL_DECAY_SHIFT;
+    int hi = snap->hi << AUTOLEVEL_DECAY_SHIFT;
+    int median = stats_median(snap) << AUTOLEVEL_DECAY_SHIFT;
+    if (!a->valid) {
+        a->lo = lo; a->hi = hi; a->median = median;
+    } else {
+        a->lo = (lo < a->lo) ? lo : a->lo + ((lo - a->lo) >> AUTOLEVEL_DECAY_SHIFT);
+        a->hi = (hi > a->hi) ? hi : a->hi + ((hi - a->hi) >> AUTOLEVEL_DECAY_SHIFT);
+        a->median += (median - a->median) >> AUTOLEVEL_DECAY_SHIFT;
+    }
+
+    int span = (a->hi - a->lo) >> AUTOLEVEL_DECAY_SHIFT;
+    int target = (span < AUTOLEVEL_MIN_SPAN) ? a->median : (a->lo + a->hi) / 2;
+    target >>= AUTOLEVEL_DECAY_SHIFT;
+
+    bool moved = !a->valid || target - a->level >= AUTOLEVEL_HYST || a->level - target >= AUTOLEVEL_HYST;
+    a->valid = true;
+    if (!moved) return false;
+    a->level = target;
+    *level = target;
+    return true;
+}
+
+// Coarse to fine: from stats taken at one gain, predict the peak at each
+// higher gain and take the highest that stays under the target. Clipping
+// means the prediction is worthless, so step down one and measure again.
+int autoset_pick_gain(const signal_stats_t *s, int gain, const float *gain_factors, int gains){
+    if (s->hi >= AUTOSET_CLIP_CODE) return (gain > 0) ? gain - 1 : gain;
+    int best = gain;
+    for (int g = gain + 1; g < gains; g++) {
+        float predicted = s->hi * gain_factors[g] / gain_factors[gain];
+        if (predicted <= AUTOSET_TARGET_CODE) best = g;
+    }
+    return best;
+}
+
+// Smallest 1-2-5 step at or above v
+float autoset_round_125(float v){
+    float decade = 0.01f;
+    while (decade * 10.0f <= v) decade *= 10.0f;
+    if (v <= decade) return decade;
+    if (v <= 2.0f * decade) return 2.0f * decade;
+    if (v <= 5.0f * decade) return 5.0f * decade;
+    return 10.0f * decade;
+}
+
+// Volts at the ADC pin, which is where the trigger comparator is
+float autoset_code_to_volts(uint8_t code){
+    return code * SCALE_ADC_FULL_SCALE / 255.0f;
+}
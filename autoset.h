@@ -0,0 +1,55 @@
+#ifndef AUTOSET_H
+#define AUTOSET_H
+
+#include "pico/stdlib.h"
+
+// Signal statistics for automatic trigger level and auto-setup
+//
+// Works on raw ADC codes straight out of the free-running ring, so it keeps
+// going when nothing triggers. The trigger comparator sits on the ADC pin
+// too, which makes a code a trigger level without knowing the gain.
+
+#define AUTOSET_CLIP_CODE       250     // at or above this the ADC is clipping
+#define AUTOSET_TARGET_CODE     200     // highest peak a gain step may predict
+
+#define AUTOLEVEL_HYST          4       // codes the level has to move before retargeting
+#define AUTOLEVEL_MIN_SPAN      8       // below this it's noise, trigger at the median
+#define AUTOLEVEL_DECAY_SHIFT   3       // peaks relax 1/8 of the way per snapshot
+
+// One or more snapshots merged together
+typedef struct signal_stats {
+    uint16_t hist[256];
+    uint32_t samples;
+    uint8_t lo;
+    uint8_t hi;
+    uint16_t period;    // in samples, 0 if no two rising crossings seen
+} signal_stats_t;
+
+// Slow-moving estimate for the trigger level tracker
+typedef struct autolevel {
+    int16_t lo;         // codes << AUTOLEVEL_DECAY_SHIFT
+    int16_t hi;
+    int16_t median;
+    uint8_t level;
+    bool valid;
+} autolevel_t;
+
+void stats_reset(signal_stats_t *s);
+
+void stats_add(signal_stats_t *s, const uint8_t *ring, int count, int start);
+
+uint8_t stats_median(const signal_stats_t *s);
+
+uint8_t stats_trigger_code(const signal_stats_t *s);
+
+void autolevel_reset(autolevel_t *a);
+
+bool autolevel_update(autolevel_t *a, const signal_stats_t *snapshot, uint8_t *level);
+
+int autoset_pick_gain(const signal_stats_t *s, int gain, const float *gain_factors, int gains);
+
+float autoset_round_125(float v);
+
+float autoset_code_to_volts(uint8_t code);
+
+#endif
@@ -0,0 +1,242 @@
+// Function generator
+// Waveforms are 256-entry Q15 tables. Each finished DMA block raises
+// DMA_IRQ_1, and the handler refills that block while the other one plays.
+// Settings change under disabled interrupts (the IRQ runs on the same
+// core), so a refill always sees a consistent set.
+
+#include "awg.h"
+#include "dac.h"
+#include "pico/stdlib.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/clocks.h"
+#include "hardware/sync.h"
+#include <math.h>
+
+#define AWG_SWEEP_MIN_S     0.01f
+#define AWG_SWEEP_MAX_S     100.0f
+#define AWG_RING_BITS       9           // one block of 16-bit samples
+
+#if (AWG_BLOCK * 2) != (1 << AWG_RING_BITS)
+#error "a block has to be exactly one DMA read ring"
+#endif
+
+static int16_t sine_table[AWG_TABLE_SIZE];
+static int16_t square_table[AWG_TABLE_SIZE];
+static int16_t triangle_table[AWG_TABLE_SIZE];
+static int16_t arb_table[AWG_TABLE_SIZE];
+
+// Each block is its own read ring, so a refill that comes late (core 0
+// with interrupts off for a flash write) replays the block instead of the
+// DMA walking off the end into whatever SRAM follows
+static uint16_t buffers[2][AWG_BLOCK] __attribute__((aligned(AWG_BLOCK * 2)));
+static int chan[2];
+static dma_channel_config chan_config[2];
+static float sample_rate = AWG_SAMPLE_RATE_HZ;
+
+// Generator state, only touched with interrupts off outside the IRQ
+static awg_shape_t shape = AWG_OFF;
+static const int16_t *table = sine_table;
+static uint32_t phase = 0;
+static uint32_t increment = 0;
+static float frequency = 1000.0f;
+static int32_t half_code = 0;       // half the peak to peak, in codes
+static int32_t mid_code = 0;
+static uint16_t config_word = 0;
+
+// Sweep from frequency up (or down) to stop_inc, then start over
+static uint32_t start_inc = 0;
+static uint32_t stop_inc = 0;
+static float stop_frequency = 10000.0f;
+static uint32_t sweep_blocks = 1;
+static uint32_t sweep_block = 0;
+
+static uint32_t hz_to_inc(float hz){
+    return (uint32_t)(hz * (4294967296.0f / sample_rate) + 0.5f);
+}
+
+static void fill_block(uint16_t *buf){
+    uint32_t p = phase;
+    int i = 0;
+
+    // Trigger level changes ride along in place of one sample
+    uint16_t word;
+    if (dac_take_queued(&word)) { buf[i++] = word; p += increment; }
+
+    for (; i < AWG_BLOCK; i++) {
+        int32_t v = mid_code + ((table[p >> (32 - AWG_TABLE_BITS)] * half_code) >> 15);
+        if (v < 0) v = 0;
+        else if (v > DAC_CODE_MAX) v = DAC_CODE_MAX;
+        buf[i] = config_word | v;
+        p += increment;
+    }
+    phase = p;
+
+    if (shape == AWG_SWEEP) {
+        if (++sweep_block >= sweep_blocks) sweep_block = 0;
+        int64_t span = (int64_t)stop_inc - start_inc;
+        increment = start_inc + (int32_t)(span * sweep_block / sweep_blocks);
+    }
+}
+
+static void awg_irq(){
+    for (int k = 0; k < 2; k++) {
+        if (!(dma_hw->ints1 & (1u << chan[k]))) continue;
+        dma_hw->ints1 = 1u << chan[k];
+        // The ring has already brought the read address back to the start
+        fill_block(buffers[k]);
+    }
+}
+
+void awg_init(){
+    for (int i = 0; i < AWG_TABLE_SIZE; i++) {
+        float x = (float)i / AWG_TABLE_SIZE;
+        sine_table[i] = (int16_t)(32767.0f * sinf(2.0f * M_PI * x));
+        square_table[i] = (i < AWG_TABLE_SIZE / 2) ? 32767 : -32767;
+        triangle_table[i] = (int16_t)(32767.0f * ((x < 0.5f) ? 4.0f * x - 1.0f : 3.0f - 4.0f * x));
+        arb_table[i] = (int16_t)(32767.0f * (2.0f * x - 1.0f));  // ramp until something is loaded
+    }
+
+    // Whole divider of the system clock, the accumulator uses the real rate
+    uint32_t sys_hz = clock_get_hz(clk_sys);
+    uint32_t div = sys_hz / AWG_SAMPLE_RATE_HZ;
+    int timer = dma_claim_unused_timer(true);
+    dma_timer_set_fraction(timer, 1, div);
+    sample_rate = (float)sys_hz / div;
+
+    chan[0] = dma_claim_unused_channel(true);
+    chan[1] = dma_claim_unused_channel(true);
+    for (int k = 0; k < 2; k++) {
+        dma_channel_config c = dma_channel_get_default_config(chan[k]);
+        channel_config_set_transfer_data_size(&c, DMA_SIZE_16);
+        channel_config_set_read_increment(&c, true);
+        channel_config_set_write_increment(&c, false);
+        channel_config_set_ring(&c, false, AWG_RING_BITS);
+        channel_config_set_dreq(&c, dma_get_timer_dreq(timer));
+        chan_config[k] = c;
+        dma_channel_set_irq1_enabled(chan[k], true);
+    }
+    irq_set_exclusive_handler(DMA_IRQ_1, awg_irq);
+    irq_set_enabled(DMA_IRQ_1, true);
+
+    config_word = dac_word(CHAN_OFFSET, 0);
+    increment = hz_to_inc(frequency);
+    awg_set_amplitude(1.0f);
+    awg_set_offset(1.65f);
+}
+
+static void start(){
+    phase = 0;
+    sweep_block = 0;
+    fill_block(buffers[0]);
+    fill_block(buffers[1]);
+    dac_stream_begin();
+    for (int k = 0; k < 2; k++) {
+        channel_config_set_chain_to(&chan_config[k], chan[k ^ 1]);
+        dma_channel_configure(chan[k], &chan_config[k], dac_data_register(), buffers[k], AWG_BLOCK, false);
+    }
+    dma_channel_start(chan[0]);
+}
+
+// Break the chain first, or aborting one channel can start the other
+static void stop(){
+    for (int k = 0; k < 2; k++) {
+        channel_config_set_chain_to(&chan_config[k], chan[k]);
+        dma_channel_set_config(chan[k], &chan_config[k], false);
+    }
+    dma_channel_abort(chan[0]);
+    dma_channel_abort(chan[1]);
+    dma_hw->ints1 = (1u << chan[0]) | (1u << chan[1]);
+    dac_stream_end();
+}
+
+// Sweep steps come from the current start and stop frequencies
+static void update_sweep(){
+    start_inc = hz_to_inc(frequency);
+    stop_inc = hz_to_inc(stop_frequency);
+    if (shape == AWG_SWEEP) increment = start_inc + (int32_t)(((int64_t)stop_inc - start_inc) * sweep_block / sweep_blocks);
+    else increment = start_inc;
+}
+
+void awg_set_shape(awg_shape_t s){
+    if ((int)s < 0 || s >= AWG_SHAPE_COUNT || s == shape) return;
+    uint32_t save = save_and_disable_interrupts();
+    bool was_running = (shape != AWG_OFF);
+    shape = s;
+    table = (s == AWG_SQUARE) ? square_table : (s == AWG_TRIANGLE) ? triangle_table : (s == AWG_ARB) ? arb_table : sine_table;
+    sweep_block = 0;
+    update_sweep();
+    if (s == AWG_OFF && was_running) stop();
+    else if (s != AWG_OFF && !was_running) start();
+    restore_interrupts(save);
+}
+
+// Start frequency when sweeping
+void awg_set_frequency(float hz){
+    if (hz < AWG_MIN_FREQ_HZ) hz = AWG_MIN_FREQ_HZ;
+    if (hz > AWG_MAX_FREQ_HZ) hz = AWG_MAX_FREQ_HZ;
+    uint32_t save = save_and_disable_interrupts();
+    frequency = hz;
+    update_sweep();
+    restore_interrupts(save);
+}
+
+void awg_set_sweep(float stop_hz, float seconds){
+    if (stop_hz < AWG_MIN_FREQ_HZ) stop_hz = AWG_MIN_FREQ_HZ;
+    if (stop_hz > AWG_MAX_FREQ_HZ) stop_hz = AWG_MAX_FREQ_HZ;
+    if (seconds < AWG_SWEEP_MIN_S) seconds = AWG_SWEEP_MIN_S;
+    if (seconds > AWG_SWEEP_MAX_S) seconds = AWG_SWEEP_MAX_S;
+    uint32_t save = save_and_disable_interrupts();
+    stop_frequency = stop_hz;
+    sweep_blocks = (uint32_t)(seconds * sample_rate / AWG_BLOCK);
+    if (sweep_blocks < 1) sweep_blocks = 1;
+    sweep_block = 0;
+    update_sweep();
+    restore_interrupts(save);
+}
+
+void awg_set_amplitude(float vpp){
+    uint16_t code = dac_volts_to_code(vpp);
+    uint32_t save = save_and_disable_interrupts();
+    half_code = code / 2;
+    restore_interrupts(save);
+}
+
+void awg_set_offset(float volts){
+    uint16_t code = dac_volts_to_code(volts);
+    uint32_t save = save_and_disable_interrupts();
+    mid_code = code;
+    restore_interrupts(save);
+}
+
+// Points from -1 to 1 spread over one period, linearly stretched to fill
+// the table. Takes effect on the next refill.
+void awg_load_table(const float *points, int count){
+    if (count < 1) return;
+    static int16_t next[AWG_TABLE_SIZE];
+    for (int i = 0; i < AWG_TABLE_SIZE; i++) {
+        float pos = (float)i * count / AWG_TABLE_SIZE;
+        int a = (int)pos;
+        int b = (a + 1) % count;
+        float f = pos - a;
+        float v = points[a] + (points[b] - points[a]) * f;
+        if (v > 1.0f) v = 1.0f;
+        if (v < -1.0f) v = -1.0f;
+        next[i] = (int16_t)(v * 32767.0f);
+    }
+    uint32_t save = save_and_disable_interrupts();
+    for (int i = 0; i < AWG_TABLE_SIZE; i++) arb_table[i] = next[i];
+    restore_interrupts(save);
+}
+
+awg_shape_t awg_shape(){
+    return shape;
+}
+
+float awg_frequency(){
+    return frequency;
+}
+
+float awg_sample_rate(){
+    return sample_rate;
+}
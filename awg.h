@@ -0,0 +1,51 @@
+#ifndef AWG_H
+#define AWG_H
+
+#include "pico/stdlib.h"
+
+// Function generator on the offset DAC channel
+//
+// A DMA timer paces samples straight into the DAC's SPI data register from
+// two ping-pong blocks. The CPU only runs when a block finishes, refilling
+// it from a phase accumulator (DDS) stepping through a waveform table, so
+// frequency changes land at a block boundary without a phase jump.
+
+#define AWG_SAMPLE_RATE_HZ  250000
+#define AWG_BLOCK           256     // samples per DMA block, ~1ms
+#define AWG_TABLE_BITS      8
+#define AWG_TABLE_SIZE      (1 << AWG_TABLE_BITS)
+
+#define AWG_MIN_FREQ_HZ     1.0f
+#define AWG_MAX_FREQ_HZ     (AWG_SAMPLE_RATE_HZ / 4.0f)
+
+typedef enum {
+    AWG_OFF,
+    AWG_SINE,
+    AWG_SQUARE,
+    AWG_TRIANGLE,
+    AWG_SWEEP,      // sine, frequency ramped once per block
+    AWG_ARB,
+    AWG_SHAPE_COUNT
+} awg_shape_t;
+
+void awg_init();
+
+void awg_set_shape(awg_shape_t shape);
+
+void awg_set_frequency(float hz);
+
+void awg_set_sweep(float stop_hz, float seconds);
+
+void awg_set_amplitude(float vpp);
+
+void awg_set_offset(float volts);
+
+void awg_load_table(const float *points, int count);
+
+awg_shape_t awg_shape();
+
+float awg_frequency();
+
+float awg_sample_rate();
+
+#endif
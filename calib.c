@@ -0,0 +1,180 @@
+// Front end calibration
+// Two DAC levels per gain mode go in through the probe, and the averaged
+// ADC codes give the slope and zero for that mode. The routine is a small
+// state machine stepped from a protothread, timed off the microsecond
+// clock, so the UI keeps running while it settles and averages.
+
+#include "calib.h"
+#include "pico/stdlib.h"
+#include "adc.h"
+#include "dac.h"
+#include "scale.h"
+#include "flash_layout.h"
+#include "flash_util.h"
+#include <stddef.h>
+#include <string.h>
+
+// Divider ratios from the schematic, pin volts per probe volt
+static const float nominal_gain[CALIB_MODES] = { 0.21f, 0.39f, 1.98f };
+
+static calib_gain_t active[CALIB_MODES];
+static bool loaded = false;
+
+// Routine state
+static calib_state_t state = CALIB_IDLE;
+static int step = 0;                // mode * 2 + point
+static int reads = 0;
+static uint32_t sum = 0;
+static uint32_t next_us = 0;
+static uint16_t ref_code[2];
+static uint32_t avg_q8[2];
+static uint16_t saved_offset_code;
+static calib_gain_t measured[CALIB_MODES];
+
+static uint32_t nominal_uv_per_code(int mode){
+    return (uint32_t)(SCALE_ADC_FULL_SCALE / 255.0f / nominal_gain[mode] * 1e6f + 0.5f);
+}
+
+static uint16_t record_crc(const calib_record_t *r){
+    return flash_util_crc16(0xFFFF, (const uint8_t *)r, offsetof(calib_record_t, crc));
+}
+
+void calib_init(){
+    const calib_record_t *r = (const calib_record_t *)flash_util_ptr(FLASH_CALIB_OFFSET);
+    loaded = r->magic == CALIB_MAGIC && r->version == CALIB_VERSION &&
+             r->size == sizeof(calib_record_t) && r->crc == record_crc(r);
+    for (int m = 0; m < CALIB_MODES; m++) {
+        if (loaded) active[m] = r->gain[m];
+        else { active[m].uv_per_code = nominal_uv_per_code(m); active[m].zero_q8 = 0; active[m].reserved = 0; }
+    }
+}
+
+bool calib_from_flash(){
+    return loaded;
+}
+
+const calib_gain_t *calib_get(int mode){
+    return &active[(mode < 0 || mode >= CALIB_MODES) ? 0 : mode];
+}
+
+// Effective pin volts per probe volt, taking the ADC full scale as exact
+float calib_gain_factor(int mode){
+    return SCALE_ADC_FULL_SCALE / 255.0f * 1e6f / calib_get(mode)->uv_per_code;
+}
+
+// Probe volts at ADC mid-scale, where the center line sits
+float calib_center_volts(int mode){
+    const calib_gain_t *c = calib_get(mode);
+    return (127.5f - c->zero_q8 / 256.0f) * c->uv_per_code * 1e-6f;
+}
+
+// The trigger comparator works at the pin, through the same line
+float calib_probe_to_pin(int mode, float probe_volts){
+    const calib_gain_t *c = calib_get(mode);
+    float code = c->zero_q8 / 256.0f + probe_volts * 1e6f / c->uv_per_code;
+    return code * SCALE_ADC_FULL_SCALE / 255.0f;
+}
+
+float calib_pin_to_probe(int mode, float pin_volts){
+    const calib_gain_t *c = calib_get(mode);
+    float code = pin_volts * 255.0f / SCALE_ADC_FULL_SCALE;
+    return (code - c->zero_q8 / 256.0f) * c->uv_per_code * 1e-6f;
+}
+
+// The probe has to be on the offset output. Returns false if already running.
+bool calib_start(){
+    if (state == CALIB_RUNNING) return false;
+    saved_offset_code = dac_code(CHAN_OFFSET);
+    state = CALIB_RUNNING;
+    step = -1;
+    next_us = time_us_32();
+    return true;
+}
+
+// Put out the reference for a step and give it time to settle
+static bool begin_step(int s){
+    int mode = s / 2;
+    float high = CALIB_PIN_HIGH / nominal_gain[mode];
+    if (high > DAC_VOLTS_MAX) high = DAC_VOLTS_MAX;
+    ref_code[s & 1] = dac_volts_to_code((s & 1) ? high : CALIB_LOW_VOLTS);
+    set_gain((gain_mode_t)mode);
+    if (!dac_set_code(CHAN_OFFSET, ref_code[s & 1])) return false;
+    reads = 0;
+    sum = 0;
+    next_us = time_us_32() + CALIB_SETTLE_US;
+    return true;
+}
+
+// Two points to a line, sanity checked against the nominal ratio
+static bool solve(int mode){
+    float v0 = ref_code[0] * 4.096f / 4095.0f;
+    float v1 = ref_code[1] * 4.096f / 4095.0f;
+    int32_t span_q8 = (int32_t)avg_q8[1] - (int32_t)avg_q8[0];
+    if (span_q8 <= 0) return false;
+    float uv = (v1 - v0) * 1e6f * 256.0f / span_q8;
+    float zero = avg_q8[0] - v0 * 1e6f * 256.0f / uv;
+
+    float nominal = nominal_uv_per_code(mode);
+    if (uv < nominal * (1.0f - CALIB_MAX_GAIN_ERR) || uv > nominal * (1.0f + CALIB_MAX_GAIN_ERR)) return false;
+    if (zero < -CALIB_MAX_ZERO_Q8 || zero > CALIB_MAX_ZERO_Q8) return false;
+    measured[mode].uv_per_code = (uint32_t)(uv + 0.5f);
+    measured[mode].zero_q8 = (int16_t)zero;
+    measured[mode].reserved = 0;
+    return true;
+}
+
+static bool save(){
+    static uint8_t page[FLASH_PAGE_SIZE];
+    calib_record_t r;
+    memset(&r, 0, sizeof(r));
+    r.magic = CALIB_MAGIC;
+    r.version = CALIB_VERSION;
+    r.size = sizeof(r);
+    memcpy(r.gain, measured, sizeof(measured));
+    r.crc = record_crc(&r);
+    memset(page, 0xFF, sizeof(page));
+    memcpy(page, &r, sizeof(r));
+    if (!flash_util_erase(FLASH_CALIB_OFFSET, FLASH_SECTOR_SIZE)) return false;
+    return flash_util_program(FLASH_CALIB_OFFSET, page, FLASH_PAGE_SIZE);
+}
+
+static void finish(calib_state_t result){
+    if (result == CALIB_DONE) {
+        memcpy(active, measured, sizeof(active));
+        loaded = true;
+    }
+    if (saved_offset_code <= DAC_CODE_MAX) dac_set_code(CHAN_OFFSET, saved_offset_code);
+    state = result;
+}
+
+// One step of the routine. Returns true while it's running, the caller
+// should set the gain back afterwards.
+bool calib_service(){
+    if (state != CALIB_RUNNING) return false;
+    if ((int32_t)(time_us_32() - next_us) < 0) return true;
+
+    if (step >= 0) {
+        // Whole ring per read, so ripple and noise average out
+        for (int i = 0; i < CAPTURE_DEPTH; i++) sum += capture_buf[i];
+        next_us = time_us_32() + CALIB_READ_US;
+        if (++reads < CALIB_READS) return true;
+        avg_q8[step & 1] = (uint32_t)(((uint64_t)sum << 8) / (CALIB_READS * CAPTURE_DEPTH));
+        if ((step & 1) && !solve(step / 2)) { finish(CALIB_FAILED); return false; }
+    }
+
+    if (++step == CALIB_MODES * 2) {
+        finish(save() ? CALIB_DONE : CALIB_FAILED);
+        return false;
+    }
+    if (!begin_step(step)) { finish(CALIB_FAILED); return false; }
+    return true;
+}
+
+calib_state_t calib_state(){
+    return state;
+}
+
+// Points measured so far, out of CALIB_MODES * 2
+int calib_progress(){
+    return (state == CALIB_RUNNING && step > 0) ? step : 0;
+}
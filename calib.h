@@ -0,0 +1,72 @@
+#ifndef CALIB_H
+#define CALIB_H
+
+#include "pico/stdlib.h"
+
+// Front end calibration
+//
+// Each gain mode gets a straight line from ADC code to probe volts,
+// measured with the offset DAC as the reference and kept in flash. Only the
+// scale tables and a few setting conversions use it, so calibrated
+// readings cost nothing per sample. Without a record the nominal divider
+// ratios are used.
+
+#define CALIB_MODES         3
+#define CALIB_MAGIC         0x4C414353  // "SCAL"
+#define CALIB_VERSION       1
+
+// Guided routine
+#define CALIB_LOW_VOLTS     0.25f   // reference points, at the probe
+#define CALIB_PIN_HIGH      2.9f    // high point lands here on the ADC pin
+#define CALIB_SETTLE_US     50000   // relay and DAC after each change
+#define CALIB_READS         32      // ring snapshots averaged per point
+#define CALIB_READ_US       2000
+#define CALIB_MAX_GAIN_ERR  0.3f    // reject slopes this far off nominal
+#define CALIB_MAX_ZERO_Q8   (24 << 8)
+
+typedef struct calib_gain {
+    uint32_t uv_per_code;   // probe microvolts per ADC code
+    int16_t zero_q8;        // ADC code with 0V at the probe, Q8
+    uint16_t reserved;
+} calib_gain_t;
+
+// What goes in flash
+typedef struct calib_record {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t size;
+    calib_gain_t gain[CALIB_MODES];
+    uint16_t reserved;
+    uint16_t crc;           // over everything above
+} calib_record_t;
+
+typedef enum {
+    CALIB_IDLE,
+    CALIB_RUNNING,
+    CALIB_DONE,
+    CALIB_FAILED
+} calib_state_t;
+
+void calib_init();
+
+bool calib_from_flash();
+
+const calib_gain_t *calib_get(int mode);
+
+float calib_gain_factor(int mode);
+
+float calib_center_volts(int mode);
+
+float calib_probe_to_pin(int mode, float probe_volts);
+
+float calib_pin_to_probe(int mode, float pin_volts);
+
+bool calib_start();
+
+bool calib_service();
+
+calib_state_t calib_state();
+
+int calib_progress();
+
+#endif
@@ -0,0 +1,140 @@
+// Capture compression
+// Samples are strongly correlated and flat stretches are common, so the
+// deltas are mostly tiny. Rice coding with k picked per block of 16 tracks
+// how busy the signal is; a flat block costs 3 bits.
+
+#include "codec.h"
+#include "pico/stdlib.h"
+
+typedef struct bit_writer {
+    uint8_t *out;
+    int len;
+    int max_len;
+    uint32_t acc;
+    int bits;       // bits waiting in acc
+    bool full;
+} bit_writer_t;
+
+static void put_bits(bit_writer_t *w, uint32_t value, int n){
+    w->acc = (w->acc << n) | (value & ((1u << n) - 1));
+    w->bits += n;
+    while (w->bits >= 8) {
+        w->bits -= 8;
+        if (w->len >= w->max_len) { w->full = true; return; }
+        w->out[w->len++] = (uint8_t)(w->acc >> w->bits);
+    }
+}
+
+static void flush_bits(bit_writer_t *w){
+    if (w->bits > 0) put_bits(w, 0, 8 - w->bits);
+}
+
+static inline uint8_t zigzag(uint8_t prev, uint8_t cur){
+    // Unsigned all the way: shifting a negative int is undefined
+    uint8_t d = (uint8_t)(cur - prev);
+    return (uint8_t)(((uint32_t)d << 1) ^ (0u - (d >> 7)));
+}
+
+static inline int rice_cost(uint8_t z, int k){
+    int q = z >> k;
+    return (q >= CODEC_ESCAPE) ? CODEC_ESCAPE + 8 : q + 1 + k;
+}
+
+// Compress count samples into out. Returns the number of bytes written, or
+// 0 if it didn't fit in max_len (send raw instead).
+int codec_encode(const uint8_t *samples, int count, uint8_t *out, int max_len){
+    if (count <= 0) return 0;
+    bit_writer_t w = { out, 0, max_len, 0, 0, false };
+    put_bits(&w, samples[0], 8);
+
+    uint8_t z[CODEC_BLOCK];
+    for (int base = 1; base < count && !w.full; base += CODEC_BLOCK) {
+        int n = count - base;
+        if (n > CODEC_BLOCK) n = CODEC_BLOCK;
+
+        uint8_t any = 0;
+        for (int i = 0; i < n; i++) {
+            z[i] = zigzag(samples[base + i - 1], samples[base + i]);
+            any |= z[i];
+        }
+        if (!any) { put_bits(&w, CODEC_K_ZERO, 3); continue; }
+
+        // Exact cost of every k is cheap at this block size
+        int best_k = 0, best_cost = 1 << 30;
+        for (int k = 0; k < CODEC_K_ZERO; k++) {
+            int cost = 0;
+            for (int i = 0; i < n; i++) cost += rice_cost(z[i], k);
+            if (cost < best_cost) { best_cost = cost; best_k = k; }
+        }
+
+        put_bits(&w, best_k, 3);
+        for (int i = 0; i < n; i++) {
+            int q = z[i] >> best_k;
+            if (q >= CODEC_ESCAPE) {
+                put_bits(&w, (1u << CODEC_ESCAPE) - 1, CODEC_ESCAPE);
+                put_bits(&w, z[i], 8);
+            } else {
+                put_bits(&w, ((1u << q) - 1) << 1, q + 1);
+                if (best_k) put_bits(&w, z[i], best_k);
+            }
+        }
+    }
+    flush_bits(&w);
+    return w.full ? 0 : w.len;
+}
+
+typedef struct bit_reader {
+    const uint8_t *in;
+    int len;
+    int pos;        // bit position
+} bit_reader_t;
+
+static bool get_bits(bit_reader_t *r, int n, uint32_t *value){
+    if (r->pos + n > r->len * 8) return false;
+    uint32_t v = 0;
+    for (int i = 0; i < n; i++) {
+        v = (v << 1) | ((r->in[r->pos >> 3] >> (7 - (r->pos & 7))) & 1);
+        r->pos++;
+    }
+    *value = v;
+    return true;
+}
+
+// Undo codec_encode(). Returns false if the data ran out or is malformed.
+bool codec_decode(const uint8_t *in, int in_len, uint8_t *samples, int count){
+    if (count <= 0) return true;
+    bit_reader_t r = { in, in_len, 0 };
+    uint32_t v;
+    if (!get_bits(&r, 8, &v)) return false;
+    samples[0] = v;
+
+    for (int base = 1; base < count; base += CODEC_BLOCK) {
+        int n = count - base;
+        if (n > CODEC_BLOCK) n = CODEC_BLOCK;
+        uint32_t k;
+        if (!get_bits(&r, 3, &k)) return false;
+
+        for (int i = 0; i < n; i++) {
+            uint32_t z = 0;
+            if (k != CODEC_K_ZERO) {
+                int q = 0;
+                uint32_t bit;
+                while (1) {
+                    if (!get_bits(&r, 1, &bit)) return false;
+                    if (!bit) break;
+                    if (++q == CODEC_ESCAPE) break;
+                }
+                if (q == CODEC_ESCAPE) {
+                    if (!get_bits(&r, 8, &z)) return false;
+                } else {
+                    uint32_t low = 0;
+                    if (k && !get_bits(&r, k, &low)) return false;
+                    z = ((uint32_t)q << k) | low;
+                }
+            }
+            int8_t d = (int8_t)((z >> 1) ^ -(int32_t)(z & 1));
+            samples[base + i] = (uint8_t)(samples[base + i - 1] + d);
+        }
+    }
+    return true;
+}
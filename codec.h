@@ -0,0 +1,26 @@
+#ifndef CODEC_H
+#define CODEC_H
+
+#include "pico/stdlib.h"
+
+// Lossless capture compression: delta -> zigzag -> per-block Rice code
+//
+// Bitstream, MSB first:
+//   8 bits   first sample
+//   then for every block of up to CODEC_BLOCK deltas:
+//     3 bits k
+//       k = 0..6: each delta as a Rice code with parameter k: (z >> k) ones,
+//                 a zero, then the low k bits of z. A run of CODEC_ESCAPE
+//                 ones is an escape and is followed by z in 8 bits.
+//       k = 7:    every delta in the block is zero, nothing follows
+// z is the zigzagged delta, deltas wrap mod 256.
+
+#define CODEC_BLOCK     16
+#define CODEC_ESCAPE    12
+#define CODEC_K_ZERO    7
+
+int codec_encode(const uint8_t *samples, int count, uint8_t *out, int max_len);
+
+bool codec_decode(const uint8_t *in, int in_len, uint8_t *samples, int count);
+
+#endif
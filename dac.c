@@ -4,28 +4,92 @@
 
     Pins:
     CS    -> GPIO 13
-    LDAC  -> GPIO 9
+    LDAC  -> tied low (see DAC_PIN_LDAC in dac.h)
     MOSI  -> GPIO 11
     SCK   -> GPIO 10
     VOUT_A is for trigger
     VOUT_B is for offset
 
-
+    Updates never wait on the SPI bus. Each channel keeps its last code, so
+    writing the same value again costs nothing, and new words go into a
+    small ring that the SPI1 interrupt feeds into the TX FIFO. The RX side
+    counts words as they finish, which is how we know when to pulse LDAC.
+    A DAC update is one or two words, well inside the 8-deep FIFO, so this
+    doesn't need a DMA channel.
 */
 
 #include "dac.h"
 #include "pico/stdlib.h"
 #include "hardware/spi.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
 
 #define PIN_CS   13
-#define PIN_LDAC 9
 #define PIN_MOSI 11
 #define PIN_SCK  10
 #define SPI_PORT spi1
+#define SPI_IRQ  SPI1_IRQ
+
+#define SPI_FIFO_DEPTH 8
 
 #define DAC_config_chan_A 0b0001000000000000
 #define DAC_config_chan_B 0b1011000000000000
 
+static const uint16_t dac_config[2] = { DAC_config_chan_A, DAC_config_chan_B };
+
+// Written by the callers (core 0), read by the SPI IRQ (also core 0)
+static uint16_t queue[DAC_QUEUE_SIZE];
+static volatile uint32_t queue_head = 0;
+static volatile uint32_t queue_tail = 0;
+
+static volatile int in_flight = 0;      // words in the TX/RX FIFOs
+static uint16_t codes[2] = { 0xFFFF, 0xFFFF };  // nothing sent yet
+static volatile uint32_t dropped = 0;
+
+#ifdef DAC_PIN_LDAC
+static volatile bool latch_pending = false;
+#endif
+
+// While a stream owns the port its DMA writes the data register directly,
+// and queued words are handed to it instead (see dac_take_queued)
+static volatile bool streaming = false;
+
+// Move queued words into the TX FIFO. Keeping at most a FIFO's worth in
+// flight means the RX FIFO can't overrun either.
+static void fill_fifo(spi_hw_t *hw){
+    if (streaming) return;
+    while (queue_tail != queue_head && in_flight < SPI_FIFO_DEPTH && spi_is_writable(SPI_PORT)) {
+        hw->dr = queue[queue_tail & (DAC_QUEUE_SIZE - 1)];
+        queue_tail++;
+        in_flight++;
+    }
+    if (queue_tail == queue_head) hw_clear_bits(&hw->imsc, SPI_SSPIMSC_TXIM_BITS);
+    else hw_set_bits(&hw->imsc, SPI_SSPIMSC_TXIM_BITS);
+}
+
+static void dac_irq(){
+    spi_hw_t *hw = spi_get_hw(SPI_PORT);
+
+    // Every word received is one that has finished clocking out
+    while (hw->sr & SPI_SSPSR_RNE_BITS) {
+        (void)hw->dr;
+        if (in_flight > 0) in_flight--;
+    }
+    hw->icr = SPI_SSPICR_RTIC_BITS;
+
+    fill_fifo(hw);
+
+#ifdef DAC_PIN_LDAC
+    // Batch is out, move both outputs at once (LDAC low >= 100ns)
+    if (latch_pending && in_flight == 0 && queue_tail == queue_head) {
+        latch_pending = false;
+        gpio_put(DAC_PIN_LDAC, 0);
+        busy_wait_at_least_cycles(16);
+        gpio_put(DAC_PIN_LDAC, 1);
+    }
+#endif
+}
+
 void initDac(){
 
     // Initialize SPI channel (channel, baud rate set to 20MHz)
@@ -38,41 +102,143 @@ void initDac(){
     gpio_set_function(PIN_MOSI, GPIO_FUNC_SPI);
     gpio_set_function(PIN_CS, GPIO_FUNC_SPI) ;
 
-    // // CS pin
-    // gpio_init(PIN_CS);
-    // gpio_set_dir(PIN_CS, GPIO_OUT);
-    // gpio_put(PIN_CS, 1); //Idle high
+#ifdef DAC_PIN_LDAC
+    // Idle high, outputs only change when we pulse it
+    gpio_init(DAC_PIN_LDAC) ;
+    gpio_set_dir(DAC_PIN_LDAC, GPIO_OUT) ;
+    gpio_put(DAC_PIN_LDAC, 1) ;
+#endif
 
-    // Map LDAC pin to GPIO port, hold it low (could alternatively tie to GND)
-    gpio_init(PIN_LDAC) ;
-    gpio_set_dir(PIN_LDAC, GPIO_OUT) ;
-    gpio_put(PIN_LDAC, 0) ;
+    // RX half full or RX timeout tells us words have finished
+    spi_hw_t *hw = spi_get_hw(SPI_PORT);
+    hw->imsc = SPI_SSPIMSC_RXIM_BITS | SPI_SSPIMSC_RTIM_BITS;
+    irq_set_exclusive_handler(SPI_IRQ, dac_irq);
+    irq_set_enabled(SPI_IRQ, true);
+}
+
+// The one place floats come in, callers can keep the code around
+uint16_t dac_volts_to_code(float voltage){
+    if (voltage <= 0.0f) return 0;
+    uint32_t raw = (uint32_t)(voltage * 4095.0f / 4.096f + 0.5f); // convert + round
+    return (raw > DAC_CODE_MAX) ? DAC_CODE_MAX : raw;
+}
+
+// Queue up to two words as one batch. Interrupts are off so the SPI IRQ
+// can't see half a batch.
+static bool dac_queue(const int *channels, const uint16_t *values, int n){
+    uint32_t save = save_and_disable_interrupts();
+    int sending = 0;
+    uint16_t words[2];
+    for (int i = 0; i < n; i++) {
+        if (codes[channels[i]] == values[i]) continue;
+        if (streaming && channels[i] == CHAN_OFFSET) { restore_interrupts(save); return false; }
+        words[sending++] = dac_config[channels[i]] | (values[i] & 0x0FFF);
+    }
+    if (queue_head - queue_tail + sending > DAC_QUEUE_SIZE) {
+        dropped++;
+        restore_interrupts(save);
+        return false;
+    }
+    for (int i = 0; i < sending; i++) queue[(queue_head + i) & (DAC_QUEUE_SIZE - 1)] = words[i];
+    queue_head += sending;
+    for (int i = 0; i < n; i++) codes[channels[i]] = values[i];
+#ifdef DAC_PIN_LDAC
+    if (sending) latch_pending = true;
+#endif
+    fill_fifo(spi_get_hw(SPI_PORT));
+    restore_interrupts(save);
+    return true;
+}
+
+// Returns false if the queue was full, the old code stays in place
+bool dac_set_code(int channel, uint16_t code){
+    if (channel != CHAN_TRIG && channel != CHAN_OFFSET) return false;
+    if (code > DAC_CODE_MAX) code = DAC_CODE_MAX;
+    int channels[1] = { channel };
+    uint16_t values[1] = { code };
+    return dac_queue(channels, values, 1);
+}
+
+// Both channels in one batch, latched together when LDAC is wired up
+bool dac_set_codes(uint16_t trig_code, uint16_t offset_code){
+    int channels[2] = { CHAN_TRIG, CHAN_OFFSET };
+    uint16_t values[2] = {
+        (trig_code > DAC_CODE_MAX) ? DAC_CODE_MAX : trig_code,
+        (offset_code > DAC_CODE_MAX) ? DAC_CODE_MAX : offset_code
+    };
+    return dac_queue(channels, values, 2);
+}
+
+uint16_t dac_code(int channel){
+    return codes[channel & 1];
+}
+
+// Something queued or still on the wire
+bool dac_busy(){
+    return queue_tail != queue_head || in_flight > 0;
+}
+
+uint32_t dac_dropped(){
+    return dropped;
+}
+
+// Full SPI word for a code, for anyone building their own stream
+uint16_t dac_word(int channel, uint16_t code){
+    return dac_config[channel & 1] | (code & 0x0FFF);
+}
+
+volatile void *dac_data_register(){
+    return &spi_get_hw(SPI_PORT)->dr;
+}
+
+// Hand the port to a DMA stream on CHAN_OFFSET. The RX side would interrupt
+// on every streamed word, so it's left to overrun until the stream ends.
+void dac_stream_begin(){
+    uint32_t save = save_and_disable_interrupts();
+    spi_hw_t *hw = spi_get_hw(SPI_PORT);
+    streaming = true;
+    hw->imsc = 0;
+#ifdef DAC_PIN_LDAC
+    // Outputs follow every word while streaming
+    latch_pending = false;
+    gpio_put(DAC_PIN_LDAC, 0);
+#endif
+    restore_interrupts(save);
+}
+
+// Take the port back once the stream's DMA has stopped
+void dac_stream_end(){
+    uint32_t save = save_and_disable_interrupts();
+    spi_hw_t *hw = spi_get_hw(SPI_PORT);
+    while (spi_is_busy(SPI_PORT)) tight_loop_contents();
+    while (hw->sr & SPI_SSPSR_RNE_BITS) (void)hw->dr;
+    hw->icr = SPI_SSPICR_RORIC_BITS | SPI_SSPICR_RTIC_BITS;
+    in_flight = 0;
+    streaming = false;
+    codes[CHAN_OFFSET] = 0xFFFF;    // whatever the stream left there is unknown
+#ifdef DAC_PIN_LDAC
+    gpio_put(DAC_PIN_LDAC, 1);
+#endif
+    hw->imsc = SPI_SSPIMSC_RXIM_BITS | SPI_SSPIMSC_RTIM_BITS;
+    fill_fifo(hw);
+    restore_interrupts(save);
+}
+
+// Next queued word, for the stream to slot in between its own samples.
+// Called from the stream's refill with nothing else touching the queue.
+bool dac_take_queued(uint16_t *word){
+    if (!streaming || queue_tail == queue_head) return false;
+    *word = queue[queue_tail & (DAC_QUEUE_SIZE - 1)];
+    queue_tail++;
+    return true;
 }
 
 int setVoltage(int channel, float voltage){
 
     // DAC has 4.096V range (2.048V VREF × 2x gain)
     // Still error out if greater than 3.3v since that is the rail
-    if(voltage > 3.3 || voltage < 0.0f){
+    if(voltage > DAC_VOLTS_MAX || voltage < 0.0f){
         return -1;
     }
-    uint16_t raw = (uint16_t)(voltage * 4095.0f / 4.096f + 0.5f); // convert + round
-    uint16_t dac_data; 
-
-    switch (channel){
-        case CHAN_TRIG:
-            dac_data = (uint16_t)(DAC_config_chan_A | (raw & 0x0FFF));
-            int spi_out_a = spi_write16_blocking(SPI_PORT, &dac_data, 1) ;
-            return spi_out_a;
-            break;
-        case CHAN_OFFSET:
-            dac_data = (uint16_t)(DAC_config_chan_B | (raw & 0x0FFF));
-            int spi_out_b = spi_write16_blocking(SPI_PORT, &dac_data, 1) ;
-            return spi_out_b;
-            break;
-        default: return -1;
-    }
-    
-    return -1;
+    return dac_set_code(channel, dac_volts_to_code(voltage)) ? 0 : -1;
 }
-
@@ -1,13 +1,50 @@
 #ifndef DAC_H
 #define DAC_H
 
+#include "pico/stdlib.h"
+
 enum DAC_Chan {
     CHAN_TRIG,
     CHAN_OFFSET
 };
 
+// Queued words waiting for the SPI FIFO, power of 2
+#define DAC_QUEUE_SIZE  8
+
+// 12-bit output code, 4.096V full scale
+#define DAC_CODE_MAX    4095
+#define DAC_VOLTS_MAX   3.3f    // the rail, even though the DAC goes higher
+
+// Uncomment if LDAC gets its own pin. Then outputs only change on a latch
+// pulse after a batch has gone out, so both channels move together. GPIO 9
+// is the gain relay select on this board, so by default LDAC is left tied
+// low and each channel updates as soon as its word arrives.
+// #define DAC_PIN_LDAC 9
+
 void initDac();
 
+uint16_t dac_volts_to_code(float voltage);
+
+bool dac_set_code(int channel, uint16_t code);
+
+bool dac_set_codes(uint16_t trig_code, uint16_t offset_code);
+
+uint16_t dac_code(int channel);
+
+bool dac_busy();
+
+uint32_t dac_dropped();
+
+uint16_t dac_word(int channel, uint16_t code);
+
+volatile void *dac_data_register();
+
+void dac_stream_begin();
+
+void dac_stream_end();
+
+bool dac_take_queued(uint16_t *word);
+
 int setVoltage(int channel, float voltage);
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,260 @@
+// Serial protocol decoding
+// One pass per protocol over the sliced levels, carrying its state from one
+// chunk to the next. UART with auto-baud takes a measuring pass first to
+// find the bit period from the run lengths between transitions.
+
+#include "decode.h"
+#include "pico/stdlib.h"
+#include <string.h>
+
+// Slicer
+static int levels;
+static uint8_t up[3];           // go above to reach the next level
+static uint8_t down[3];         // go below to drop back from it
+static int level;
+static uint32_t pos;            // index of the next sample fed
+
+// Protocol state
+static decode_proto_t proto;
+static uint32_t sample_rate;
+static uint32_t fixed_baud;
+static uint32_t bit_q8;         // UART bit period, samples << 8
+static int state;
+static int bits;
+static uint8_t value;
+static uint8_t flags;
+static uint32_t start;
+static uint32_t next_q8;        // UART: next bit centre
+static uint32_t last_edge;      // SPI: last clock rising edge
+static uint32_t period;         // SPI: clock period
+static int prev;                // previous level
+
+// Auto-baud
+static uint16_t runs[DECODE_MAX_RUN + 1];
+static uint32_t run_start;
+static bool run_valid;
+
+// Results
+static decode_event_t events[DECODE_MAX_EVENTS];
+static int count;
+static uint32_t total;
+
+enum { UART_IDLE, UART_START, UART_DATA, UART_STOP, UART_WAIT_HIGH };
+enum { I2C_IDLE, I2C_BYTE };
+
+static void emit(uint32_t end, uint8_t v, uint8_t f){
+    if (count < DECODE_MAX_EVENTS) {
+        decode_event_t *e = &events[count++];
+        e->start = start;
+        e->end = end;
+        e->value = v;
+        e->flags = f;
+    }
+    total++;
+}
+
+static inline int slice(uint8_t c){
+    while (level < levels - 1 && c > up[level]) level++;
+    while (level > 0 && c < down[level - 1]) level--;
+    return level;
+}
+
+// Thresholds evenly between the capture's lowest and highest codes, with
+// a quarter of a step either side. Two levels for UART, four otherwise.
+void decode_begin(decode_proto_t p, uint8_t lo, uint8_t hi, uint32_t baud, uint32_t rate){
+    proto = p;
+    fixed_baud = baud;
+    sample_rate = rate;
+    bit_q8 = baud ? (rate << 8) / baud : 0;
+    count = 0;
+    total = 0;
+    levels = (p == DECODE_UART) ? 2 : 4;
+    if (hi - lo < DECODE_MIN_SWING) { levels = 0; return; }
+    int step = (hi - lo) / (levels - 1);
+    for (int k = 0; k < levels - 1; k++) {
+        int mid = lo + step * k + step / 2;
+        up[k] = mid + step / 4;
+        down[k] = mid - step / 4;
+    }
+    memset(runs, 0, sizeof(runs));
+    level = 0;
+    pos = 0;
+    run_valid = false;
+}
+
+bool decode_needs_measure(){
+    return proto == DECODE_UART && !fixed_baud && levels;
+}
+
+// Lengths of every run that had a transition at both ends
+void decode_measure(const uint8_t *s, uint32_t n){
+    if (!levels) return;
+    for (uint32_t i = 0; i < n; i++, pos++) {
+        int was = level;
+        if (slice(s[i]) == was || pos == 0) continue;
+        uint32_t len = pos - run_start;
+        if (run_valid && len <= DECODE_MAX_RUN && runs[len] < UINT16_MAX) runs[len]++;
+        run_start = pos;
+        run_valid = true;
+    }
+}
+
+// Shortest run is roughly one bit. Average the runs near it for a first
+// guess, then divide every run by how many bits it must have held.
+static uint32_t estimate_bit_q8(){
+    int shortest = 0;
+    for (int len = 2; len <= DECODE_MAX_RUN && !shortest; len++) if (runs[len]) shortest = len;
+    if (!shortest) return 0;
+
+    uint32_t sum = 0, n = 0;
+    for (int len = shortest; len <= shortest * 3 / 2 && len <= DECODE_MAX_RUN; len++) {
+        sum += runs[len] * len;
+        n += runs[len];
+    }
+    uint32_t guess_q8 = (sum << 8) / n;
+
+    uint32_t samples = 0, bits_seen = 0;
+    for (int len = shortest; len <= DECODE_MAX_RUN; len++) {
+        if (!runs[len]) continue;
+        uint32_t b = ((len << 8) + guess_q8 / 2) / guess_q8;
+        if (b == 0 || b > 9) continue;      // a UART frame can't hold a longer run
+        samples += runs[len] * len;
+        bits_seen += runs[len] * b;
+    }
+    return bits_seen ? (samples << 8) / bits_seen : guess_q8;
+}
+
+// Between the measuring pass and the decoding pass, or straight away
+void decode_start(){
+    if (decode_needs_measure()) bit_q8 = estimate_bit_q8();
+    level = 0;
+    pos = 0;
+    prev = 0;
+    state = 0;
+    bits = 0;
+    period = 0;
+    last_edge = 0;
+}
+
+// 8N1, checked at the middle of each bit
+static void uart_sample(int b){
+    uint32_t now_q8 = pos << 8;
+    switch (state) {
+        case UART_IDLE:
+            if (prev && !b) {
+                start = pos;
+                next_q8 = now_q8 + bit_q8 / 2;
+                state = UART_START;
+            }
+            break;
+        case UART_START:
+            if (now_q8 < next_q8) break;
+            // Back high already: a glitch, not a start bit
+            state = b ? UART_IDLE : UART_DATA;
+            next_q8 += bit_q8;
+            bits = 0;
+            value = 0;
+            break;
+        case UART_DATA:
+            if (now_q8 < next_q8) break;
+            value |= b << bits;
+            next_q8 += bit_q8;
+            if (++bits == 8) state = UART_STOP;
+            break;
+        case UART_STOP:
+            if (now_q8 < next_q8) break;
+            emit(pos, value, b ? 0 : DECODE_FLAG_ERROR);
+            state = b ? UART_IDLE : UART_WAIT_HIGH;
+            break;
+        case UART_WAIT_HIGH:
+            if (b) state = UART_IDLE;
+            break;
+    }
+    prev = b;
+}
+
+// Data changes while the clock is low. A change with the clock high is a
+// start (falling) or a stop (rising).
+static void i2c_sample(int l){
+    int sda = l >> 1, scl = l & 1;
+    int psda = prev >> 1, pscl = prev & 1;
+    if (scl && pscl && sda != psda) {
+        if (!sda) {
+            state = I2C_BYTE;
+            start = pos;
+            flags = DECODE_FLAG_START;
+            bits = 0;
+            value = 0;
+        } else {
+            // The clock rising before a stop reads as the next byte's first
+            // bit. Mark the byte before, if there was one and it was kept.
+            if (state == I2C_BYTE && bits <= 1 && !(flags & DECODE_FLAG_START) && count && count == total) {
+                events[count - 1].flags |= DECODE_FLAG_STOP;
+            }
+            state = I2C_IDLE;
+        }
+    } else if (scl && !pscl && state == I2C_BYTE) {
+        if (bits == 0 && !(flags & DECODE_FLAG_START)) start = pos;
+        if (bits < 8) {
+            value = (value << 1) | sda;
+            bits++;
+        } else {
+            emit(pos, value, flags | (sda ? DECODE_FLAG_NACK : 0));
+            start = pos;
+            flags = 0;
+            bits = 0;
+            value = 0;
+        }
+    }
+    prev = l;
+}
+
+// Mode 0, MSB first. A long pause in the clock means a new word.
+static void spi_sample(int l){
+    int mosi = l >> 1, sck = l & 1;
+    if (sck && !(prev & 1)) {
+        uint32_t gap = pos - last_edge;
+        if (period && gap > period * DECODE_SPI_GAP) {
+            if (bits) emit(last_edge, value, DECODE_FLAG_ERROR);
+            bits = 0;
+        } else if (last_edge) {
+            period = gap;
+        }
+        if (bits == 0) { start = pos; value = 0; }
+        value = (value << 1) | mosi;
+        if (++bits == 8) {
+            emit(pos, value, 0);
+            bits = 0;
+        }
+        last_edge = pos;
+    }
+    prev = l;
+}
+
+void decode_feed(const uint8_t *s, uint32_t n){
+    if (!levels || (proto == DECODE_UART && !bit_q8)) return;
+    for (uint32_t i = 0; i < n; i++, pos++) {
+        int l = slice(s[i]);
+        // Nothing to compare the first sample with
+        if (pos == 0) { prev = l; continue; }
+        if (proto == DECODE_UART) uart_sample(l);
+        else if (proto == DECODE_I2C) i2c_sample(l);
+        else if (proto == DECODE_SPI) spi_sample(l);
+    }
+}
+
+uint32_t decode_bit_q8(){
+    return bit_q8;
+}
+
+int decode_count(){
+    return count;
+}
+
+uint32_t decode_total(){
+    return total;
+}
+
+const decode_event_t *decode_event(int index){
+    return &events[index];
+}
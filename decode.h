@@ -0,0 +1,66 @@
+#ifndef DECODE_H
+#define DECODE_H
+
+#include "pico/stdlib.h"
+
+// Serial protocol decoding
+//
+// Samples are sliced into logic levels with hysteresis and fed through a
+// small state machine per protocol, a chunk at a time, so a deep record
+// decodes straight out of its own memory with nothing copied.
+//
+// There's one analog input, so the two-wire buses are summed onto it:
+// data through 10k and clock through 20k to the probe tip. That gives four
+// evenly spaced levels, data as the top bit and clock as the bottom one.
+// UART is one line straight onto the probe, idle high, 8N1, LSB first.
+// SPI is mode 0 (MOSI read on SCK rising), MSB first, and with no chip
+// select a pause in the clock starts a new byte.
+//
+// At 500 kS/s that's good for UART to about 115200 baud and I2C and SPI
+// clocks to about 100 kHz.
+
+#define DECODE_MAX_EVENTS   128     // kept per decode, later ones only counted
+#define DECODE_MIN_SWING    16      // codes between the capture's lowest and highest to bother
+#define DECODE_MAX_RUN      128     // longest run auto-baud looks at, ~4k baud at 500 kS/s
+#define DECODE_SPI_GAP      4       // clock periods of quiet that end a word
+
+typedef enum decode_proto {
+    DECODE_OFF,
+    DECODE_UART,
+    DECODE_I2C,
+    DECODE_SPI,
+    DECODE_PROTO_COUNT
+} decode_proto_t;
+
+// Event flags
+#define DECODE_FLAG_START   0x01    // I2C: first byte after a start, the address
+#define DECODE_FLAG_NACK    0x02    // I2C: not acknowledged
+#define DECODE_FLAG_STOP    0x04    // I2C: stop condition followed it
+#define DECODE_FLAG_ERROR   0x08    // UART: framing error, SPI: word cut short
+
+typedef struct decode_event {
+    uint32_t start;     // sample index
+    uint32_t end;
+    uint8_t value;
+    uint8_t flags;
+} decode_event_t;
+
+void decode_begin(decode_proto_t proto, uint8_t lo, uint8_t hi, uint32_t baud, uint32_t sample_rate);
+
+bool decode_needs_measure();
+
+void decode_measure(const uint8_t *samples, uint32_t count);
+
+void decode_start();
+
+void decode_feed(const uint8_t *samples, uint32_t count);
+
+uint32_t decode_bit_q8();
+
+int decode_count();
+
+uint32_t decode_total();
+
+const decode_event_t *decode_event(int index);
+
+#endif
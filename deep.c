@@ -0,0 +1,227 @@
+// Deep memory capture and its min/max pyramid
+// Level 1 holds the min and max of each 32-sample block; every level above
+// folds 4 entries of the one below. Entries are indexed by physical ring
+// position, so they can be built as the DMA goes round without knowing
+// where the record will end up starting.
+
+#include "deep.h"
+#include "pico/stdlib.h"
+#include "adc.h"
+
+// Samples on screen times this many screens, for deep_length_for()
+#define DEEP_SCREENS 32
+
+#define LEVEL_ENTRIES(l) (DEEP_MAX_SAMPLES / (DEEP_BLOCK << (2 * (l))))
+// All DEEP_LEVELS levels back to back
+#define MIP_ENTRIES (LEVEL_ENTRIES(0) + LEVEL_ENTRIES(1) + LEVEL_ENTRIES(2) + LEVEL_ENTRIES(3) + LEVEL_ENTRIES(4))
+
+uint8_t deep_buf[DEEP_MAX_SAMPLES] __aligned(4);
+
+static uint8_t mip_min_store[MIP_ENTRIES];
+static uint8_t mip_max_store[MIP_ENTRIES];
+static uint8_t *mip_min[DEEP_LEVELS];
+static uint8_t *mip_max[DEEP_LEVELS];
+
+static volatile deep_state_t state = DEEP_IDLE;
+static uint32_t length = 0;
+static uint32_t built = 0;          // physical start of the next block to fold in
+static uint32_t filled = 0;         // samples folded in since arming
+static volatile uint32_t trigger_phys = 0;
+static uint32_t oldest_phys = 0;    // physical index of logical sample 0, once done
+static uint32_t trigger_pos = 0;
+// Set if core 1 was away long enough for the DMA to lap the pyramid builder
+static bool lagged = false;
+static uint32_t last_service_us = 0;
+
+static inline uint32_t block_size(int level){
+    return DEEP_BLOCK << (2 * level);
+}
+
+static inline uint32_t ring_dist(uint32_t from, uint32_t to){
+    return (to >= from) ? to - from : to + length - from;
+}
+
+// Recompute the level 1 entry for one block, then every ancestor whose
+// last child it was (or all of them, when patching the seam at the end)
+static void fold_block(uint32_t phys, bool all_ancestors){
+    uint32_t e = phys / DEEP_BLOCK;
+    const uint32_t *words = (const uint32_t *)&deep_buf[phys];
+    uint8_t lo = 255, hi = 0;
+    for (int i = 0; i < DEEP_BLOCK / 4; i++) {
+        uint32_t w = words[i];
+        for (int b = 0; b < 4; b++) {
+            uint8_t s = w >> (8 * b);
+            if (s < lo) lo = s;
+            if (s > hi) hi = s;
+        }
+    }
+    mip_min[0][e] = lo;
+    mip_max[0][e] = hi;
+
+    for (int l = 1; l < DEEP_LEVELS; l++) {
+        if (!all_ancestors && (e % DEEP_FANOUT) != DEEP_FANOUT - 1) break;
+        uint32_t parent = e / DEEP_FANOUT;
+        uint32_t first = parent * DEEP_FANOUT;
+        lo = 255; hi = 0;
+        for (int c = 0; c < DEEP_FANOUT; c++) {
+            if (mip_min[l - 1][first + c] < lo) lo = mip_min[l - 1][first + c];
+            if (mip_max[l - 1][first + c] > hi) hi = mip_max[l - 1][first + c];
+        }
+        mip_min[l][parent] = lo;
+        mip_max[l][parent] = hi;
+        e = parent;
+    }
+}
+
+// Record length to use for a given on-screen span, a multiple of the top
+// pyramid block so every level tiles the ring exactly
+uint32_t deep_length_for(uint32_t samples_on_screen){
+    uint32_t len = samples_on_screen * DEEP_SCREENS;
+    len = (len + DEEP_TOP_BLOCK - 1) / DEEP_TOP_BLOCK * DEEP_TOP_BLOCK;
+    if (len < DEEP_MIN_SAMPLES) len = DEEP_MIN_SAMPLES;
+    if (len > DEEP_MAX_SAMPLES) len = DEEP_MAX_SAMPLES;
+    return len;
+}
+
+// Core 0: start a new record of the given length
+void deep_arm(uint32_t len){
+    state = DEEP_IDLE;
+    uint32_t base = 0;
+    for (int l = 0; l < DEEP_LEVELS; l++) {
+        mip_min[l] = &mip_min_store[base];
+        mip_max[l] = &mip_max_store[base];
+        base += LEVEL_ENTRIES(l);
+    }
+
+    length = len;
+    built = 0;
+    filled = 0;
+    lagged = false;
+    last_service_us = time_us_32();
+    adc_capture_retarget(deep_buf, length);
+    state = DEEP_FILLING;
+}
+
+// Core 0: hand the ADC back to the normal screen ring
+void deep_release(){
+    state = DEEP_IDLE;
+    adc_capture_retarget(capture_buf, CAPTURE_DEPTH);
+}
+
+// Trigger GPIO IRQ, while in deep mode
+void deep_trigger_isr(){
+    if (state != DEEP_ARMED) return;
+    trigger_phys = adc_capture_write_index();
+    state = DEEP_TRIGGERED;
+}
+
+// Core 1: fold in whatever the DMA has finished and stop the capture once
+// the post-trigger half is in. Returns true if it did any work.
+bool deep_service(){
+    deep_state_t s = state;
+    if (s == DEEP_IDLE || s == DEEP_DONE) return false;
+
+    uint32_t now = time_us_32();
+    bool lapped = (uint64_t)(now - last_service_us) * ADC_SAMPLE_RATE_HZ / 1000000 >= length - DEEP_BLOCK;
+    if (lapped) lagged = true;
+    last_service_us = now;
+
+    // The trigger sample may have been written over while we were away, so
+    // the record can't be trusted. The ring is still full, wait for another.
+    if (lapped && s == DEEP_TRIGGERED) {
+        state = DEEP_ARMED;
+        s = DEEP_ARMED;
+    }
+
+    uint32_t w = adc_capture_write_index();
+    bool work = false;
+    while (ring_dist(built, w) >= DEEP_BLOCK) {
+        fold_block(built, false);
+        built += DEEP_BLOCK;
+        if (built >= length) built = 0;
+        filled += DEEP_BLOCK;
+        work = true;
+    }
+
+    if (s == DEEP_FILLING && filled >= length) {
+        state = DEEP_ARMED;
+    } else if (s == DEEP_TRIGGERED && ring_dist(trigger_phys, w) >= length / 2) {
+        adc_capture_pause();
+        w = adc_capture_write_index();
+        // Fold in the tail, then patch the block where newest meets oldest
+        while (ring_dist(built, w) >= DEEP_BLOCK) {
+            fold_block(built, false);
+            built += DEEP_BLOCK;
+            if (built >= length) built = 0;
+        }
+        fold_block(w / DEEP_BLOCK * DEEP_BLOCK, true);
+        // Lost track at some point, just rebuild the lot (a few ms)
+        if (lagged) {
+            for (uint32_t p = 0; p < length; p += DEEP_BLOCK) fold_block(p, false);
+        }
+        oldest_phys = w;
+        trigger_pos = ring_dist(w, trigger_phys);
+        state = DEEP_DONE;
+        work = true;
+    }
+    return work;
+}
+
+deep_state_t deep_state(){
+    return state;
+}
+
+uint32_t deep_length(){
+    return length;
+}
+
+// Logical index of the trigger
+uint32_t deep_trigger_pos(){
+    return trigger_pos;
+}
+
+uint8_t deep_sample(uint32_t index){
+    uint32_t p = oldest_phys + index;
+    if (p >= length) p -= length;
+    return deep_buf[p];
+}
+
+// Min and max over a physical range that doesn't wrap. Climbs to the
+// biggest aligned pyramid entry that fits at each step, so the cost is
+// bounded by the level count, not the range.
+static void phys_minmax(uint32_t a, uint32_t b, uint8_t *lo, uint8_t *hi){
+    while (a < b) {
+        int level = -1;
+        for (int l = DEEP_LEVELS - 1; l >= 0; l--) {
+            uint32_t bs = block_size(l);
+            if (a % bs == 0 && a + bs <= b) { level = l; break; }
+        }
+        if (level < 0) {
+            uint8_t s = deep_buf[a++];
+            if (s < *lo) *lo = s;
+            if (s > *hi) *hi = s;
+        } else {
+            uint32_t e = a / block_size(level);
+            if (mip_min[level][e] < *lo) *lo = mip_min[level][e];
+            if (mip_max[level][e] > *hi) *hi = mip_max[level][e];
+            a += block_size(level);
+        }
+    }
+}
+
+// Min and max of count samples starting at a logical index
+void deep_minmax(uint32_t start, uint32_t count, uint8_t *lo, uint8_t *hi){
+    *lo = 255;
+    *hi = 0;
+    if (start >= length) return;
+    if (start + count > length) count = length - start;
+    uint32_t a = oldest_phys + start;
+    if (a >= length) a -= length;
+    uint32_t first = length - a;
+    if (count <= first) {
+        phys_minmax(a, a + count, lo, hi);
+    } else {
+        phys_minmax(a, length, lo, hi);
+        phys_minmax(0, count - first, lo, hi);
+    }
+}
@@ -0,0 +1,54 @@
+#ifndef DEEP_H
+#define DEEP_H
+
+#include "pico/stdlib.h"
+
+// Deep memory capture
+//
+// The ADC ring is pointed at a big buffer instead of the 320-sample screen
+// ring. Once it has filled, the next trigger lets it run for another half
+// buffer and then freezes it, so the trigger sits in the middle of the
+// record. While it runs, core 1 folds every finished block into a min/max
+// pyramid so the viewer never has to rescan raw samples.
+//
+// Indices in the API are logical: 0 is the oldest sample in the record.
+
+#define DEEP_MAX_SAMPLES    (128 * 1024)
+#define DEEP_BLOCK          32          // samples per level 1 entry
+#define DEEP_FANOUT         4           // entries folded into one entry of the next level
+#define DEEP_LEVELS         5
+#define DEEP_TOP_BLOCK      (DEEP_BLOCK << (2 * (DEEP_LEVELS - 1)))     // 8192
+#define DEEP_MIN_SAMPLES    DEEP_TOP_BLOCK
+
+typedef enum deep_state {
+    DEEP_IDLE,          // not capturing
+    DEEP_FILLING,       // waiting for the ring to fill once (pre-trigger data)
+    DEEP_ARMED,         // waiting for a trigger
+    DEEP_TRIGGERED,     // capturing the post-trigger half
+    DEEP_DONE           // frozen, safe to read
+} deep_state_t;
+
+// Also used as the segment arena, the two modes never run together
+extern uint8_t deep_buf[DEEP_MAX_SAMPLES];
+
+uint32_t deep_length_for(uint32_t samples_on_screen);
+
+void deep_arm(uint32_t length);
+
+void deep_release();
+
+void deep_trigger_isr();
+
+bool deep_service();
+
+deep_state_t deep_state();
+
+uint32_t deep_length();
+
+uint32_t deep_trigger_pos();
+
+uint8_t deep_sample(uint32_t index);
+
+void deep_minmax(uint32_t start, uint32_t count, uint8_t *lo, uint8_t *hi);
+
+#endif
@@ -0,0 +1,154 @@
+// Equivalent-time sampling
+// The IRQ only timestamps the trigger against the sample clock and queues
+// it; core 1 does the accumulating once the post-trigger samples have
+// landed in the ADC ring. Core 1 is the only writer of the bins, and each
+// bin is one word, so core 0 can draw them without any locking.
+
+#include "ets.h"
+#include "pico/stdlib.h"
+#include "hardware/clocks.h"
+#include "hardware/structs/systick.h"
+#include "hardware/sync.h"
+#include "adc.h"
+
+// Trigger edge to the first SysTick read: IRQ entry, the SDK's GPIO
+// dispatch and gpio_callback. Only shifts where the trigger lands on
+// screen. What smears the bins is how much this varies, so the IRQ runs at
+// the top priority on core 0 and the path in is kept out of flash.
+#define ETS_LATENCY_CYCLES  120
+
+typedef struct ets_event {
+    uint16_t index;     // ring slot of the first sample to land after the trigger
+    uint16_t phase;     // how far after the trigger that sample was, in bins
+    uint32_t time_us;   // when the IRQ saw it
+} ets_event_t;
+
+static ets_event_t events[ETS_EVENTS];
+static volatile uint32_t head = 0;      // written by the IRQ
+static volatile uint32_t tail = 0;      // written by core 1
+static volatile uint32_t dropped = 0;
+static volatile uint32_t triggers = 0;
+static volatile bool reset_pending = false;
+
+// Sum in the top bits, count in the bottom ETS_COUNT_BITS
+static volatile uint32_t bins[ETS_BINS];
+
+static uint32_t cycles_per_sample = 250;
+
+void ets_init(){
+    cycles_per_sample = clock_get_hz(clk_sys) / ADC_SAMPLE_RATE_HZ;
+    // Free-running 24-bit down counter on the CPU clock
+    systick_hw->rvr = 0xFFFFFF;
+    systick_hw->cvr = 0;
+    systick_hw->csr = M0PLUS_SYST_CSR_CLKSOURCE_BITS | M0PLUS_SYST_CSR_ENABLE_BITS;
+    ets_reset();
+}
+
+// Start accumulating from scratch (settings changed, new signal)
+void ets_reset(){
+    reset_pending = true;
+}
+
+// Trigger GPIO IRQ, while in equivalent-time mode. Spins until the next
+// sample lands (at most one sample period) to see where the trigger fell.
+void __time_critical_func(ets_trigger_isr)(){
+    if (head - tail >= ETS_EVENTS) { dropped++; return; }
+
+    uint32_t t0 = systick_hw->cvr;
+    uint w0 = adc_capture_write_index();
+    uint w;
+    uint32_t elapsed;
+    do {
+        w = adc_capture_write_index();
+        elapsed = (t0 - systick_hw->cvr) & 0xFFFFFF;
+    } while (w == w0 && elapsed < 2 * cycles_per_sample);
+    if (w == w0) return;    // ADC isn't running
+
+    ets_event_t *ev = &events[head & (ETS_EVENTS - 1)];
+    ev->index = w0;
+    ev->time_us = time_us_32();
+    ev->phase = (elapsed + ETS_LATENCY_CYCLES) * ETS_FACTOR / cycles_per_sample;
+    __dmb();
+    head++;
+}
+
+static inline uint32_t ring_dist(uint32_t from, uint32_t to){
+    return (to >= from) ? to - from : to + CAPTURE_DEPTH - from;
+}
+
+static void accumulate(int bin, uint8_t sample){
+    uint32_t b = bins[bin];
+    uint32_t count = b & ETS_COUNT_MAX;
+    uint32_t sum = b >> ETS_COUNT_BITS;
+    // Full: halve both, so old triggers fade out instead of overflowing
+    if (count == ETS_COUNT_MAX) { sum >>= 1; count >>= 1; }
+    bins[bin] = ((sum + sample) << ETS_COUNT_BITS) | (count + 1);
+}
+
+// Core 1: fold every queued trigger whose samples have all landed into
+// the bins. Returns true if it did any work.
+bool ets_service(){
+    if (reset_pending) {
+        reset_pending = false;
+        for (int i = 0; i < ETS_BINS; i++) bins[i] = 0;
+        triggers = 0;
+        tail = head;
+        return true;
+    }
+
+    bool work = false;
+    while (tail != head) {
+        __dmb();
+        ets_event_t ev = events[tail & (ETS_EVENTS - 1)];
+        // Sample j after the landed one goes in bin ETS_TRIGGER_BIN + phase + j * ETS_FACTOR
+        int base = ETS_TRIGGER_BIN + ev.phase;
+        int first = -(base / ETS_FACTOR);
+        int last = (ETS_BINS - 1 - base) / ETS_FACTOR;
+        if (base >= ETS_BINS) last = first - 1;
+
+        // Samples since, by the clock: the ring distance aliases once core 1
+        // has been away a whole lap (flash lockout, the DFT, a stream frame)
+        uint32_t age = (uint32_t)((uint64_t)(time_us_32() - ev.time_us) * ADC_SAMPLE_RATE_HZ / 1000000);
+        if (age + (uint32_t)(-first) + ETS_LAP_MARGIN >= CAPTURE_DEPTH) {
+            dropped++;                                          // ring already lapped it
+        } else {
+            uint32_t have = ring_dist(ev.index, adc_capture_write_index());
+            if (have <= (uint32_t)(last < 0 ? 0 : last)) break; // not all in yet
+            for (int j = first; j <= last; j++) {
+                int slot = (int)ev.index + j;
+                if (slot < 0) slot += CAPTURE_DEPTH;
+                if (slot >= CAPTURE_DEPTH) slot -= CAPTURE_DEPTH;
+                accumulate(base + j * ETS_FACTOR, capture_buf[slot]);
+            }
+            triggers++;
+        }
+        __dmb();
+        tail++;
+        work = true;
+    }
+    return work;
+}
+
+// Average of one bin, false if nothing has landed in it yet
+bool ets_bin(int bin, uint8_t *value){
+    uint32_t b = bins[bin];
+    uint32_t count = b & ETS_COUNT_MAX;
+    if (count == 0) return false;
+    *value = ((b >> ETS_COUNT_BITS) + count / 2) / count;
+    return true;
+}
+
+// Bins with at least one sample, for the fill progress readout
+int ets_filled(){
+    int n = 0;
+    for (int i = 0; i < ETS_BINS; i++) if (bins[i] & ETS_COUNT_MAX) n++;
+    return n;
+}
+
+uint32_t ets_triggers(){
+    return triggers;
+}
+
+uint32_t ets_dropped(){
+    return dropped;
+}
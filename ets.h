@@ -0,0 +1,43 @@
+#ifndef ETS_H
+#define ETS_H
+
+#include "pico/stdlib.h"
+
+// Equivalent-time sampling
+//
+// For repetitive signals only. The trigger IRQ times, in CPU cycles, how
+// far the trigger fell from the next ADC sample. Core 1 then drops the
+// samples around that trigger into a grid ETS_FACTOR times finer than the
+// ADC, shifted by that phase. Triggers arrive at random phases, so over
+// many of them every bin fills and the per-bin average is the waveform at
+// ETS_FACTOR x the ADC rate.
+
+#define ETS_FACTOR      16          // bins per ADC sample, 8 MS/s effective
+#define ETS_PRE         4           // ADC samples before the trigger
+#define ETS_SPAN        18          // ADC samples per trigger
+#define ETS_BINS        (ETS_SPAN * ETS_FACTOR)
+#define ETS_TRIGGER_BIN (ETS_PRE * ETS_FACTOR)
+#define ETS_EVENTS      8           // triggers queued for core 1, power of 2
+#define ETS_LAP_MARGIN  16          // samples short of a lap before an event counts as overwritten
+
+// Each bin packs its sum and count into one word
+#define ETS_COUNT_BITS  10
+#define ETS_COUNT_MAX   ((1u << ETS_COUNT_BITS) - 1)
+
+void ets_init();
+
+void ets_reset();
+
+void ets_trigger_isr();
+
+bool ets_service();
+
+bool ets_bin(int bin, uint8_t *value);
+
+int ets_filled();
+
+uint32_t ets_triggers();
+
+uint32_t ets_dropped();
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef FLASH_LAYOUT_H
+#define FLASH_LAYOUT_H
+
+#include "hardware/flash.h"
+
+// Where things live in the 2MB QSPI flash. Offsets are from the start of
+// flash (what flash_range_* wants); add XIP_BASE to read them.
+//
+//   0          firmware (well under 1MB)
+//   1MB        capture recording log
+//   top 64KB   reserved: front end calibration in the first sector,
+//              then the settings ring
+
+#define FLASH_RESERVED_TOP_SIZE (64 * 1024)
+
+#define FLASH_RECORD_OFFSET     (1024 * 1024)
+#define FLASH_RECORD_SIZE       (PICO_FLASH_SIZE_BYTES - FLASH_RECORD_OFFSET - FLASH_RESERVED_TOP_SIZE)
+
+#define FLASH_RESERVED_OFFSET   (PICO_FLASH_SIZE_BYTES - FLASH_RESERVED_TOP_SIZE)
+
+#define FLASH_CALIB_OFFSET      FLASH_RESERVED_OFFSET
+#define FLASH_SETTINGS_OFFSET   (FLASH_RESERVED_OFFSET + FLASH_SECTOR_SIZE)
+
+#endif
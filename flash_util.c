@@ -0,0 +1,53 @@
+// Flash erase/program wrappers
+// XIP is unavailable while flash is being written, so flash_safe_execute
+// parks the other core in RAM (it has to have called
+// multicore_lockout_victim_init) and disables interrupts around the op.
+
+#include "flash_util.h"
+#include "pico/stdlib.h"
+#include "pico/flash.h"
+#include "hardware/flash.h"
+
+typedef struct flash_op {
+    uint32_t offset;
+    const uint8_t *data;
+    size_t len;
+} flash_op_t;
+
+static void do_erase(void *param){
+    flash_op_t *op = (flash_op_t *)param;
+    flash_range_erase(op->offset, op->len);
+}
+
+static void do_program(void *param){
+    flash_op_t *op = (flash_op_t *)param;
+    flash_range_program(op->offset, op->data, op->len);
+}
+
+// offset and len must be sector aligned
+bool flash_util_erase(uint32_t offset, size_t len){
+    flash_op_t op = { offset, NULL, len };
+    return flash_safe_execute(do_erase, &op, FLASH_UTIL_TIMEOUT_MS) == PICO_OK;
+}
+
+// offset and len must be page aligned, data must be in RAM
+bool flash_util_program(uint32_t offset, const uint8_t *data, size_t len){
+    flash_op_t op = { offset, data, len };
+    return flash_safe_execute(do_program, &op, FLASH_UTIL_TIMEOUT_MS) == PICO_OK;
+}
+
+// Memory-mapped view for reading
+const uint8_t *flash_util_ptr(uint32_t offset){
+    return (const uint8_t *)(XIP_BASE + offset);
+}
+
+// CRC-16/CCITT for records kept in flash, chain calls to cover several parts
+uint16_t flash_util_crc16(uint16_t crc, const uint8_t *data, int len){
+    for (int i = 0; i < len; i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for (int b = 0; b < 8; b++) {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+        }
+    }
+    return crc;
+}
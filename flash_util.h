@@ -0,0 +1,17 @@
+#ifndef FLASH_UTIL_H
+#define FLASH_UTIL_H
+
+#include "pico/stdlib.h"
+
+// How long to wait for the other core to park before giving up
+#define FLASH_UTIL_TIMEOUT_MS 100
+
+bool flash_util_erase(uint32_t offset, size_t len);
+
+bool flash_util_program(uint32_t offset, const uint8_t *data, size_t len);
+
+const uint8_t *flash_util_ptr(uint32_t offset);
+
+uint16_t flash_util_crc16(uint16_t crc, const uint8_t *data, int len);
+
+#endif
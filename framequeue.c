@@ -0,0 +1,44 @@
+// Core 0 -> core 1 frame pool
+// Each side only writes its own index, so no lock is needed. The barriers
+// make sure the slot contents land before the index that publishes them.
+
+#include "framequeue.h"
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+
+static frame_slot_t slots[FRAME_QUEUE_SLOTS];
+static volatile uint32_t head = 0;  // written by the producer
+static volatile uint32_t tail = 0;  // written by the consumer
+static volatile uint32_t dropped = 0;
+
+// Producer: a free slot to fill, or NULL if the consumer is behind
+frame_slot_t *framequeue_acquire(){
+    if (head - tail >= FRAME_QUEUE_SLOTS) {
+        dropped++;
+        return NULL;
+    }
+    return &slots[head & (FRAME_QUEUE_SLOTS - 1)];
+}
+
+// Producer: hand the slot from framequeue_acquire() to the consumer
+void framequeue_publish(){
+    __dmb();
+    head++;
+}
+
+// Consumer: the oldest queued frame, or NULL
+frame_slot_t *framequeue_peek(){
+    if (head == tail) return NULL;
+    __dmb();
+    return &slots[tail & (FRAME_QUEUE_SLOTS - 1)];
+}
+
+// Consumer: done with the frame from framequeue_peek()
+void framequeue_release(){
+    __dmb();
+    tail++;
+}
+
+uint32_t framequeue_dropped(){
+    return dropped;
+}
@@ -0,0 +1,33 @@
+#ifndef FRAMEQUEUE_H
+#define FRAMEQUEUE_H
+
+#include "pico/stdlib.h"
+#include "adc.h"
+
+// Pool of captured frames handed from core 0 (acquisition) to core 1
+// (streaming). Single producer, single consumer. The producer never waits:
+// if every slot is still queued the frame is dropped and counted.
+
+// Must be a power of 2
+#define FRAME_QUEUE_SLOTS 4
+
+typedef struct frame_slot {
+    uint32_t seq;               // capture sequence number, counts dropped frames too
+    uint32_t time_us;           // when it was captured
+    uint16_t trigger_index;     // sample the trigger fired on
+    uint16_t count;             // valid samples
+    uint8_t gain;               // gain_mode_t at capture time
+    uint8_t samples[CAPTURE_DEPTH];
+} frame_slot_t;
+
+frame_slot_t *framequeue_acquire();
+
+void framequeue_publish();
+
+frame_slot_t *framequeue_peek();
+
+void framequeue_release();
+
+uint32_t framequeue_dropped();
+
+#endif
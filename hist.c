@@ -0,0 +1,111 @@
+// Sample value histogram
+// Core 1 is the only writer of the bins and each one is a single word, so
+// core 0 reads them for drawing without locking, same as the ETS bins.
+
+#include "hist.h"
+#include "pico/stdlib.h"
+#include "adc.h"
+#include <math.h>
+
+static volatile uint32_t bins[HIST_BINS];
+static volatile bool enabled = false;
+static volatile bool reset_pending = false;
+static volatile uint32_t dropped = 0;
+
+// Core 1 only
+static bool running = false;
+static adc_follower_t follower;
+static uint32_t since_halving = 0;
+
+void hist_enable(bool on){
+    if (on && !enabled) reset_pending = true;
+    enabled = on;
+}
+
+// Core 1 clears the bins on its next pass
+void hist_reset(){
+    reset_pending = true;
+}
+
+static void __time_critical_func(count_span)(const uint8_t *p, uint n){
+    volatile uint32_t *b = bins;
+    while (n--) b[*p++]++;
+}
+
+// Count whatever the DMA has written since the last pass. Returns true if
+// it's falling behind and wants to be called again straight away.
+bool hist_service(){
+    if (!enabled) { running = false; return false; }
+
+    if (!running || reset_pending) {
+        reset_pending = false;
+        for (int i = 0; i < HIST_BINS; i++) bins[i] = 0;
+        dropped = 0;
+        since_halving = 0;
+        adc_follow_start(&follower, 1);
+        running = true;
+        return false;
+    }
+
+    uint32_t lost = adc_follow_lapped(&follower, CAPTURE_DEPTH - HIST_LAP_MARGIN);
+    if (lost) {
+        dropped += lost;
+        return false;
+    }
+
+    uint n = adc_follow(&follower, count_span);
+    since_halving += n;
+    if (since_halving >= HIST_HALVE_AT) {
+        for (int i = 0; i < HIST_BINS; i++) bins[i] >>= 1;
+        since_halving >>= 1;
+    }
+    return n > CAPTURE_DEPTH / 2;
+}
+
+uint32_t hist_bin(int code){
+    return bins[code & (HIST_BINS - 1)];
+}
+
+uint32_t hist_dropped(){
+    return dropped;
+}
+
+// One pass over the bins, integer sums then a few floats at the end
+void hist_stats(hist_stats_t *s){
+    uint64_t n = 0, s1 = 0, s2 = 0;
+    uint32_t peak = 0;
+    int lo = -1, hi = -1;
+    s->mode = 0;
+    for (int i = 0; i < HIST_BINS; i++) {
+        uint32_t b = bins[i];
+        if (!b) continue;
+        if (lo < 0) lo = i;
+        hi = i;
+        n += b;
+        s1 += (uint64_t)b * i;
+        s2 += (uint64_t)b * i * i;
+        if (b > peak) { peak = b; s->mode = i; }
+    }
+    s->count = n;
+    s->lo = (lo < 0) ? 0 : lo;
+    s->hi = (hi < 0) ? 0 : hi;
+    s->mean = s->sd = s->dnl = 0;
+    if (n == 0) return;
+
+    double mean = (double)s1 / n;
+    double var = (double)s2 / n - mean * mean;
+    s->mean = mean;
+    s->sd = (var > 0) ? sqrtf(var) : 0;
+
+    // End codes also collect everything past them, leave them out
+    if (hi - lo < 3) return;
+    uint64_t inner = 0;
+    for (int i = lo + 1; i < hi; i++) inner += bins[i];
+    float avg = (float)inner / (hi - lo - 1);
+    if (avg <= 0) return;
+    for (int i = lo + 1; i < hi; i++) {
+        float d = bins[i] / avg - 1.0f;
+        if (d < 0) d = -d;
+        if (d > s->dnl) s->dnl = d;
+    }
+}
@@ -0,0 +1,39 @@
+#ifndef HIST_H
+#define HIST_H
+
+#include "pico/stdlib.h"
+
+// Sample value histogram
+//
+// Core 1 taps the free-running ADC ring behind the DMA and counts every
+// code it gets to before the ring laps it, so a few seconds is millions of
+// samples. Good for the noise floor (a DC input), and for code density
+// tests of ADC linearity (a ramp or triangle across the full range).
+
+#define HIST_BINS           256
+#define HIST_HALVE_AT       (1u << 31)  // halve everything before a bin can wrap
+#define HIST_LAP_MARGIN     32          // samples the DMA may get within before we call it lapped
+
+typedef struct hist_stats {
+    uint64_t count;
+    float mean;         // codes
+    float sd;           // codes
+    uint8_t lo;         // lowest and highest code seen
+    uint8_t hi;
+    uint8_t mode;       // fullest bin
+    float dnl;          // worst |bin / average - 1| inside lo..hi, for a uniform input
+} hist_stats_t;
+
+void hist_enable(bool on);
+
+void hist_reset();
+
+bool hist_service();
+
+uint32_t hist_bin(int code);
+
+uint32_t hist_dropped();
+
+void hist_stats(hist_stats_t *s);
+
+#endif
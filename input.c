@@ -0,0 +1,113 @@
+// Input event layer
+// The gamepad poller and the encoder turn their raw state into timestamped
+// press/release/rotate events in a small ring. The UI only does work when
+// there is something in the ring.
+
+#include "input.h"
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+#include "seesaw.h"
+#include "rotary.h"
+
+static input_event_t queue[INPUT_QUEUE_SIZE];
+static volatile uint32_t queue_head = 0;   // next slot to write
+static volatile uint32_t queue_tail = 0;   // next slot to read
+static volatile uint32_t last_event_us = 0;
+static uint32_t dropped_events = 0;
+
+// Which keys were down last time each driver looked
+static uint32_t pad_keys_down = 0;
+static bool enc_sw_down = false;
+
+// Seesaw button for each gamepad key, in input_key_t order
+static const uint32_t pad_button_masks[] = {
+    MASK_A, MASK_B, MASK_X, MASK_Y, MASK_SELECT, MASK_START
+};
+
+// Safe to call from IRQs and threads on core 0
+bool input_push(const input_event_t *ev){
+    uint32_t save = save_and_disable_interrupts();
+    bool ok = (queue_head - queue_tail) < INPUT_QUEUE_SIZE;
+    if (ok) {
+        queue[queue_head & (INPUT_QUEUE_SIZE - 1)] = *ev;
+        queue_head++;
+        last_event_us = ev->time_us;
+    } else {
+        dropped_events++;
+    }
+    restore_interrupts(save);
+    return ok;
+}
+
+bool input_pop(input_event_t *ev){
+    uint32_t save = save_and_disable_interrupts();
+    bool ok = queue_head != queue_tail;
+    if (ok) {
+        *ev = queue[queue_tail & (INPUT_QUEUE_SIZE - 1)];
+        queue_tail++;
+    }
+    restore_interrupts(save);
+    return ok;
+}
+
+bool input_pending(){
+    return queue_head != queue_tail;
+}
+
+// Time since the last event of any kind
+uint32_t input_idle_us(){
+    return time_us_32() - last_event_us;
+}
+
+static void push_key(input_key_t key, bool down, uint32_t now){
+    input_event_t ev = { now, down ? EV_PRESS : EV_RELEASE, key, 0, 0 };
+    input_push(&ev);
+}
+
+// Turn a key's new level into an event if it changed
+static void update_key(input_key_t key, bool down, uint32_t now){
+    uint32_t bit = 1u << key;
+    bool was_down = (pad_keys_down & bit) != 0;
+    if (down == was_down) return;
+    if (down) pad_keys_down |= bit; else pad_keys_down &= ~bit;
+    push_key(key, down, now);
+}
+
+// Called by the seesaw poller (timer IRQ) after every completed cycle
+static void input_gamepad_callback(const seesaw_state_t *pad){
+    uint32_t now = time_us_32();
+
+    // Buttons read low when pressed
+    for (int key = KEY_A; key <= KEY_START; key++) {
+        update_key(key, !(pad->buttons & pad_button_masks[key]), now);
+    }
+
+    // The stick is mounted rotated, so high X is left
+    update_key(KEY_JOY_UP, pad->joy_y < JOY_THRESHOLD_LOW, now);
+    update_key(KEY_JOY_DOWN, pad->joy_y > JOY_THRESHOLD_HIGH, now);
+    update_key(KEY_JOY_LEFT, pad->joy_x > JOY_THRESHOLD_HIGH, now);
+    update_key(KEY_JOY_RIGHT, pad->joy_x < JOY_THRESHOLD_LOW, now);
+}
+
+// Encoder has no interrupt (it's decoded in PIO), so it gets polled from a thread
+void input_poll_encoder(){
+    uint32_t now = time_us_32();
+
+    int accel;
+    int delta = rotary_get_delta(&accel);
+    if (delta != 0) {
+        input_event_t ev = { now, EV_ROTATE, KEY_ENCODER, (int16_t)delta, (int16_t)accel };
+        input_push(&ev);
+    }
+
+    bool sw = rotary_switch_pressed();
+    if (sw != enc_sw_down) {
+        enc_sw_down = sw;
+        push_key(KEY_ENC_SW, sw, now);
+    }
+}
+
+void input_init(){
+    last_event_us = time_us_32();
+    seesaw_set_callback(input_gamepad_callback);
+}
@@ -0,0 +1,57 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include "pico/stdlib.h"
+
+// Size of the event ring, must be a power of 2
+#define INPUT_QUEUE_SIZE 32
+
+// Joystick Constants
+#define JOY_CENTER      512
+#define JOY_DEADZONE    400
+#define JOY_THRESHOLD_HIGH (JOY_CENTER + JOY_DEADZONE)
+#define JOY_THRESHOLD_LOW  (JOY_CENTER - JOY_DEADZONE)
+
+typedef enum input_event_type {
+    EV_PRESS,
+    EV_RELEASE,
+    EV_ROTATE
+} input_event_type_t;
+
+typedef enum input_key {
+    KEY_A,
+    KEY_B,
+    KEY_X,
+    KEY_Y,
+    KEY_SELECT,
+    KEY_START,
+    KEY_JOY_UP,
+    KEY_JOY_DOWN,
+    KEY_JOY_LEFT,
+    KEY_JOY_RIGHT,
+    KEY_ENC_SW,
+    KEY_ENCODER,    // EV_ROTATE only
+    KEY_COUNT
+} input_key_t;
+
+typedef struct input_event {
+    uint32_t time_us;   // time_us_32() when the driver saw it
+    uint8_t type;       // input_event_type_t
+    uint8_t key;        // input_key_t
+    int16_t delta;      // EV_ROTATE: detents turned
+    int16_t accel;      // EV_ROTATE: detents scaled by spin speed
+} input_event_t;
+
+void input_init();
+
+bool input_push(const input_event_t *ev);
+
+bool input_pop(input_event_t *ev);
+
+bool input_pending();
+
+uint32_t input_idle_us();
+
+void input_poll_encoder();
+
+#endif
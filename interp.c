@@ -0,0 +1,89 @@
+// Band-limited interpolation
+// Below one sample per column the trace used to repeat each sample into a
+// staircase. Resampling through a windowed sinc reconstructs what the ADC
+// actually saw, right up to Nyquist; linear is there as the cheap option.
+
+#include "interp.h"
+#include "pico/stdlib.h"
+#include <math.h>
+
+// Tap k of phase p weights sample floor(pos) - (INTERP_TAPS/2 - 1) + k
+static int16_t coefs[INTERP_PHASES][INTERP_TAPS];
+
+// Zeroth order modified Bessel function, for the Kaiser window
+static float bessel_i0(float x){
+    float sum = 1.0f, term = 1.0f;
+    for (int k = 1; k < 20; k++) {
+        term *= (x / (2 * k)) * (x / (2 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+// Built once at boot, float is fine here
+void interp_init(){
+    const float i0_beta = bessel_i0(INTERP_KAISER_BETA);
+    const float half = INTERP_TAPS / 2;
+    for (int p = 0; p < INTERP_PHASES; p++) {
+        float frac = (float)p / INTERP_PHASES;
+        float h[INTERP_TAPS];
+        float sum = 0;
+        for (int k = 0; k < INTERP_TAPS; k++) {
+            float d = (k - (half - 1)) - frac;
+            float sinc = (d == 0) ? 1.0f : sinf(M_PI * d) / (M_PI * d);
+            float r = d / half;
+            float w = (r * r < 1.0f) ? bessel_i0(INTERP_KAISER_BETA * sqrtf(1.0f - r * r)) / i0_beta : 0.0f;
+            h[k] = sinc * w;
+            sum += h[k];
+        }
+        // Every phase passes DC at exactly unity, so flat signals stay flat
+        int total = 0;
+        for (int k = 0; k < INTERP_TAPS; k++) {
+            coefs[p][k] = (int16_t)lroundf(h[k] / sum * (1 << INTERP_COEF_BITS));
+            total += coefs[p][k];
+        }
+        coefs[p][INTERP_TAPS / 2 - 1 + (p >= INTERP_PHASES / 2)] += (1 << INTERP_COEF_BITS) - total;
+    }
+}
+
+// One point between window[INTERP_TAPS/2 - 1] and the sample after it,
+// frac of the way along
+uint8_t interp_point(const uint8_t *window, uint32_t frac, interp_mode_t mode){
+    const uint8_t *s = &window[INTERP_TAPS / 2 - 1];
+    if (mode == INTERP_NONE || frac == 0) return s[0];
+    if (mode == INTERP_LINEAR) return s[0] + (((s[1] - s[0]) * (int)frac) >> INTERP_FRAC_BITS);
+
+    const int16_t *c = coefs[frac >> (INTERP_FRAC_BITS - INTERP_PHASE_BITS)];
+    int32_t acc = 1 << (INTERP_COEF_BITS - 1);
+    for (int k = 0; k < INTERP_TAPS; k++) acc += c[k] * window[k];
+    acc >>= INTERP_COEF_BITS;
+    // Ringing next to a sharp edge can overshoot the ADC range
+    if (acc < 0) acc = 0;
+    if (acc > 255) acc = 255;
+    return (uint8_t)acc;
+}
+
+// Sample the buffer at start + i * step for up to n points, stopping at the
+// end of the buffer. Returns how many points it produced.
+int interp_resample(const uint8_t *samples, uint32_t count, uint32_t start, uint32_t step,
+                    uint8_t *out, int n, interp_mode_t mode){
+    int i;
+    for (i = 0; i < n; i++) {
+        uint32_t pos = start + i * step;
+        uint32_t idx = pos >> INTERP_FRAC_BITS;
+        if (idx >= count) break;
+        int first = (int)idx - (INTERP_TAPS / 2 - 1);
+        if (first >= 0 && first + INTERP_TAPS <= (int)count) {
+            out[i] = interp_point(&samples[first], pos & ((1u << INTERP_FRAC_BITS) - 1), mode);
+        } else {
+            // Near the ends, hold the edge sample
+            uint8_t window[INTERP_TAPS];
+            for (int k = 0; k < INTERP_TAPS; k++) {
+                int j = first + k;
+                window[k] = samples[(j < 0) ? 0 : (j >= (int)count) ? count - 1 : j];
+            }
+            out[i] = interp_point(window, pos & ((1u << INTERP_FRAC_BITS) - 1), mode);
+        }
+    }
+    return i;
+}
@@ -0,0 +1,34 @@
+#ifndef INTERP_H
+#define INTERP_H
+
+#include "pico/stdlib.h"
+
+// Upsampling for timebases with fewer samples than screen columns
+//
+// The windowed-sinc filter is split into INTERP_PHASES sub-sample phases
+// of INTERP_TAPS taps each, in Q14 fixed point, so one output point is 16
+// multiply-adds with no float. Positions carry INTERP_FRAC_BITS of
+// fraction, the same as the viewer's.
+
+#define INTERP_TAPS         16
+#define INTERP_PHASE_BITS   5
+#define INTERP_PHASES       (1 << INTERP_PHASE_BITS)
+#define INTERP_FRAC_BITS    8
+#define INTERP_COEF_BITS    14
+#define INTERP_KAISER_BETA  5.0f   // flat to about 0.4 fs with 16 taps
+
+typedef enum interp_mode {
+    INTERP_NONE,        // nearest earlier sample (staircase)
+    INTERP_LINEAR,
+    INTERP_SINC,
+    INTERP_MODE_COUNT
+} interp_mode_t;
+
+void interp_init();
+
+uint8_t interp_point(const uint8_t *window, uint32_t frac, interp_mode_t mode);
+
+int interp_resample(const uint8_t *samples, uint32_t count, uint32_t start, uint32_t step,
+                    uint8_t *out, int n, interp_mode_t mode);
+
+#endif
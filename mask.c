@@ -0,0 +1,106 @@
+// Mask (limit) testing
+// Limits live as words so the compare can take four samples at a time.
+// Bytes within a word never borrow from each other: the top bit of each is
+// set aside and worked out from the low seven bits' borrow.
+
+#include "mask.h"
+#include "pico/stdlib.h"
+#include <string.h>
+
+#define MASK_WORDS  (MASK_LEN / 4)
+#define HIGH_BITS   0x80808080u
+
+static uint32_t upper[MASK_WORDS];
+static uint32_t lower[MASK_WORDS];
+static bool defined = false;
+static mask_counts_t counts = { .first_fail = -1 };
+
+// Top bit of each byte set where a >= b, unsigned
+static inline uint32_t bytes_ge(uint32_t a, uint32_t b){
+    uint32_t low = (a | HIGH_BITS) - (b & ~HIGH_BITS);
+    return ((a & ~b) | (~(a ^ b) & low)) & HIGH_BITS;
+}
+
+// Wide open, everything passes
+void mask_clear(){
+    memset(upper, 0xff, sizeof(upper));
+    memset(lower, 0x00, sizeof(lower));
+    defined = false;
+}
+
+void mask_set(int first, const uint8_t *lo, const uint8_t *hi, int count){
+    uint8_t *u = (uint8_t *)upper;
+    uint8_t *l = (uint8_t *)lower;
+    for (int i = 0; i < count && first + i < MASK_LEN; i++) {
+        if (first + i < 0) continue;
+        l[first + i] = lo[i];
+        u[first + i] = hi[i];
+    }
+    defined = true;
+}
+
+// Envelope of a known good frame: each sample's neighbours too, so a
+// little trigger jitter on an edge doesn't fail, then widened by tolerance
+void mask_learn(const uint8_t *frame, uint8_t tolerance){
+    uint8_t *u = (uint8_t *)upper;
+    uint8_t *l = (uint8_t *)lower;
+    for (int i = 0; i < MASK_LEN; i++) {
+        uint8_t lo = 255, hi = 0;
+        for (int j = i - MASK_LEARN_SPAN; j <= i + MASK_LEARN_SPAN; j++) {
+            if (j < 0 || j >= MASK_LEN) continue;
+            if (frame[j] < lo) lo = frame[j];
+            if (frame[j] > hi) hi = frame[j];
+        }
+        l[i] = (lo > tolerance) ? lo - tolerance : 0;
+        u[i] = (hi < 255 - tolerance) ? hi + tolerance : 255;
+    }
+    defined = true;
+}
+
+bool mask_defined(){
+    return defined;
+}
+
+uint8_t mask_lower(int index){
+    return ((const uint8_t *)lower)[index];
+}
+
+uint8_t mask_upper(int index){
+    return ((const uint8_t *)upper)[index];
+}
+
+// frame must be word aligned. Returns true if every sample is inside.
+bool __time_critical_func(mask_test)(const uint8_t *frame){
+    const uint8_t *p = __builtin_assume_aligned(frame, 4);
+    uint32_t any = 0;
+    for (int i = 0; i < MASK_WORDS; i++) {
+        uint32_t s;
+        memcpy(&s, p + 4 * i, 4);
+        any |= ~(bytes_ge(upper[i], s) & bytes_ge(s, lower[i])) & HIGH_BITS;
+    }
+
+    counts.tested++;
+    if (!any) { counts.passed++; return true; }
+
+    // Failures only: go back and find out where and how many
+    counts.failed++;
+    counts.first_fail = -1;
+    for (int i = 0; i < MASK_WORDS; i++) {
+        uint32_t s;
+        memcpy(&s, p + 4 * i, 4);
+        uint32_t bad = ~(bytes_ge(upper[i], s) & bytes_ge(s, lower[i])) & HIGH_BITS;
+        if (!bad) continue;
+        if (counts.first_fail < 0) counts.first_fail = 4 * i + __builtin_ctz(bad) / 8;
+        counts.violations += __builtin_popcount(bad);
+    }
+    return false;
+}
+
+const mask_counts_t *mask_counts(){
+    return &counts;
+}
+
+void mask_reset_counts(){
+    memset(&counts, 0, sizeof(counts));
+    counts.first_fail = -1;
+}
@@ -0,0 +1,50 @@
+#ifndef MASK_H
+#define MASK_H
+
+#include "pico/stdlib.h"
+#include "adc.h"
+
+// Mask (limit) testing
+//
+// An upper and lower limit for every sample of a frame, in raw ADC codes
+// like frame_buf itself, so a test is a straight compare with nothing
+// converted. Four samples are checked per word with no branches, which
+// keeps up with the fastest trigger rate with room to spare.
+//
+// Limit k is for the sample k slots on from the trigger, so frames are
+// unrolled from the trigger slot before they're learned or tested.
+
+#define MASK_LEN        CAPTURE_DEPTH
+#define MASK_LEARN_SPAN 1       // learned limits also cover this many samples either side
+
+#if MASK_LEN % 4
+#error "mask length must be a whole number of words"
+#endif
+
+typedef struct mask_counts {
+    uint32_t tested;
+    uint32_t passed;
+    uint32_t failed;
+    uint32_t violations;    // samples outside the limits, over every frame
+    int first_fail;         // first bad sample of the last failing frame, -1 if none yet
+} mask_counts_t;
+
+void mask_clear();
+
+void mask_set(int first, const uint8_t *lower, const uint8_t *upper, int count);
+
+void mask_learn(const uint8_t *frame, uint8_t tolerance);
+
+bool mask_defined();
+
+uint8_t mask_lower(int index);
+
+uint8_t mask_upper(int index);
+
+bool mask_test(const uint8_t *frame);
+
+const mask_counts_t *mask_counts();
+
+void mask_reset_counts();
+
+#endif
@@ -0,0 +1,48 @@
+// Frame measurements
+// All the per-sample work is on raw codes; only the results get mapped to
+// mV through the scale tables.
+
+#include "measure.h"
+#include "pico/stdlib.h"
+#include "scale.h"
+
+// samples is a ring, start is the oldest sample (the trigger index)
+void measure_frame(const uint8_t *samples, int count, int start, uint32_t sample_rate, measurements_t *m){
+    m->vmin_mv = m->vmax_mv = m->vpp_mv = m->vavg_mv = 0;
+    m->freq_hz = 0;
+    if (count <= 0) return;
+
+    uint8_t lo = 255, hi = 0;
+    uint32_t sum = 0;
+    for (int i = 0; i < count; i++) {
+        uint8_t s = samples[i];
+        if (s < lo) lo = s;
+        if (s > hi) hi = s;
+        sum += s;
+    }
+    m->vmin_mv = scale_mv_lut[lo];
+    m->vmax_mv = scale_mv_lut[hi];
+    m->vpp_mv = m->vmax_mv - m->vmin_mv;
+    m->vavg_mv = scale_mv_lut[(sum + count / 2) / count];
+
+    // Rising crossings of the midpoint, with hysteresis so noise on a slow
+    // edge doesn't count twice
+    int mid = (lo + hi) / 2;
+    int hyst = (hi - lo) / 8;
+    if (hyst < 2) return;   // flat line, no frequency
+
+    bool above = samples[start % count] > mid;
+    int first = -1, last = -1, edges = 0;
+    for (int i = 0; i < count; i++) {
+        int s = samples[(start + i) % count];
+        if (!above && s > mid + hyst) {
+            above = true;
+            if (first < 0) first = i;
+            last = i;
+            edges++;
+        } else if (above && s < mid - hyst) {
+            above = false;
+        }
+    }
+    if (edges >= 3) m->freq_hz = (float)(edges - 1) * sample_rate / (last - first);
+}
@@ -0,0 +1,18 @@
+#ifndef MEASURE_H
+#define MEASURE_H
+
+#include "pico/stdlib.h"
+
+// Automatic measurements on one captured frame. Voltages come out of the
+// scale tables, so they're in probe mV at the current gain.
+typedef struct measurements {
+    int16_t vmin_mv;
+    int16_t vmax_mv;
+    int16_t vpp_mv;
+    int16_t vavg_mv;
+    float freq_hz;      // 0 if fewer than two full periods were seen
+} measurements_t;
+
+void measure_frame(const uint8_t *samples, int count, int start, uint32_t sample_rate, measurements_t *m);
+
+#endif
@@ -0,0 +1,193 @@
+// Multi-channel acquisition
+// Slot k of the ring is channel k % channels: the ADC restarts on its
+// lowest input whenever the ring does, and the ring is whole groups long.
+// Core 1 owns the state machine; core 0 only reads a frame once it's ready
+// and hands it back with multi_release().
+
+#include "multi.h"
+#include "pico/stdlib.h"
+#include "adc.h"
+#include "deep.h"
+
+#if MULTI_RING % 6
+#error "the ring has to hold whole groups of two or three"
+#endif
+#if MULTI_RING > DEEP_MAX_SAMPLES
+#error "the ring lives in deep memory"
+#endif
+
+enum { M_IDLE, M_ARM, M_SEARCH, M_POST, M_DONE };
+
+static uint8_t frames[MULTI_MAX_CHANNELS][MULTI_FRAME];
+
+static volatile int state = M_IDLE;
+static volatile int channels = 1;
+static volatile int trig_channel = 0;
+static volatile uint8_t trig_level = 128;
+static volatile uint32_t wanted = MULTI_FRAME;
+static volatile bool ready = false;
+static volatile bool triggered = false;
+
+// Core 1 only
+static uint32_t length;         // of the frame being caught, latched at arm
+static uint groups;             // in the ring
+static adc_follower_t follower;
+static uint32_t since_arm;      // groups looked at since arming
+static bool below;              // been under the level, a rise can trigger
+static uint trig_group;
+static uint32_t armed_us;
+static int search_channel;      // trigger settings for this pass
+static int search_level;
+
+// Retarget first so nothing is in flight when the inputs change; that's
+// what keeps slot 0 on the lowest input
+void multi_start(int n){
+    state = M_IDLE;
+    ready = false;
+    if (n < 2) n = 2;
+    if (n > MULTI_MAX_CHANNELS) n = MULTI_MAX_CHANNELS;
+    channels = n;
+    adc_capture_retarget(deep_buf, MULTI_RING);
+    adc_capture_set_inputs((1u << n) - 1);
+    if (trig_channel >= n) trig_channel = 0;
+    state = M_ARM;
+}
+
+void multi_stop(){
+    state = M_IDLE;
+    ready = false;
+    adc_capture_set_inputs(1u << CAPTURE_CHANNEL);
+    adc_capture_retarget(capture_buf, CAPTURE_DEPTH);
+}
+
+// Takes effect from the next frame
+void multi_set_trigger(int channel, uint8_t level){
+    trig_channel = (channel < channels) ? channel : 0;
+    trig_level = level;
+}
+
+void multi_set_length(uint32_t samples){
+    if (samples < 2) samples = 2;
+    if (samples > MULTI_FRAME) samples = MULTI_FRAME;
+    wanted = samples;
+}
+
+// One pass over the ring, every channel split out as it goes
+static void __time_critical_func(split)(uint first){
+    const int n = channels;
+    const uint8_t *p = &deep_buf[first * n];
+    const uint8_t *end = &deep_buf[groups * n];
+    for (uint32_t k = 0; k < length; k++) {
+        for (int ch = 0; ch < n; ch++) frames[ch][k] = p[ch];
+        p += n;
+        if (p == end) p = deep_buf;
+    }
+}
+
+// Rising crossing on the trigger channel, one group at a time
+static void __time_critical_func(search)(const uint8_t *p, uint count){
+    const int n = channels;
+    uint32_t pre = length / 2;
+    if (state != M_SEARCH) return;
+    for (const uint8_t *end = p + count; p < end; p += n) {
+        int s = p[search_channel];
+        bool settled = since_arm++ >= pre;
+        if (s < search_level - MULTI_HYST) below = true;
+        else if (s >= search_level) {
+            // A rise too soon after arming still uses up the crossing
+            if (below && settled) {
+                trig_group = (p - deep_buf) / n;
+                triggered = true;
+                state = M_POST;
+                return;
+            }
+            below = false;
+        }
+    }
+}
+
+// Look for the trigger in whatever the DMA has finished, then wait for the
+// post-trigger half. Returns true while it wants calling straight back.
+bool multi_service(){
+    int st = state;
+    if (st == M_IDLE || st == M_DONE) return false;
+
+    uint32_t now = time_us_32();
+    const int n = channels;
+    uint32_t pre = length / 2;
+
+    if (st == M_ARM) {
+        groups = MULTI_RING / n;
+        length = wanted;
+        adc_follow_start(&follower, n);
+        since_arm = 0;
+        below = false;
+        armed_us = now;
+        state = M_SEARCH;
+        return true;
+    }
+
+    // Too long since the last pass, the pre-trigger samples may be gone
+    if (adc_follow_lapped(&follower, (groups - length - MULTI_LAP_MARGIN) * n)) {
+        state = M_ARM;
+        return true;
+    }
+
+    if (st == M_SEARCH) {
+        search_channel = trig_channel;
+        search_level = trig_level;
+        adc_follow(&follower, search);
+    }
+
+    // After the search, so a trigger it found is never ahead of this
+    uint write = adc_capture_write_index() / n;
+    if (st == M_SEARCH) {
+        // Nothing crossed: take the latest frame as it stands
+        if (state == M_SEARCH && now - armed_us > MULTI_AUTO_US && since_arm >= length) {
+            trig_group = (write + groups - (length - pre)) % groups;
+            triggered = false;
+            state = M_POST;
+        }
+        if (state == M_SEARCH) return true;
+    }
+
+    uint done = (write + groups - trig_group) % groups;
+    if (done < length - pre) return true;
+    split((trig_group + groups - pre) % groups);
+    state = M_DONE;
+    ready = true;
+    return false;
+}
+
+bool multi_ready(){
+    return ready;
+}
+
+// Whether the frame ready now was triggered, or auto
+bool multi_triggered(){
+    return triggered;
+}
+
+// Core 0 is done with the frame, catch the next one
+void multi_release(){
+    if (state != M_DONE) return;
+    ready = false;
+    state = M_ARM;
+}
+
+int multi_channels(){
+    return channels;
+}
+
+// Per channel
+uint32_t multi_rate(){
+    return ADC_SAMPLE_RATE_HZ / channels;
+}
+
+uint32_t multi_length(){
+    return length;
+}
+
+const uint8_t *multi_frame(int channel){
+    return frames[channel];
+}
@@ -0,0 +1,50 @@
+#ifndef MULTI_H
+#define MULTI_H
+
+#include "pico/stdlib.h"
+
+// Multi-channel acquisition
+//
+// The ADC takes turns between two or three inputs (GPIO26 the probe,
+// GPIO27 and GPIO28 straight onto the pins), so the 500 kS/s is shared out
+// evenly: 250 kS/s each for two, 167 kS/s for three. The DMA fills a ring
+// in deep memory with the channels interleaved.
+//
+// The trigger comparator only sees the probe, so the trigger is done in
+// software on core 1: it follows the ring behind the DMA looking for a
+// rising crossing on the chosen channel. Once the post-trigger half is in
+// it splits the frame into one buffer per channel in a single pass and
+// holds it until core 0 has drawn it.
+
+#define MULTI_MAX_CHANNELS  3
+#define MULTI_RING          6144        // ring samples, whole groups for 2 or 3 channels
+#define MULTI_FRAME         1024        // samples per channel per frame, at most
+#define MULTI_HYST          4           // codes below the level to re-arm
+#define MULTI_AUTO_US       100000      // no trigger for this long, show what's there
+#define MULTI_LAP_MARGIN    64          // groups the DMA may get within before we call it lapped
+
+void multi_start(int channels);
+
+void multi_stop();
+
+void multi_set_trigger(int channel, uint8_t level);
+
+void multi_set_length(uint32_t samples);
+
+bool multi_service();
+
+bool multi_ready();
+
+bool multi_triggered();
+
+void multi_release();
+
+int multi_channels();
+
+uint32_t multi_rate();
+
+uint32_t multi_length();
+
+const uint8_t *multi_frame(int channel);
+
+#endif
@@ -0,0 +1,81 @@
+// Persistence histogram
+// 280 x 200 pixels at 4 bits is 28 KB, against 56 KB for a byte per pixel.
+// Decay works on whole words: 8 pixels per subtract, no unpacking.
+
+#include "persist.h"
+#include "pico/stdlib.h"
+#include <string.h>
+
+#define NIBBLE_LSBS 0x11111111u
+
+static uint32_t hist[PERSIST_COLS * PERSIST_WORDS_PER_COL];
+static uint32_t dirty[(PERSIST_COLS + 31) / 32];
+
+static inline void mark(int column){
+    dirty[column >> 5] |= 1u << (column & 31);
+}
+
+void persist_clear(){
+    memset(hist, 0, sizeof(hist));
+    persist_mark_all();
+}
+
+void persist_mark_all(){
+    memset(dirty, 0xFF, sizeof(dirty));
+}
+
+// One trace segment: every row from row0 to row1 (either order) gets a hit
+void persist_add_span(int column, int row0, int row1){
+    if (column < 0 || column >= PERSIST_COLS) return;
+    if (row0 > row1) { int t = row0; row0 = row1; row1 = t; }
+    if (row0 < 0) row0 = 0;
+    if (row1 >= PERSIST_ROWS) row1 = PERSIST_ROWS - 1;
+    if (row0 > row1) return;
+
+    uint32_t *col = &hist[column * PERSIST_WORDS_PER_COL];
+    bool changed = false;
+    for (int r = row0; r <= row1; r++) {
+        uint32_t *w = &col[r >> 3];
+        int shift = (r & 7) * 4;
+        uint32_t level = (*w >> shift) & 0xF;
+        uint32_t next = level + PERSIST_HIT;
+        if (next > PERSIST_LEVELS - 1) next = PERSIST_LEVELS - 1;
+        *w += (next - level) << shift;
+        changed |= (next != level);
+    }
+    // Already at full brightness: nothing new to send
+    if (changed) mark(column);
+}
+
+// Step every lit pixel down one level
+void persist_decay(){
+    for (int c = 0; c < PERSIST_COLS; c++) {
+        uint32_t *col = &hist[c * PERSIST_WORDS_PER_COL];
+        uint32_t any = 0;
+        for (int i = 0; i < PERSIST_WORDS_PER_COL; i++) {
+            uint32_t w = col[i];
+            // Low bit of each nibble set if that nibble is nonzero
+            uint32_t nz = (w | (w >> 1) | (w >> 2) | (w >> 3)) & NIBBLE_LSBS;
+            col[i] = w - nz;
+            any |= nz;
+        }
+        if (any) mark(c);
+    }
+}
+
+uint8_t persist_level(int column, int row){
+    return (hist[column * PERSIST_WORDS_PER_COL + (row >> 3)] >> ((row & 7) * 4)) & 0xF;
+}
+
+// Next flagged column in [from, to), clearing its flag, or -1
+int persist_take_dirty(int from, int to){
+    if (to > PERSIST_COLS) to = PERSIST_COLS;
+    for (int c = from; c < to; c++) {
+        uint32_t bit = 1u << (c & 31);
+        if (dirty[c >> 5] & bit) {
+            dirty[c >> 5] &= ~bit;
+            return c;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,32 @@
+#ifndef PERSIST_H
+#define PERSIST_H
+
+#include "pico/stdlib.h"
+
+// Digital persistence
+//
+// A hit-count histogram over the plot, one 4-bit level per pixel packed
+// column-major (a column is PERSIST_WORDS_PER_COL words). Every captured
+// frame adds its trace, a timer steps every pixel down one level, and the
+// display maps levels through a palette. Columns that changed are flagged
+// so only those get sent to the panel.
+
+#define PERSIST_COLS            280
+#define PERSIST_ROWS            200         // 8 per word
+#define PERSIST_WORDS_PER_COL   (PERSIST_ROWS / 8)
+#define PERSIST_LEVELS          16
+#define PERSIST_HIT             4           // levels added per hit, so one-off glitches stay up a while
+
+void persist_clear();
+
+void persist_add_span(int column, int row0, int row1);
+
+void persist_decay();
+
+uint8_t persist_level(int column, int row);
+
+int persist_take_dirty(int from, int to);
+
+void persist_mark_all();
+
+#endif
@@ -0,0 +1,246 @@
+// Flash capture recorder
+// Log positions are byte counts since the start of sector seq 0, so they
+// only ever go up; rec_flash_offset() folds them onto the circular area.
+
+#include "recorder.h"
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+#include "flash_layout.h"
+#include "flash_util.h"
+#include "codec.h"
+#include "adc.h"
+#include <string.h>
+
+#define REC_SECTORS     (FLASH_RECORD_SIZE / FLASH_SECTOR_SIZE)
+
+static uint8_t staging[REC_STAGING_SIZE] __aligned(4);
+
+// Producer (core 0) owns write_pos, consumer (core 1) owns flush_pos.
+// Everything in [flush_pos, write_pos) is staged but not in flash yet.
+static volatile uint32_t write_pos = 0;
+static volatile uint32_t flush_pos = 0;
+static volatile bool stop_pending = false;
+
+static uint32_t session = 0;
+static bool recording = false;
+static uint32_t dropped = 0;
+
+// What the log held at boot, kept up to date while recording
+static bool log_empty = true;
+static uint32_t oldest_seq = 0;
+static uint32_t newest_seq = 0;
+static uint32_t last_session = 0;
+
+static uint32_t rec_flash_offset(uint32_t pos){
+    uint32_t sector = (pos / FLASH_SECTOR_SIZE) % REC_SECTORS;
+    return FLASH_RECORD_OFFSET + sector * FLASH_SECTOR_SIZE + (pos % FLASH_SECTOR_SIZE);
+}
+
+static const rec_sector_header_t *sector_header(uint32_t seq){
+    return (const rec_sector_header_t *)flash_util_ptr(rec_flash_offset(seq * FLASH_SECTOR_SIZE));
+}
+
+// Copy into the ring at a log position, wrapping as needed
+static void stage(uint32_t pos, const void *data, int len){
+    const uint8_t *src = (const uint8_t *)data;
+    while (len > 0) {
+        uint32_t idx = pos & (REC_STAGING_SIZE - 1);
+        int chunk = REC_STAGING_SIZE - idx;
+        if (chunk > len) chunk = len;
+        memcpy(&staging[idx], src, chunk);
+        pos += chunk; src += chunk; len -= chunk;
+    }
+}
+
+static void stage_fill(uint32_t pos, uint32_t end){
+    while (pos < end) {
+        staging[pos & (REC_STAGING_SIZE - 1)] = 0xFF;
+        pos++;
+    }
+}
+
+// Find the newest sector so writing picks up where it left off
+void rec_init(){
+    log_empty = true;
+    for (uint32_t i = 0; i < REC_SECTORS; i++) {
+        const rec_sector_header_t *sh = (const rec_sector_header_t *)flash_util_ptr(FLASH_RECORD_OFFSET + i * FLASH_SECTOR_SIZE);
+        if (sh->magic != REC_SECTOR_MAGIC || sh->seq % REC_SECTORS != i) continue;
+        if (log_empty || sh->seq > newest_seq) newest_seq = sh->seq;
+        if (log_empty || sh->seq < oldest_seq) oldest_seq = sh->seq;
+        log_empty = false;
+    }
+
+    if (!log_empty) {
+        // The newest sector's last frame has the latest session
+        const uint8_t *base = (const uint8_t *)sector_header(newest_seq);
+        uint32_t offset = sizeof(rec_sector_header_t);
+        while (offset + sizeof(rec_frame_header_t) <= FLASH_SECTOR_SIZE) {
+            const rec_frame_header_t *fh = (const rec_frame_header_t *)(base + offset);
+            if (fh->magic == REC_FRAME_MAGIC) {
+                last_session = fh->session;
+                offset += sizeof(rec_frame_header_t) + fh->payload_len;
+            } else {
+                offset = (offset + FLASH_PAGE_SIZE) & ~(FLASH_PAGE_SIZE - 1);
+            }
+        }
+        write_pos = flush_pos = (newest_seq + 1) * FLASH_SECTOR_SIZE;
+    }
+}
+
+void rec_start(){
+    if (recording) return;
+    session = last_session + 1;
+    recording = true;
+}
+
+// Pad out to a page so everything staged gets written
+void rec_stop(){
+    if (!recording) return;
+    recording = false;
+    uint32_t pos = write_pos;
+    uint32_t padded = (pos + FLASH_PAGE_SIZE - 1) & ~(FLASH_PAGE_SIZE - 1);
+    stage_fill(pos, padded);
+    write_pos = padded;
+}
+
+// Core 0: add a frame. Returns false if it was dropped.
+bool rec_append(const uint8_t *samples, uint16_t count, uint16_t trigger_index, uint8_t gain, uint32_t vdiv_mv, uint16_t tdiv_ms){
+    if (!recording) return false;
+
+    static uint8_t payload[CAPTURE_DEPTH];
+    if (count > CAPTURE_DEPTH) count = CAPTURE_DEPTH;
+    int len = codec_encode(samples, count, payload, count - 1);
+    rec_frame_header_t fh;
+    fh.encoding = REC_ENC_RICE;
+    if (len == 0) {
+        memcpy(payload, samples, count);
+        len = count;
+        fh.encoding = REC_ENC_RAW;
+    }
+
+    // A frame that won't fit in this sector starts the next one
+    uint32_t pos = write_pos;
+    uint32_t frame_len = sizeof(rec_frame_header_t) + len;
+    uint32_t sector_end = (pos / FLASH_SECTOR_SIZE + 1) * FLASH_SECTOR_SIZE;
+    uint32_t start = pos;
+    bool new_sector = (pos % FLASH_SECTOR_SIZE) == 0;
+    if (!new_sector && pos + frame_len > sector_end) {
+        start = sector_end;
+        new_sector = true;
+    }
+    uint32_t frame_pos = start + (new_sector ? sizeof(rec_sector_header_t) : 0);
+    uint32_t end = frame_pos + frame_len;
+
+    // Always leave a page spare for rec_stop()'s padding
+    if (end + FLASH_PAGE_SIZE - flush_pos > REC_STAGING_SIZE) {
+        dropped++;
+        return false;
+    }
+
+    stage_fill(pos, start);
+    if (new_sector) {
+        rec_sector_header_t sh = { REC_SECTOR_MAGIC, start / FLASH_SECTOR_SIZE };
+        stage(start, &sh, sizeof(sh));
+        newest_seq = sh.seq;
+        if (log_empty) { oldest_seq = sh.seq; log_empty = false; }
+        if (newest_seq - oldest_seq >= REC_SECTORS) oldest_seq = newest_seq - REC_SECTORS + 1;
+    }
+
+    fh.magic = REC_FRAME_MAGIC;
+    fh.payload_len = len;
+    fh.session = session;
+    fh.time_ms = to_ms_since_boot(get_absolute_time());
+    fh.sample_count = count;
+    fh.trigger_index = trigger_index;
+    fh.vdiv_mv = vdiv_mv;
+    fh.tdiv_ms = tdiv_ms;
+    fh.gain = gain;
+    fh.crc = 0;
+    uint16_t crc = flash_util_crc16(0xFFFF, (const uint8_t *)&fh, sizeof(fh));
+    fh.crc = flash_util_crc16(crc, payload, len);
+
+    stage(frame_pos, &fh, sizeof(fh));
+    stage(frame_pos + sizeof(fh), payload, len);
+    last_session = session;
+
+    __dmb();
+    write_pos = end;
+    return true;
+}
+
+// Core 1: one flash operation at most. Returns true if it did something.
+bool rec_service(){
+    uint32_t pos = flush_pos;
+    if (write_pos - pos < FLASH_PAGE_SIZE) return false;
+    __dmb();
+
+    static uint32_t erased_seq = 0xFFFFFFFF;
+    uint32_t seq = pos / FLASH_SECTOR_SIZE;
+    if (erased_seq != seq) {
+        // Sectors are only ever entered at their start, so this is the
+        // first page going in. That also makes it the oldest one in the log.
+        // If the other core couldn't be parked, try again next time
+        if (flash_util_erase(rec_flash_offset(pos) & ~(FLASH_SECTOR_SIZE - 1), FLASH_SECTOR_SIZE)) erased_seq = seq;
+        return true;
+    }
+
+    if (!flash_util_program(rec_flash_offset(pos), &staging[pos & (REC_STAGING_SIZE - 1)], FLASH_PAGE_SIZE)) return true;
+    __dmb();
+    flush_pos = pos + FLASH_PAGE_SIZE;
+    return true;
+}
+
+// Everything staged is in flash
+bool rec_flushed(){
+    return write_pos == flush_pos;
+}
+
+uint32_t rec_dropped(){
+    return dropped;
+}
+
+// Start reading back the most recent session
+bool rec_replay_open(rec_cursor_t *cur){
+    if (log_empty) return false;
+    cur->seq = oldest_seq;
+    cur->end_seq = newest_seq;
+    cur->offset = sizeof(rec_sector_header_t);
+    cur->session = last_session;
+    return true;
+}
+
+// Next frame of the session into samples. Returns false at the end.
+bool rec_replay_next(rec_cursor_t *cur, uint8_t *samples, int max_samples, rec_frame_header_t *hdr){
+    while (cur->seq <= cur->end_seq) {
+        const rec_sector_header_t *sh = sector_header(cur->seq);
+        const uint8_t *base = (const uint8_t *)sh;
+        if (sh->magic != REC_SECTOR_MAGIC || sh->seq != cur->seq) cur->offset = FLASH_SECTOR_SIZE;
+
+        while (cur->offset + sizeof(rec_frame_header_t) <= FLASH_SECTOR_SIZE) {
+            const rec_frame_header_t *fh = (const rec_frame_header_t *)(base + cur->offset);
+            if (fh->magic != REC_FRAME_MAGIC) {
+                cur->offset = (cur->offset + FLASH_PAGE_SIZE) & ~(FLASH_PAGE_SIZE - 1);
+                continue;
+            }
+            const uint8_t *payload = base + cur->offset + sizeof(rec_frame_header_t);
+            cur->offset += sizeof(rec_frame_header_t) + fh->payload_len;
+            if (cur->offset > FLASH_SECTOR_SIZE) break;
+            if (fh->session != cur->session || fh->sample_count > max_samples) continue;
+
+            rec_frame_header_t h = *fh;
+            h.crc = 0;
+            uint16_t crc = flash_util_crc16(0xFFFF, (const uint8_t *)&h, sizeof(h));
+            if (flash_util_crc16(crc, payload, fh->payload_len) != fh->crc) continue;
+
+            bool ok;
+            if (fh->encoding == REC_ENC_RICE) ok = codec_decode(payload, fh->payload_len, samples, fh->sample_count);
+            else { memcpy(samples, payload, fh->sample_count); ok = true; }
+            if (!ok) continue;
+            *hdr = *fh;
+            return true;
+        }
+        cur->seq++;
+        cur->offset = sizeof(rec_sector_header_t);
+    }
+    return false;
+}
@@ -0,0 +1,73 @@
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include "pico/stdlib.h"
+
+// Capture recording to flash
+//
+// The recording area is a circular log of 4KB sectors. Each sector starts
+// with a rec_sector_header_t carrying an ever-increasing sequence number, so
+// the newest one can be found at boot and writing carries on after it
+// (every sector gets erased in turn, which spreads the wear). Frames follow
+// back to back and never straddle a sector. Anything reading 0xFF where a
+// frame header should be is padding up to the next page.
+//
+// Frames are built in a RAM staging ring on core 0 and written out a page
+// (or one sector erase) at a time by rec_service() on core 1. If the ring
+// is full the frame is dropped; recording never waits on flash.
+
+#define REC_STAGING_SIZE    8192    // power of 2, multiple of the page size
+#define REC_SECTOR_MAGIC    0x474C4253  // "SBLG"
+#define REC_FRAME_MAGIC     0x3246      // "F2", 32-bit V/div since "FR"
+
+typedef enum rec_encoding {
+    REC_ENC_RAW,
+    REC_ENC_RICE    // codec.h
+} rec_encoding_t;
+
+typedef struct __attribute__((packed)) rec_sector_header {
+    uint32_t magic;
+    uint32_t seq;
+} rec_sector_header_t;
+
+typedef struct __attribute__((packed)) rec_frame_header {
+    uint16_t magic;
+    uint16_t payload_len;
+    uint32_t session;       // which recording this frame belongs to
+    uint32_t time_ms;       // since boot
+    uint16_t sample_count;
+    uint16_t trigger_index;
+    uint32_t vdiv_mv;       // settings at capture time, up to 100V/div
+    uint16_t tdiv_ms;
+    uint8_t gain;
+    uint8_t encoding;       // rec_encoding_t
+    uint16_t crc;           // CRC-16/CCITT-FALSE over header (crc = 0) + payload
+} rec_frame_header_t;
+
+// Replay position, see rec_replay_open()
+typedef struct rec_cursor {
+    uint32_t seq;           // sector being read
+    uint32_t end_seq;       // newest sector
+    uint32_t offset;        // within the sector
+    uint32_t session;
+} rec_cursor_t;
+
+void rec_init();
+
+void rec_start();
+
+void rec_stop();
+
+bool rec_append(const uint8_t *samples, uint16_t count, uint16_t trigger_index, uint8_t gain, uint32_t vdiv_mv, uint16_t tdiv_ms);
+
+bool rec_service();
+
+bool rec_flushed();
+
+uint32_t rec_dropped();
+
+bool rec_replay_open(rec_cursor_t *cur);
+
+bool rec_replay_next(rec_cursor_t *cur, uint8_t *samples, int max_samples, rec_frame_header_t *hdr);
+
+#endif
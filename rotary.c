@@ -1,59 +1,87 @@
+// Rotary encoder driver
+// Quadrature decoding runs entirely in a PIO state machine (quadrature.pio),
+// which keeps a full 4x count without any CPU interrupts. The firmware
+// just reads the latest count from the RX FIFO whenever it wants it.
+
 #include "rotary.h"
 #include <stdio.h>
-#include "pico/stdlib.h"
 #include <string.h>
+#include <stdlib.h>
+#include "pico/stdlib.h"
+#include "hardware/pio.h"
+#include "quadrature.pio.h"
 
 #include "TFTMaster.h"
 
-#define ENCCLK 14
-#define ENCDT 15
-
-volatile int dtcount = 0;
-volatile int clkcount = 0;
-volatile bool clk_event = false;
-volatile bool dt_event = false;
-
-void gpio_callback(uint gpio, uint32_t events){
-    if (gpio == ENCCLK) {
-        // ISR: do minimal work only
-        clkcount++;
-        clk_event = true;
-    } else if (gpio == ENCDT) {
-        dtcount++;
-        dt_event = true;
-    }
-}
+// PIO 0 is taken by the TFT, and the decoder has to sit at address 0
+#define ROTARY_PIO pio1
+
+// Highest step rate the state machine is clocked for. A hand-turned
+// encoder never gets near this, and the slower clock filters contact bounce.
+#define ROTARY_MAX_STEP_RATE 20000
+
+// Time per detent below which the acceleration kicks in
+#define ACCEL_FAST_US    15000
+#define ACCEL_MEDIUM_US  30000
+#define ACCEL_SLOW_US    60000
+
+static uint rotary_sm;
+static int32_t last_count = 0;
+static uint64_t last_move_time = 0;
 
 void rotary_init(){
-    gpio_init(ENCCLK);
-    gpio_pull_up(ENCCLK);                 // ensure defined level
-    gpio_set_irq_enabled_with_callback(ENCCLK, GPIO_IRQ_EDGE_RISE, true, &gpio_callback);
+    pio_add_program(ROTARY_PIO, &quadrature_encoder_program);
+    rotary_sm = pio_claim_unused_sm(ROTARY_PIO, true);
+    quadrature_encoder_program_init(ROTARY_PIO, rotary_sm, ROTARY_PIN_CLK, ROTARY_MAX_STEP_RATE);
 
-    gpio_init(ENCDT);
-    gpio_pull_up(ENCDT);
-    gpio_set_irq_enabled_with_callback(ENCDT, GPIO_IRQ_EDGE_RISE, true, &gpio_callback);
+    gpio_init(ROTARY_PIN_SW);
+    gpio_set_dir(ROTARY_PIN_SW, GPIO_IN);
+    gpio_pull_up(ROTARY_PIN_SW);
+
+    last_count = rotary_get_count();
+    last_move_time = time_us_64();
 }
 
-void rotary_service(void){
-    if (clk_event){
-        clk_event = false;
-        //printf("\nclk triggered %d", clkcount);
-    }
-    if (dt_event){
-        dt_event = false;
-        //printf("\ndt triggered %d", dtcount);
+// Raw 4x count. Negated so clockwise counts up, matching the old ISR.
+int32_t rotary_get_count(){
+    return -quadrature_encoder_get_count(ROTARY_PIO, rotary_sm);
+}
+
+// Whole detents turned since the last call. If accel_delta is given it gets
+// the same movement scaled by how fast the knob was spun, for settings
+// where one quick spin should cover a big range.
+int rotary_get_delta(int *accel_delta){
+    int32_t count = rotary_get_count();
+    int detents = (count - last_count) / ROTARY_COUNTS_PER_DETENT;
+    // Leave any partial detent in the counter for next time
+    last_count += detents * ROTARY_COUNTS_PER_DETENT;
+
+    int scale = 1;
+    if (detents != 0) {
+        uint64_t now = time_us_64();
+        uint64_t per_detent = (now - last_move_time) / abs(detents);
+        if (per_detent < ACCEL_FAST_US) scale = 8;
+        else if (per_detent < ACCEL_MEDIUM_US) scale = 4;
+        else if (per_detent < ACCEL_SLOW_US) scale = 2;
+        last_move_time = now;
     }
+
+    if (accel_delta) *accel_delta = detents * scale;
+    return detents;
+}
+
+bool rotary_switch_pressed(){
+    return !gpio_get(ROTARY_PIN_SW);
 }
 
 void display_counts(){
-    // copy volatile counters to locals to avoid races with ISR
-    int clk = clkcount;
-    int dt = dtcount;
+    // Debug screen, shows the raw quadrature count and whole detents
+    int32_t count = rotary_get_count();
 
     char line1[32];
     char line2[32];
-    snprintf(line1, sizeof(line1), "CLK: %d", clk);
-    snprintf(line2, sizeof(line2), "DT:  %d", dt);
+    snprintf(line1, sizeof(line1), "CNT: %ld", (long)count);
+    snprintf(line2, sizeof(line2), "DET: %ld", (long)(count / ROTARY_COUNTS_PER_DETENT));
 
     const int tsz = 3;                 // text size (tweak to taste)
     const int char_w = 6 * tsz;        // approx pixels per character (5px font + 1px space)
@@ -77,24 +105,3 @@ void display_counts(){
     tft_setCursor(x, y + char_h + spacing);
     tft_writeString(line2);
 }
-
-// void clk_callback(){
-//     printf("\nclk triggered %d", clkcount);
-//     clkcount++;
-// }
-
-// void dt_callback(){
-//     printf("\ndt triggered %d", dtcount);
-//     dtcount++;
-// }
-
-// void rotary_init(){
-//     gpio_init(ENCCLK);
-//     //gpio_pull_up(ENCCLK);
-//     gpio_set_irq_enabled_with_callback(ENCCLK, GPIO_IRQ_EDGE_RISE, true, &clk_callback);
-
-//     gpio_init(ENCDT);
-//     //gpio_pull_up(ENCDT);
-//     gpio_set_irq_enabled_with_callback(ENCDT, GPIO_IRQ_EDGE_RISE, true, &dt_callback);
-// }
-
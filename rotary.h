@@ -1,11 +1,24 @@
 #ifndef ROTARY_H
 #define ROTARY_H
 
+#include "pico/stdlib.h"
+
+// The PIO decoder reads CLK and CLK + 1, so DT has to be the next pin up
+#define ROTARY_PIN_CLK  14
+#define ROTARY_PIN_DT   15
+#define ROTARY_PIN_SW   6
+
+// Quadrature counts per mechanical detent
+#define ROTARY_COUNTS_PER_DETENT 4
 
 void rotary_init();
 
-void rotary_service();
+int32_t rotary_get_count();
+
+int rotary_get_delta(int *accel_delta);
+
+bool rotary_switch_pressed();
 
 void display_counts();
 
-#endif
\ No newline at end of file
+#endif
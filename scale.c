@@ -0,0 +1,83 @@
+// Sample-to-pixel lookup tables
+// The trace used to do a divide for the volts and another for the pixel row
+// on every column, all in soft float. Now the float work happens once per
+// setting change (256 entries) and the trace is a table lookup per sample.
+
+#include "scale.h"
+#include "pico/stdlib.h"
+
+uint8_t scale_y_lut[256];
+int16_t scale_mv_lut[256];
+int16_t scale_center_mv = 0;
+
+static uint8_t y_min = 0;
+static uint8_t y_max = 239;
+
+// Settings the tables were built for
+static float cur_volts_per_div = 0;
+static uint32_t cur_uv_per_code = 0;
+static int16_t cur_zero_q8 = 0;
+static float cur_offset = 0;
+static bool tables_valid = false;
+
+// Cached for scale_volts_to_y
+static float center_volts = 0;
+static float pixels_per_volt = 0;
+
+void scale_set_limits(uint8_t min, uint8_t max){
+    y_min = min;
+    y_max = max;
+    tables_valid = false;
+}
+
+// Clamped in float first, far off-screen voltages must not wrap round
+short scale_volts_to_y(float volts){
+    float y = SCALE_CENTER_Y - (volts - center_volts) * pixels_per_volt;
+    if (y < -32768.0f) y = -32768.0f;
+    if (y > 32767.0f) y = 32767.0f;
+    return (short)y;
+}
+
+// Rebuild the tables if any of the settings changed. Returns true if it did.
+// The front end is a line: probe uV = (code - zero) * uv_per_code, with
+// zero in Q8 codes (see calib.h).
+bool scale_update(float volts_per_div, uint32_t uv_per_code, int16_t zero_q8, float offset_volts){
+    if (volts_per_div < SCALE_MIN_VOLTS_PER_DIV) volts_per_div = SCALE_MIN_VOLTS_PER_DIV;
+    if (tables_valid && volts_per_div == cur_volts_per_div && uv_per_code == cur_uv_per_code &&
+        zero_q8 == cur_zero_q8 && offset_volts == cur_offset) return false;
+
+    cur_volts_per_div = volts_per_div;
+    cur_uv_per_code = uv_per_code;
+    cur_zero_q8 = zero_q8;
+    cur_offset = offset_volts;
+
+    // Center line is ADC mid-scale
+    int64_t center_uv = ((int64_t)(SCALE_MIDSCALE_Q8 - zero_q8) * uv_per_code) >> 8;
+    center_volts = center_uv * 1e-6f + offset_volts;
+    pixels_per_volt = SCALE_PIXELS_PER_DIV / volts_per_div;
+    scale_center_mv = (int16_t)(center_volts * 1000.0f);
+
+    for (int raw = 0; raw < 256; raw++) {
+        int64_t uv = ((int64_t)((raw << 8) - zero_q8) * uv_per_code) >> 8;
+        scale_mv_lut[raw] = (int16_t)(uv / 1000);
+    }
+    scale_build_lut(scale_y_lut, volts_per_div, uv_per_code, zero_q8, offset_volts);
+    tables_valid = true;
+    return true;
+}
+
+// Screen row table for any input on its own scale, the same line as the
+// probe's. Extra channels keep theirs outside, so nothing here is cached.
+void scale_build_lut(uint8_t *lut, float volts_per_div, uint32_t uv_per_code, int16_t zero_q8, float offset_volts){
+    if (volts_per_div < SCALE_MIN_VOLTS_PER_DIV) volts_per_div = SCALE_MIN_VOLTS_PER_DIV;
+    int64_t center_uv = ((int64_t)(SCALE_MIDSCALE_Q8 - zero_q8) * uv_per_code) >> 8;
+    float center = center_uv * 1e-6f + offset_volts;
+    float ppv = SCALE_PIXELS_PER_DIV / volts_per_div;
+    for (int raw = 0; raw < 256; raw++) {
+        int64_t uv = ((int64_t)((raw << 8) - zero_q8) * uv_per_code) >> 8;
+        float y = SCALE_CENTER_Y - (uv * 1e-6f - center) * ppv;
+        if (y < y_min) y = y_min;
+        if (y > y_max) y = y_max;
+        lut[raw] = (uint8_t)y;
+    }
+}
@@ -0,0 +1,36 @@
+#ifndef SCALE_H
+#define SCALE_H
+
+#include "pico/stdlib.h"
+
+// Sample code -> screen/voltage tables. Everything that turns an 8-bit ADC
+// code into something on screen goes through these instead of float math
+// per sample. They're rebuilt only when V/div, gain or offset change.
+
+#define SCALE_CENTER_Y        120
+#define SCALE_PIXELS_PER_DIV  48
+#define SCALE_ADC_FULL_SCALE  3.3f
+#define SCALE_MIN_VOLTS_PER_DIV 0.01f           // finer than this is clamped
+#define SCALE_MIDSCALE_Q8     ((255 << 8) / 2)  // code 127.5
+#define SCALE_PIN_UV_PER_CODE 12941             // an input wired straight to the pin, 3.3V / 255
+
+// Screen row for each ADC code, already clamped to the plot margins
+extern uint8_t scale_y_lut[256];
+// Voltage at the probe for each ADC code, in mV
+extern int16_t scale_mv_lut[256];
+// Probe voltage that lands on the center line, in mV
+extern int16_t scale_center_mv;
+
+void scale_set_limits(uint8_t y_min, uint8_t y_max);
+
+bool scale_update(float volts_per_div, uint32_t uv_per_code, int16_t zero_q8, float offset_volts);
+
+void scale_build_lut(uint8_t *lut, float volts_per_div, uint32_t uv_per_code, int16_t zero_q8, float offset_volts);
+
+short scale_volts_to_y(float volts);
+
+static inline uint8_t scale_raw_to_y(uint8_t raw){
+    return scale_y_lut[raw];
+}
+
+#endif
@@ -0,0 +1,188 @@
+// SCPI command parser
+// Built-ins: *IDN?, *CLS, SYSTem:ERRor?. Everything else comes from the
+// table handed to scpi_init().
+
+#include "scpi.h"
+#include "pico/stdlib.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+
+static const char *ident = "";
+static const scpi_command_t *table = NULL;
+static int table_count = 0;
+
+// Line being received
+static char line[SCPI_LINE_MAX];
+static int line_len = 0;
+static bool line_overflow = false;
+
+static int16_t errors[SCPI_ERROR_QUEUE];
+static int error_count = 0;
+
+void scpi_error(int code){
+    if (error_count < SCPI_ERROR_QUEUE) {
+        errors[error_count++] = code;
+    } else {
+        // Last entry becomes the overflow marker, like real instruments
+        errors[SCPI_ERROR_QUEUE - 1] = SCPI_ERR_QUEUE_OVERFLOW;
+    }
+}
+
+static const char *error_text(int code){
+    switch (code) {
+        case 0:                         return "No error";
+        case SCPI_ERR_COMMAND:          return "Command error";
+        case SCPI_ERR_DATA_TYPE:        return "Data type error";
+        case SCPI_ERR_MISSING_PARAM:    return "Missing parameter";
+        case SCPI_ERR_UNDEFINED:        return "Undefined header";
+        case SCPI_ERR_EXECUTION:        return "Execution error";
+        case SCPI_ERR_OUT_OF_RANGE:     return "Data out of range";
+        case SCPI_ERR_TOO_MUCH_DATA:    return "Too much data";
+        case SCPI_ERR_QUEUE_OVERFLOW:   return "Queue overflow";
+        default:                        return "Error";
+    }
+}
+
+static void pop_error(){
+    int code = 0;
+    if (error_count > 0) {
+        code = errors[0];
+        for (int i = 1; i < error_count; i++) errors[i - 1] = errors[i];
+        error_count--;
+    }
+    printf("%d,\"%s\"\n", code, error_text(code));
+}
+
+// One node of a pattern ("SCALe") against one node of the input ("scal").
+// The input has to be exactly the short form (the uppercase part) or
+// exactly the long form.
+static bool match_node(const char *pat, int pat_len, const char *in, int in_len){
+    int short_len = 0;
+    while (short_len < pat_len && !islower((unsigned char)pat[short_len])) short_len++;
+    if (in_len != short_len && in_len != pat_len) return false;
+    for (int i = 0; i < in_len; i++) {
+        if (toupper((unsigned char)pat[i]) != toupper((unsigned char)in[i])) return false;
+    }
+    return true;
+}
+
+// Whole header, node by node, including the trailing '?'
+static bool match_header(const char *pat, const char *in, int in_len){
+    if (*pat == ':') pat++;
+    if (in_len > 0 && *in == ':') { in++; in_len--; }
+
+    while (1) {
+        int p = 0, n = 0;
+        while (pat[p] && pat[p] != ':' && pat[p] != '?') p++;
+        while (n < in_len && in[n] != ':' && in[n] != '?') n++;
+        if (!match_node(pat, p, in, n)) return false;
+        pat += p; in += n; in_len -= n;
+
+        if (*pat == ':' && in_len > 0 && *in == ':') { pat++; in++; in_len--; continue; }
+        bool pat_query = (*pat == '?');
+        bool in_query = (in_len > 0 && *in == '?');
+        if (pat_query != in_query) return false;
+        if (in_query) { pat++; in++; in_len--; }
+        return *pat == '\0' && in_len == 0;
+    }
+}
+
+static void dispatch(const char *cmd, int len){
+    while (len > 0 && isspace((unsigned char)*cmd)) { cmd++; len--; }
+    while (len > 0 && isspace((unsigned char)cmd[len - 1])) len--;
+    if (len == 0) return;
+
+    int header_len = 0;
+    while (header_len < len && !isspace((unsigned char)cmd[header_len])) header_len++;
+    const char *params = cmd + header_len;
+    while (isspace((unsigned char)*params)) params++;
+
+    if (match_header("*IDN?", cmd, header_len)) { printf("%s\n", ident); return; }
+    if (match_header("*CLS", cmd, header_len)) { error_count = 0; return; }
+    if (match_header("SYSTem:ERRor?", cmd, header_len) ||
+        match_header("SYSTem:ERRor:NEXT?", cmd, header_len)) { pop_error(); return; }
+
+    for (int i = 0; i < table_count; i++) {
+        if (match_header(table[i].pattern, cmd, header_len)) {
+            table[i].handler(params);
+            return;
+        }
+    }
+    scpi_error(SCPI_ERR_UNDEFINED);
+}
+
+static void execute_line(){
+    int start = 0;
+    for (int i = 0; i <= line_len; i++) {
+        if (i == line_len || line[i] == ';') {
+            // Terminate each command so handlers can parse params in place
+            line[i] = '\0';
+            dispatch(&line[start], i - start);
+            start = i + 1;
+        }
+    }
+}
+
+void scpi_feed(char c){
+    if (c == '\r') return;
+    if (c == '\n') {
+        if (line_overflow) scpi_error(SCPI_ERR_TOO_MUCH_DATA);
+        else execute_line();
+        line_len = 0;
+        line_overflow = false;
+        return;
+    }
+    // Keep one byte spare for the terminator execute_line() writes
+    if (line_len >= SCPI_LINE_MAX - 1) { line_overflow = true; return; }
+    line[line_len++] = c;
+}
+
+void scpi_init(const char *idn, const scpi_command_t *commands, int count){
+    ident = idn;
+    table = commands;
+    table_count = count;
+    line_len = 0;
+    line_overflow = false;
+    error_count = 0;
+}
+
+// Parse a number and move past it (and a following comma). Flags the
+// error itself if there isn't one.
+bool scpi_param_float(const char **params, float *value){
+    const char *p = *params;
+    while (isspace((unsigned char)*p)) p++;
+    if (*p == '\0') { scpi_error(SCPI_ERR_MISSING_PARAM); return false; }
+    char *end;
+    float v = strtof(p, &end);
+    if (end == p) { scpi_error(SCPI_ERR_DATA_TYPE); return false; }
+    while (isspace((unsigned char)*end)) end++;
+    if (*end == ',') end++;
+    *value = v;
+    *params = end;
+    return true;
+}
+
+// Parse a keyword out of a list of long/short form choices
+bool scpi_param_choice(const char **params, const char *const *choices, int count, int *index){
+    const char *p = *params;
+    while (isspace((unsigned char)*p)) p++;
+    if (*p == '\0') { scpi_error(SCPI_ERR_MISSING_PARAM); return false; }
+    int len = 0;
+    while (p[len] && p[len] != ',' && !isspace((unsigned char)p[len])) len++;
+    for (int i = 0; i < count; i++) {
+        const char *c = choices[i];
+        int c_len = 0;
+        while (c[c_len]) c_len++;
+        if (match_node(c, c_len, p, len)) {
+            p += len;
+            while (isspace((unsigned char)*p)) p++;
+            if (*p == ',') p++;
+            *index = i;
+            *params = p;
+            return true;
+        }
+    }
+    scpi_error(SCPI_ERR_DATA_TYPE);
+    return false;
+}
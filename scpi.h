@@ -0,0 +1,46 @@
+#ifndef SCPI_H
+#define SCPI_H
+
+#include "pico/stdlib.h"
+
+// SCPI-style remote control
+//
+// Characters are fed in one at a time and buffered until a newline, then
+// each ';'-separated command on the line is matched against a table and its
+// handler is called with a pointer to the parameter text. Nothing is
+// allocated. Every header in a line is absolute (a leading ':' is optional).
+//
+// Patterns use the usual SCPI long/short form: "TIMebase:SCALe?" matches
+// TIM:SCAL?, TIMEBASE:SCALE? and any mix of case.
+
+#define SCPI_LINE_MAX       128
+#define SCPI_ERROR_QUEUE    8
+
+// Standard error codes
+#define SCPI_ERR_COMMAND        -100
+#define SCPI_ERR_DATA_TYPE      -104
+#define SCPI_ERR_MISSING_PARAM  -109
+#define SCPI_ERR_UNDEFINED      -113
+#define SCPI_ERR_EXECUTION      -200
+#define SCPI_ERR_OUT_OF_RANGE   -222
+#define SCPI_ERR_TOO_MUCH_DATA  -223
+#define SCPI_ERR_QUEUE_OVERFLOW -350
+
+typedef void (*scpi_handler_t)(const char *params);
+
+typedef struct scpi_command {
+    const char *pattern;
+    scpi_handler_t handler;
+} scpi_command_t;
+
+void scpi_init(const char *idn, const scpi_command_t *commands, int count);
+
+void scpi_feed(char c);
+
+void scpi_error(int code);
+
+bool scpi_param_float(const char **params, float *value);
+
+bool scpi_param_choice(const char **params, const char *const *choices, int count, int *index);
+
+#endif
@@ -0,0 +1,254 @@
+// Seesaw gamepad driver
+// The seesaw needs a pause between the register write and the read, which
+// the old code spent in sleep_us(). Here every transaction is split into
+// non-blocking steps that push into / pull from the I2C FIFOs, and a
+// hardware alarm paces the steps, so nobody ever waits on the gamepad.
+
+#include "seesaw.h"
+#include "pico/stdlib.h"
+#include "hardware/i2c.h"
+#include "hardware/timer.h"
+#include "hardware/sync.h"
+
+// Delays the seesaw needs between the register write and the read
+#define SEESAW_GPIO_DELAY_US    600
+#define SEESAW_ADC_DELAY_US     1000
+
+// Rough time for n bytes + address on the wire at 400kHz, with some slack
+#define SEESAW_XFER_US(n)       (((n) + 1) * 23 + 20)
+
+// How long to keep checking the RX FIFO before giving up on a read
+#define SEESAW_COLLECT_RETRY_US 20
+#define SEESAW_COLLECT_RETRIES  10
+
+enum seesaw_step {
+    SS_BTN_WRITE,
+    SS_BTN_READ,
+    SS_BTN_COLLECT,
+    SS_JOYX_WRITE,
+    SS_JOYX_READ,
+    SS_JOYX_COLLECT,
+    SS_JOYY_WRITE,
+    SS_JOYY_READ,
+    SS_JOYY_COLLECT
+};
+
+static int seesaw_alarm = -1;
+static uint32_t poll_period_us = SEESAW_POLL_PERIOD_US;
+static enum seesaw_step step = SS_BTN_WRITE;
+static absolute_time_t cycle_start;
+static int collect_retries = 0;
+
+// Raw values from the cycle in progress
+static uint32_t raw_buttons;
+static uint16_t raw_joy_x;
+static uint16_t raw_joy_y;
+
+// Debounce state
+static uint32_t last_raw_buttons = 0xFFFFFFFF;
+static uint16_t last_joy_x = 512;
+static uint16_t last_joy_y = 512;
+
+// Published snapshot (written only from the alarm IRQ)
+static volatile seesaw_state_t published = { 0xFFFFFFFF, 512, 512, 0, 0 };
+static seesaw_callback_t publish_callback = NULL;
+
+void seesaw_init(){
+    i2c_init(I2C_PORT, 400 * 1000);
+    gpio_set_function(I2C_SDA_PIN, GPIO_FUNC_I2C);
+    gpio_set_function(I2C_SCL_PIN, GPIO_FUNC_I2C);
+    gpio_pull_up(I2C_SDA_PIN);
+    gpio_pull_up(I2C_SCL_PIN);
+}
+
+// Blocking, only used once at boot before polling starts
+void seesaw_pin_mode_bulk(uint32_t pins) {
+    uint8_t buf[6];
+    buf[0] = SEESAW_GPIO_BASE; buf[1] = SEESAW_GPIO_BULK_SET;
+    buf[2] = (pins >> 24) & 0xFF; buf[3] = (pins >> 16) & 0xFF;
+    buf[4] = (pins >> 8) & 0xFF; buf[5] = pins & 0xFF;
+    i2c_write_blocking(I2C_PORT, SEESAW_I2C_ADDR, buf, 6, false);
+}
+
+static void seesaw_schedule(uint32_t delay_us){
+    // set_target returns true if the time already passed, fire it by hand
+    if (hardware_alarm_set_target(seesaw_alarm, make_timeout_time_us(delay_us))) {
+        hardware_alarm_force_irq(seesaw_alarm);
+    }
+}
+
+static void seesaw_write_reg(uint8_t base, uint8_t reg){
+    i2c_hw_t *hw = i2c_get_hw(I2C_PORT);
+    hw->data_cmd = base;
+    hw->data_cmd = reg | I2C_IC_DATA_CMD_STOP_BITS;
+}
+
+static void seesaw_issue_read(int len){
+    i2c_hw_t *hw = i2c_get_hw(I2C_PORT);
+    for (int i = 0; i < len; i++) {
+        uint32_t cmd = I2C_IC_DATA_CMD_CMD_BITS;
+        if (i == len - 1) cmd |= I2C_IC_DATA_CMD_STOP_BITS;
+        hw->data_cmd = cmd;
+    }
+}
+
+// Returns false if the bytes haven't all arrived yet
+static bool seesaw_collect(uint8_t *dst, int len){
+    i2c_hw_t *hw = i2c_get_hw(I2C_PORT);
+    if ((int)hw->rxflr < len) return false;
+    for (int i = 0; i < len; i++) dst[i] = (uint8_t)hw->data_cmd;
+    return true;
+}
+
+// Drop whatever is left of a failed transaction and start over next period
+static void seesaw_abort(){
+    i2c_hw_t *hw = i2c_get_hw(I2C_PORT);
+    (void)hw->clr_tx_abrt;
+    while (hw->rxflr) (void)hw->data_cmd;
+    published.errors++;
+    step = SS_BTN_WRITE;
+    seesaw_schedule(poll_period_us);
+}
+
+static void seesaw_publish(){
+    // Buttons must read the same on two cycles in a row before they count
+    uint32_t buttons = published.buttons;
+    if (raw_buttons == last_raw_buttons) buttons = raw_buttons;
+    last_raw_buttons = raw_buttons;
+
+    // Joystick gets a two-sample average to knock down ADC noise
+    uint16_t jx = (raw_joy_x + last_joy_x) / 2;
+    uint16_t jy = (raw_joy_y + last_joy_y) / 2;
+    last_joy_x = raw_joy_x;
+    last_joy_y = raw_joy_y;
+
+    published.buttons = buttons;
+    published.joy_x = jx;
+    published.joy_y = jy;
+    published.cycles++;
+
+    if (publish_callback) {
+        seesaw_state_t state = { buttons, jx, jy, published.cycles, published.errors };
+        publish_callback(&state);
+    }
+}
+
+// Pull a finished read out of the FIFO. Returns false (and reschedules or
+// aborts) if it hasn't arrived yet.
+static bool seesaw_read_step(uint8_t *buf, int len){
+    if (seesaw_collect(buf, len)) {
+        collect_retries = 0;
+        return true;
+    }
+    if (++collect_retries > SEESAW_COLLECT_RETRIES) {
+        collect_retries = 0;
+        seesaw_abort();
+    } else {
+        seesaw_schedule(SEESAW_COLLECT_RETRY_US);
+    }
+    return false;
+}
+
+// Alarm callback, runs one step of the poll cycle
+static void seesaw_alarm_callback(uint alarm_num){
+    uint8_t buf[4];
+
+    if (i2c_get_hw(I2C_PORT)->raw_intr_stat & I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS) {
+        seesaw_abort();
+        return;
+    }
+
+    switch (step) {
+        case SS_BTN_WRITE:
+            cycle_start = get_absolute_time();
+            seesaw_write_reg(SEESAW_GPIO_BASE, SEESAW_GPIO_BULK);
+            step = SS_BTN_READ;
+            seesaw_schedule(SEESAW_XFER_US(2) + SEESAW_GPIO_DELAY_US);
+            break;
+        case SS_BTN_READ:
+            seesaw_issue_read(4);
+            step = SS_BTN_COLLECT;
+            seesaw_schedule(SEESAW_XFER_US(4));
+            break;
+        case SS_BTN_COLLECT:
+            if (!seesaw_read_step(buf, 4)) break;
+            raw_buttons = ((uint32_t)buf[0] << 24) | ((uint32_t)buf[1] << 16) |
+                          ((uint32_t)buf[2] << 8) | (uint32_t)buf[3];
+            step = SS_JOYX_WRITE;
+            seesaw_schedule(0);
+            break;
+        case SS_JOYX_WRITE:
+            seesaw_write_reg(SEESAW_ADC_BASE, SEESAW_ADC_OFFSET + PIN_JOY_X);
+            step = SS_JOYX_READ;
+            seesaw_schedule(SEESAW_XFER_US(2) + SEESAW_ADC_DELAY_US);
+            break;
+        case SS_JOYX_READ:
+            seesaw_issue_read(2);
+            step = SS_JOYX_COLLECT;
+            seesaw_schedule(SEESAW_XFER_US(2));
+            break;
+        case SS_JOYX_COLLECT:
+            if (!seesaw_read_step(buf, 2)) break;
+            raw_joy_x = ((uint16_t)buf[0] << 8) | buf[1];
+            step = SS_JOYY_WRITE;
+            seesaw_schedule(0);
+            break;
+        case SS_JOYY_WRITE:
+            seesaw_write_reg(SEESAW_ADC_BASE, SEESAW_ADC_OFFSET + PIN_JOY_Y);
+            step = SS_JOYY_READ;
+            seesaw_schedule(SEESAW_XFER_US(2) + SEESAW_ADC_DELAY_US);
+            break;
+        case SS_JOYY_READ:
+            seesaw_issue_read(2);
+            step = SS_JOYY_COLLECT;
+            seesaw_schedule(SEESAW_XFER_US(2));
+            break;
+        case SS_JOYY_COLLECT: {
+            if (!seesaw_read_step(buf, 2)) break;
+            raw_joy_y = ((uint16_t)buf[0] << 8) | buf[1];
+            seesaw_publish();
+            // Next cycle starts one period after this one started
+            int64_t wait = (int64_t)poll_period_us - absolute_time_diff_us(cycle_start, get_absolute_time());
+            step = SS_BTN_WRITE;
+            seesaw_schedule(wait > 0 ? (uint32_t)wait : 0);
+            break;
+        }
+    }
+}
+
+// Takes effect from the next poll cycle
+void seesaw_set_poll_period(uint32_t period_us){
+    poll_period_us = period_us;
+}
+
+void seesaw_set_callback(seesaw_callback_t callback){
+    publish_callback = callback;
+}
+
+void seesaw_start_polling(uint32_t period_us){
+    poll_period_us = period_us;
+    if (seesaw_alarm >= 0) return;
+
+    // Only one device on the bus, so the target address is set once here
+    i2c_hw_t *hw = i2c_get_hw(I2C_PORT);
+    hw->enable = 0;
+    hw->tar = SEESAW_I2C_ADDR;
+    hw->enable = 1;
+
+    seesaw_alarm = hardware_alarm_claim_unused(true);
+    hardware_alarm_set_callback(seesaw_alarm, seesaw_alarm_callback);
+    step = SS_BTN_WRITE;
+    seesaw_schedule(0);
+}
+
+// Copy out the latest snapshot. The poller runs on core 0's timer IRQ,
+// so call this from core 0.
+void seesaw_get_state(seesaw_state_t *state){
+    uint32_t save = save_and_disable_interrupts();
+    state->buttons = published.buttons;
+    state->joy_x = published.joy_x;
+    state->joy_y = published.joy_y;
+    state->cycles = published.cycles;
+    state->errors = published.errors;
+    restore_interrupts(save);
+}
@@ -0,0 +1,70 @@
+#ifndef SEESAW_H
+#define SEESAW_H
+
+#include "pico/stdlib.h"
+
+// --- I2C/Seesaw Definitions ---
+#define SEESAW_I2C_ADDR         0x50
+#define I2C_PORT                i2c1
+#define I2C_SDA_PIN             2
+#define I2C_SCL_PIN             3
+
+// Seesaw Registers
+#define SEESAW_GPIO_BASE        0x01
+#define SEESAW_GPIO_BULK_SET    0x05
+#define SEESAW_GPIO_BULK        0x04
+#define SEESAW_ADC_BASE         0x09
+#define SEESAW_ADC_OFFSET       0x07
+
+// --- PIN MAPPING (Adafruit Mini Gamepad PID 5743) ---
+#define PIN_BTN_SELECT  0
+#define PIN_BTN_B       1
+#define PIN_BTN_Y       2
+#define PIN_BTN_A       5
+#define PIN_BTN_X       6
+#define PIN_BTN_START   16
+#define PIN_JOY_X       14
+#define PIN_JOY_Y       15
+
+// Bitmasks
+#define MASK_SELECT     (1UL << PIN_BTN_SELECT)
+#define MASK_B          (1UL << PIN_BTN_B)
+#define MASK_Y          (1UL << PIN_BTN_Y)
+#define MASK_A          (1UL << PIN_BTN_A)
+#define MASK_X          (1UL << PIN_BTN_X)
+#define MASK_START      (1UL << PIN_BTN_START)
+
+// After power-up before the seesaw answers on I2C
+#define SEESAW_BOOT_MS          100
+
+// Time between the start of two poll cycles. One cycle (buttons + both
+// joystick axes) takes just under 3ms because of the seesaw's read delays.
+#define SEESAW_POLL_PERIOD_US   4000
+// Slower rate used while nobody is touching the scope
+#define SEESAW_IDLE_POLL_PERIOD_US 50000
+
+// Latest debounced gamepad state, published by the alarm-driven poller
+typedef struct seesaw_state {
+    uint32_t buttons;       // active low, same layout as the GPIO bulk read
+    uint16_t joy_x;
+    uint16_t joy_y;
+    uint32_t cycles;        // completed poll cycles, lets callers spot new data
+    uint32_t errors;        // aborted transactions (NAK, bus error)
+} seesaw_state_t;
+
+// Called from the alarm IRQ every time a new snapshot is published
+typedef void (*seesaw_callback_t)(const seesaw_state_t *state);
+
+void seesaw_init();
+
+void seesaw_pin_mode_bulk(uint32_t pins);
+
+void seesaw_start_polling(uint32_t period_us);
+
+void seesaw_set_poll_period(uint32_t period_us);
+
+void seesaw_set_callback(seesaw_callback_t callback);
+
+void seesaw_get_state(seesaw_state_t *state);
+
+#endif
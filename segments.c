@@ -0,0 +1,111 @@
+// Segmented acquisition
+// The trigger IRQ only notes where the ring was and when, then sets an
+// alarm for when the post-trigger samples will have landed. The alarm
+// copies the window out and re-arms, so re-arm dead time is about the
+// post-trigger length plus IRQ latency.
+
+#include "segments.h"
+#include "pico/stdlib.h"
+#include "adc.h"
+#include "deep.h"
+#include <string.h>
+
+#define SEG_POST_TRIGGER    (SEG_LEN - SEG_PRE_TRIGGER)
+#define SEG_SAMPLE_US       (1000000 / ADC_SAMPLE_RATE_HZ)
+
+#if SEG_ARENA_SIZE > DEEP_MAX_SAMPLES
+#error "segment arena doesn't fit in the deep memory buffer"
+#endif
+
+// Borrowed from deep memory, only one of the two modes runs at a time
+static uint8_t *const arena = deep_buf;
+static uint32_t times_us[SEG_MAX];
+
+static volatile int count = 0;
+static volatile int target = 0;
+static volatile bool armed = false;
+// Bumped by seg_start/seg_abort so a late alarm from an old sequence is ignored
+static volatile uint32_t generation = 0;
+
+// Trigger that's waiting for its post-trigger samples
+static uint16_t pending_index;
+
+static int samples_since(uint16_t index){
+    int d = (int)adc_capture_write_index() - index;
+    if (d < 0) d += CAPTURE_DEPTH;
+    return d;
+}
+
+static int64_t seg_alarm_callback(alarm_id_t id, void *user_data){
+    if ((uint32_t)(uintptr_t)user_data != generation) return 0;
+
+    // Alarms can fire a little early relative to the ADC, wait out the rest
+    int have = samples_since(pending_index);
+    if (have < SEG_POST_TRIGGER) return (SEG_POST_TRIGGER - have) * SEG_SAMPLE_US + 1;
+
+    uint8_t *dst = &arena[count * SEG_LEN];
+    int start = (int)pending_index - SEG_PRE_TRIGGER;
+    if (start < 0) start += CAPTURE_DEPTH;
+    int first = CAPTURE_DEPTH - start;
+    if (first >= SEG_LEN) {
+        memcpy(dst, &capture_buf[start], SEG_LEN);
+    } else {
+        memcpy(dst, &capture_buf[start], first);
+        memcpy(dst + first, capture_buf, SEG_LEN - first);
+    }
+
+    count++;
+    armed = count < target;
+    return 0;
+}
+
+// Begin a new sequence of count segments, throwing away the last one
+void seg_start(int n){
+    if (n > SEG_MAX) n = SEG_MAX;
+    if (n < 1) n = 1;
+    armed = false;
+    generation++;
+    count = 0;
+    target = n;
+    armed = true;
+}
+
+void seg_abort(){
+    armed = false;
+    generation++;
+    target = 0;
+}
+
+// Call from the trigger GPIO IRQ while in segmented mode
+void seg_trigger_isr(){
+    if (!armed) return;
+    armed = false;
+    pending_index = adc_capture_write_index();
+    times_us[count] = time_us_32();
+    add_alarm_in_us(SEG_POST_TRIGGER * SEG_SAMPLE_US, seg_alarm_callback, (void *)(uintptr_t)generation, true);
+}
+
+bool seg_armed(){
+    return armed;
+}
+
+bool seg_complete(){
+    return target > 0 && count >= target;
+}
+
+// Segments captured so far
+int seg_count(){
+    return count;
+}
+
+int seg_target(){
+    return target;
+}
+
+const uint8_t *seg_data(int index){
+    return &arena[index * SEG_LEN];
+}
+
+uint32_t seg_time_us(int index){
+    return times_us[index];
+}
@@ -0,0 +1,37 @@
+#ifndef SEGMENTS_H
+#define SEGMENTS_H
+
+#include "pico/stdlib.h"
+
+// Segmented acquisition
+//
+// Each trigger grabs one short trigger-aligned window out of the live DMA
+// ring into a packed arena, timestamps it and re-arms straight away. Nothing
+// is drawn until the whole sequence is in, so the trigger rate is limited
+// by the post-trigger time and IRQ latency, not the display.
+
+#define SEG_LEN             128     // samples per segment
+#define SEG_PRE_TRIGGER     32      // of which before the trigger
+#define SEG_MAX             256
+#define SEG_ARENA_SIZE      (SEG_LEN * SEG_MAX)
+#define SEG_DEFAULT_COUNT   64
+
+void seg_start(int count);
+
+void seg_abort();
+
+void seg_trigger_isr();
+
+bool seg_armed();
+
+bool seg_complete();
+
+int seg_count();
+
+int seg_target();
+
+const uint8_t *seg_data(int index);
+
+uint32_t seg_time_us(int index);
+
+#endif
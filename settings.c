@@ -0,0 +1,77 @@
+// Settings ring
+// Pages are used in order across SETTINGS_SECTORS sectors. A page that
+// isn't blank when its turn comes (a save cut short by a power loss) is
+// skipped by moving on to the next sector, which gets erased first.
+
+#include "settings.h"
+#include "pico/stdlib.h"
+#include "flash_layout.h"
+#include "flash_util.h"
+#include <stddef.h>
+#include <string.h>
+
+#define SLOTS_PER_SECTOR    (FLASH_SECTOR_SIZE / FLASH_PAGE_SIZE)
+#define SLOTS               (SETTINGS_SECTORS * SLOTS_PER_SECTOR)
+
+// Newest valid page, found by settings_load
+static int last_slot = -1;
+static uint32_t last_seq = 0;
+
+static uint32_t slot_offset(int slot){
+    return FLASH_SETTINGS_OFFSET + slot * FLASH_PAGE_SIZE;
+}
+
+static uint16_t record_crc(const settings_record_t *r){
+    return flash_util_crc16(0xFFFF, (const uint8_t *)r, offsetof(settings_record_t, crc));
+}
+
+static bool slot_blank(int slot){
+    const uint32_t *p = (const uint32_t *)flash_util_ptr(slot_offset(slot));
+    for (int i = 0; i < FLASH_PAGE_SIZE / 4; i++) if (p[i] != 0xFFFFFFFF) return false;
+    return true;
+}
+
+// Fills s from the newest valid page. Returns false (s untouched) if there
+// isn't one, e.g. first boot or a version change.
+bool settings_load(settings_t *s){
+    last_slot = -1;
+    last_seq = 0;
+    for (int i = 0; i < SLOTS; i++) {
+        const settings_record_t *r = (const settings_record_t *)flash_util_ptr(slot_offset(i));
+        if (r->magic != SETTINGS_MAGIC || r->version != SETTINGS_VERSION || r->size != sizeof(*r)) continue;
+        if (last_slot >= 0 && r->seq <= last_seq) continue;
+        if (r->crc != record_crc(r)) continue;
+        last_slot = i;
+        last_seq = r->seq;
+    }
+    if (last_slot < 0) return false;
+    memcpy(s, &((const settings_record_t *)flash_util_ptr(slot_offset(last_slot)))->settings, sizeof(*s));
+    return true;
+}
+
+// Write to the page after the newest one. Call settings_load first.
+bool settings_save(const settings_t *s){
+    static uint8_t page[FLASH_PAGE_SIZE];
+    int slot = (last_slot + 1) % SLOTS;
+    if (slot % SLOTS_PER_SECTOR != 0 && !slot_blank(slot)) {
+        slot = (slot / SLOTS_PER_SECTOR + 1) % SETTINGS_SECTORS * SLOTS_PER_SECTOR;
+    }
+    if (slot % SLOTS_PER_SECTOR == 0 &&
+        !flash_util_erase(slot_offset(slot), FLASH_SECTOR_SIZE)) return false;
+
+    settings_record_t r;
+    memset(&r, 0, sizeof(r));
+    r.magic = SETTINGS_MAGIC;
+    r.version = SETTINGS_VERSION;
+    r.size = sizeof(r);
+    r.seq = last_seq + 1;
+    r.settings = *s;
+    r.crc = record_crc(&r);
+    memset(page, 0xFF, sizeof(page));
+    memcpy(page, &r, sizeof(r));
+    if (!flash_util_program(slot_offset(slot), page, FLASH_PAGE_SIZE)) return false;
+
+    last_slot = slot;
+    last_seq = r.seq;
+    return true;
+}
@@ -0,0 +1,48 @@
+#ifndef SETTINGS_H
+#define SETTINGS_H
+
+#include "pico/stdlib.h"
+
+// Front panel settings kept across power cycles
+//
+// Every save goes into the next 256-byte page of a small ring of flash
+// sectors, tagged with a sequence number and a CRC, so each page is
+// written once per trip round the ring and a sector is only erased when
+// the ring comes back to it. Boot just picks the newest valid page, which
+// is a few dozen header reads straight out of XIP.
+
+#define SETTINGS_MAGIC          0x54455353  // "SSET"
+#define SETTINGS_VERSION        1
+#define SETTINGS_SECTORS        2           // one always holds a valid copy while the other is erased
+#define SETTINGS_SAVE_DELAY_MS  5000        // wait for the knobs to settle before writing
+
+typedef struct settings {
+    float volts_per_div;
+    float time_per_div;
+    float cursor_v1;
+    float cursor_v2;
+    float trigger_pin_volts;
+    uint8_t gain_mode;
+    uint8_t show_cursors;
+    uint8_t fft_mode;
+    uint8_t interp_mode;
+    uint8_t persist_mode;
+    uint8_t auto_trigger;
+    uint8_t reserved[2];
+} settings_t;
+
+typedef struct settings_record {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t size;
+    uint32_t seq;
+    settings_t settings;
+    uint16_t reserved;
+    uint16_t crc;           // over everything above
+} settings_record_t;
+
+bool settings_load(settings_t *s);
+
+bool settings_save(const settings_t *s);
+
+#endif
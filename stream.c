@@ -0,0 +1,166 @@
+// USB capture streaming
+// Core 0 copies each triggered frame into the frame pool (a memcpy, never
+// blocks). Core 1 drains the pool, encodes and writes straight to the CDC
+// driver, so a slow or absent host only ever costs dropped frames.
+// The port is shared with SCPI replies from core 0: whoever holds port_lock
+// owns it, so a frame never lands in the middle of a reply.
+
+#include "stream.h"
+#include "pico/stdlib.h"
+#include "pico/stdio_usb.h"
+#include "pico/sync.h"
+#include "framequeue.h"
+#include "codec.h"
+#include <string.h>
+
+// Compressed payloads that don't beat raw are sent raw, so raw size is the limit
+#define STREAM_MAX_FRAME (STREAM_HEADER_SIZE + CAPTURE_DEPTH + 2)
+
+static uint8_t tx_buf[STREAM_MAX_FRAME];
+static uint32_t sample_rate = 0;
+static stream_encoding_t encoding = STREAM_ENC_RICE;
+static uint32_t next_seq = 0;
+static uint32_t last_dropped = 0;
+static uint32_t frames_sent = 0;
+static int pending = 0;         // bytes of tx_buf waiting for the port
+
+auto_init_mutex(port_lock);
+
+static uint16_t crc16_ccitt(const uint8_t *data, int len){
+    uint16_t crc = 0xFFFF;
+    for (int i = 0; i < len; i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for (int b = 0; b < 8; b++) {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+        }
+    }
+    return crc;
+}
+
+// DELTA4: the first sample as a byte, then one nibble per sample holding the
+// signed change from the previous one (-7..7). Nibble 0x8 escapes a full
+// sample in the next two nibbles, high first. Nibbles pack high-first; a
+// trailing pad nibble is ignored since the header gives the sample count.
+// Returns the payload size, or 0 if it wouldn't beat raw.
+static int encode_delta4(const uint8_t *samples, int count, uint8_t *out, int max_len){
+    if (count == 0) return 0;
+    int len = 0;
+    bool high = true;
+    out[len++] = samples[0];
+
+#define PUT_NIBBLE(n) do { \
+        if (high) { if (len >= max_len) return 0; out[len] = (uint8_t)((n) << 4); } \
+        else { out[len++] |= (uint8_t)((n) & 0xF); } \
+        high = !high; \
+    } while (0)
+
+    for (int i = 1; i < count; i++) {
+        int d = (int)samples[i] - (int)samples[i - 1];
+        if (d >= -7 && d <= 7) {
+            PUT_NIBBLE(d & 0xF);
+        } else {
+            PUT_NIBBLE(0x8);
+            PUT_NIBBLE(samples[i] >> 4);
+            PUT_NIBBLE(samples[i] & 0xF);
+        }
+    }
+#undef PUT_NIBBLE
+
+    if (!high) len++;
+    return (len < count) ? len : 0;
+}
+
+void stream_init(uint32_t sample_rate_hz){
+    sample_rate = sample_rate_hz;
+}
+
+void stream_set_encoding(stream_encoding_t enc){
+    encoding = enc;
+}
+
+// Core 0: queue a capture for sending. Returns false if it was dropped.
+bool stream_submit(const uint8_t *samples, uint16_t count, uint16_t trigger_index, uint8_t gain){
+    uint32_t seq = next_seq++;
+    if (!stdio_usb_connected()) return false;
+
+    frame_slot_t *slot = framequeue_acquire();
+    if (slot == NULL) return false;
+
+    if (count > CAPTURE_DEPTH) count = CAPTURE_DEPTH;
+    slot->seq = seq;
+    slot->time_us = time_us_32();
+    slot->trigger_index = trigger_index;
+    slot->count = count;
+    slot->gain = gain;
+    memcpy(slot->samples, samples, count);
+    framequeue_publish();
+    return true;
+}
+
+// Core 0: take the port for a reply. Never waits, false if a frame is going out.
+bool stream_port_claim(){
+    return mutex_try_enter(&port_lock, NULL);
+}
+
+void stream_port_release(){
+    mutex_exit(&port_lock);
+}
+
+// Encode the oldest queued frame into tx_buf. Returns its length on the wire.
+static int encode_next(){
+    frame_slot_t *slot = framequeue_peek();
+    if (slot == NULL) return 0;
+
+    stream_header_t hdr;
+    hdr.magic = STREAM_MAGIC;
+    hdr.version = STREAM_VERSION;
+    hdr.seq = slot->seq;
+    hdr.sample_rate = sample_rate;
+    hdr.sample_count = slot->count;
+    hdr.trigger_index = slot->trigger_index;
+    hdr.gain = slot->gain;
+
+    uint32_t dropped = framequeue_dropped();
+    uint32_t new_drops = dropped - last_dropped;
+    last_dropped = dropped;
+    hdr.dropped = (new_drops > 255) ? 255 : (uint8_t)new_drops;
+
+    uint8_t *payload = tx_buf + STREAM_HEADER_SIZE;
+    int len = 0;
+    if (encoding == STREAM_ENC_DELTA4) len = encode_delta4(slot->samples, slot->count, payload, CAPTURE_DEPTH);
+    else if (encoding == STREAM_ENC_RICE) len = codec_encode(slot->samples, slot->count, payload, slot->count - 1);
+    if (len > 0) {
+        hdr.encoding = encoding;
+    } else {
+        hdr.encoding = STREAM_ENC_RAW;
+        memcpy(payload, slot->samples, slot->count);
+        len = slot->count;
+    }
+    framequeue_release();
+
+    hdr.payload_len = len;
+    memcpy(tx_buf, &hdr, STREAM_HEADER_SIZE);
+    uint16_t crc = crc16_ccitt(tx_buf, STREAM_HEADER_SIZE + len);
+    tx_buf[STREAM_HEADER_SIZE + len] = crc & 0xFF;
+    tx_buf[STREAM_HEADER_SIZE + len + 1] = crc >> 8;
+    return STREAM_HEADER_SIZE + len + 2;
+}
+
+// Core 1: send the oldest queued frame. Returns true if one went out.
+bool stream_service(){
+    if (pending == 0) pending = encode_next();
+    if (pending == 0) return false;
+
+    // A reply is going out, the frame keeps until it's done
+    if (!mutex_try_enter(&port_lock, NULL)) return false;
+    // Straight to the CDC driver: stdio would translate '\n' bytes to CRLF
+    stdio_usb.out_chars((const char *)tx_buf, pending);
+    mutex_exit(&port_lock);
+    pending = 0;
+    frames_sent++;
+    return true;
+}
+
+uint32_t stream_frames_sent(){
+    return frames_sent;
+}
@@ -0,0 +1,60 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include "pico/stdlib.h"
+
+// Binary capture stream over USB CDC
+//
+// Every frame is a fixed header, the payload and a CRC, all little-endian:
+//
+//   0  u16 magic          STREAM_MAGIC ("SB")
+//   2  u8  version        STREAM_VERSION
+//   3  u8  encoding       stream_encoding_t
+//   4  u32 seq            capture sequence number, gaps = dropped frames
+//   8  u32 sample_rate    Hz
+//   12 u16 sample_count
+//   14 u16 trigger_index  sample the trigger fired on
+//   16 u16 payload_len    bytes following the header
+//   18 u8  gain           gain_mode_t
+//   19 u8  dropped        frames dropped since the last one sent (saturates)
+//   20 ... payload
+//   .. u16 crc            CRC-16/CCITT-FALSE over header + payload
+
+#define STREAM_MAGIC        0x4253
+#define STREAM_VERSION      1
+#define STREAM_HEADER_SIZE  20
+
+typedef enum stream_encoding {
+    STREAM_ENC_RAW,     // one byte per sample
+    STREAM_ENC_DELTA4,  // first sample raw, then 4-bit deltas, see stream.c
+    STREAM_ENC_RICE     // codec.h
+} stream_encoding_t;
+
+typedef struct __attribute__((packed)) stream_header {
+    uint16_t magic;
+    uint8_t version;
+    uint8_t encoding;
+    uint32_t seq;
+    uint32_t sample_rate;
+    uint16_t sample_count;
+    uint16_t trigger_index;
+    uint16_t payload_len;
+    uint8_t gain;
+    uint8_t dropped;
+} stream_header_t;
+
+void stream_init(uint32_t sample_rate_hz);
+
+void stream_set_encoding(stream_encoding_t encoding);
+
+bool stream_submit(const uint8_t *samples, uint16_t count, uint16_t trigger_index, uint8_t gain);
+
+bool stream_service();
+
+bool stream_port_claim();
+
+void stream_port_release();
+
+uint32_t stream_frames_sent();
+
+#endif
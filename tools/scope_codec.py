@@ -0,0 +1,70 @@
+"""Decoders for the compressed capture payloads.
+
+Python versions of the firmware's decoders. See codec.h for the Rice
+bitstream and stream.c for DELTA4.
+"""
+
+CODEC_BLOCK = 16
+CODEC_ESCAPE = 12
+CODEC_K_ZERO = 7
+
+
+class BitReader:
+    def __init__(self, data):
+        self.data = data
+        self.pos = 0
+
+    def bits(self, n):
+        if self.pos + n > len(self.data) * 8:
+            raise ValueError("compressed payload ran out")
+        v = 0
+        for _ in range(n):
+            byte = self.data[self.pos >> 3]
+            v = (v << 1) | ((byte >> (7 - (self.pos & 7))) & 1)
+            self.pos += 1
+        return v
+
+
+def decode_rice(payload, count):
+    if count == 0:
+        return []
+    r = BitReader(payload)
+    samples = [r.bits(8)]
+    while len(samples) < count:
+        n = min(CODEC_BLOCK, count - len(samples))
+        k = r.bits(3)
+        for _ in range(n):
+            z = 0
+            if k != CODEC_K_ZERO:
+                q = 0
+                while q < CODEC_ESCAPE and r.bits(1):
+                    q += 1
+                if q == CODEC_ESCAPE:
+                    z = r.bits(8)
+                else:
+                    z = (q << k) | (r.bits(k) if k else 0)
+            delta = (z >> 1) ^ -(z & 1)
+            samples.append((samples[-1] + delta) & 0xFF)
+    return samples
+
+
+def decode_delta4(payload, count):
+    if count == 0:
+        return []
+    nibbles = []
+    for byte in payload[1:]:
+        nibbles.append(byte >> 4)
+        nibbles.append(byte & 0xF)
+
+    samples = [payload[0]]
+    i = 0
+    while len(samples) < count:
+        n = nibbles[i]
+        i += 1
+        if n == 0x8:
+            samples.append((nibbles[i] << 4) | nibbles[i + 1])
+            i += 2
+        else:
+            delta = n - 16 if n & 0x8 else n
+            samples.append((samples[-1] + delta) & 0xFF)
+    return samples
@@ -0,0 +1,177 @@
+#!/usr/bin/env python3
+"""Read the ScopeBoy USB capture stream.
+
+Press START on the scope to begin streaming, then run e.g.
+
+    python3 scope_stream.py /dev/ttyACM0 --csv captures.csv
+
+The port argument can also be a file holding a raw dump of the stream
+(e.g. from `cat /dev/ttyACM0 > dump.bin`), which is handy for testing
+without hardware. The frame format is documented in stream.h.
+"""
+
+import argparse
+import os
+import struct
+import sys
+import time
+
+import scope_codec
+
+MAGIC = 0x4253
+VERSION = 1
+HEADER = struct.Struct("<HBBIIHHHBB")
+
+ENC_RAW = 0
+ENC_DELTA4 = 1
+ENC_RICE = 2
+
+GAIN_NAMES = {0: "LOW", 1: "MED", 2: "HIGH"}
+
+
+def crc16_ccitt(data):
+    crc = 0xFFFF
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else (crc << 1)
+            crc &= 0xFFFF
+    return crc
+
+
+def decode_payload(encoding, payload, count):
+    if encoding == ENC_RAW:
+        return list(payload[:count])
+    if encoding == ENC_DELTA4:
+        return scope_codec.decode_delta4(payload, count)
+    if encoding == ENC_RICE:
+        return scope_codec.decode_rice(payload, count)
+    raise ValueError("unknown encoding %d" % encoding)
+
+
+class FrameReader:
+    """Pulls frames out of a byte stream, resyncing on the magic after junk
+    or a bad CRC."""
+
+    def __init__(self, read):
+        self.read = read
+        self.buf = bytearray()
+        self.bad_crc = 0
+        self.skipped_bytes = 0
+
+    def _fill(self, n):
+        while len(self.buf) < n:
+            chunk = self.read(max(n - len(self.buf), 4096))
+            if not chunk:
+                return False
+            self.buf += chunk
+        return True
+
+    def frames(self):
+        magic = struct.pack("<H", MAGIC)
+        while True:
+            if not self._fill(HEADER.size):
+                return
+            start = self.buf.find(magic)
+            if start < 0:
+                self.skipped_bytes += len(self.buf) - 1
+                del self.buf[:-1]
+                continue
+            if start > 0:
+                self.skipped_bytes += start
+                del self.buf[:start]
+                continue
+            if not self._fill(HEADER.size):
+                return
+
+            fields = HEADER.unpack_from(self.buf)
+            (_, version, encoding, seq, rate, count, trig, plen, gain, dropped) = fields
+            total = HEADER.size + plen + 2
+            if version != VERSION or plen > 4096:
+                del self.buf[:1]
+                self.skipped_bytes += 1
+                continue
+            if not self._fill(total):
+                return
+
+            frame = bytes(self.buf[:total])
+            crc = struct.unpack_from("<H", frame, total - 2)[0]
+            if crc16_ccitt(frame[:-2]) != crc:
+                self.bad_crc += 1
+                del self.buf[:1]
+                continue
+            del self.buf[:total]
+
+            yield {
+                "seq": seq,
+                "sample_rate": rate,
+                "trigger_index": trig,
+                "gain": gain,
+                "dropped": dropped,
+                "encoding": encoding,
+                "wire_bytes": total,
+                "samples": decode_payload(encoding, frame[HEADER.size:-2], count),
+            }
+
+
+def open_source(path, baud):
+    if os.path.isfile(path):
+        return open(path, "rb").read
+    import serial  # pyserial
+    return serial.Serial(path, baud, timeout=1).read
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("port", help="serial port or raw dump file")
+    ap.add_argument("--baud", type=int, default=115200, help="ignored by USB CDC")
+    ap.add_argument("--csv", help="append samples here, one frame per row")
+    ap.add_argument("--count", type=int, default=0, help="stop after this many frames")
+    args = ap.parse_args()
+
+    reader = FrameReader(open_source(args.port, args.baud))
+    out = open(args.csv, "a") if args.csv else None
+
+    frames = 0
+    wire_bytes = 0
+    lost = 0
+    last_seq = None
+    t0 = time.monotonic()
+    t_report = t0
+
+    try:
+        for f in reader.frames():
+            if last_seq is not None:
+                lost += (f["seq"] - last_seq - 1) & 0xFFFFFFFF
+            last_seq = f["seq"]
+            frames += 1
+            wire_bytes += f["wire_bytes"]
+
+            if out:
+                out.write("%d,%d,%d,%s,%s\n" % (
+                    f["seq"], f["sample_rate"], f["trigger_index"],
+                    GAIN_NAMES.get(f["gain"], f["gain"]),
+                    ",".join(str(s) for s in f["samples"])))
+
+            now = time.monotonic()
+            if now - t_report >= 1.0:
+                elapsed = now - t0
+                print("%d frames, %.1f frames/s, %.1f kB/s, %d lost, %d bad CRC" % (
+                    frames, frames / elapsed, wire_bytes / elapsed / 1000.0,
+                    lost, reader.bad_crc), file=sys.stderr)
+                t_report = now
+
+            if args.count and frames >= args.count:
+                break
+    except KeyboardInterrupt:
+        pass
+    finally:
+        if out:
+            out.close()
+
+    print("%d frames, %d lost, %d bad CRC, %d bytes skipped" % (
+        frames, lost, reader.bad_crc, reader.skipped_bytes), file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
@@ -34,6 +34,9 @@ void trigger_isr(){
     // Disarm until this capture is processed
     trigger_armed = false;
 
+    // Remember where in the ring the trigger landed
+    trigger_index = adc_capture_write_index();
+
     // Tell main loop to freeze/copy the capture buffer
     trigger_fired = true;
 
@@ -47,6 +50,7 @@ void trigger_copy(){
             // At this moment, DMA is still running and overwriting capture_buf,
             // but the copy is very fast so you effectively "freeze" a window.
             memcpy(frame_buf, capture_buf, CAPTURE_DEPTH);
+            frame_trigger_index = trigger_index;
 
             capture_ready = true;
 
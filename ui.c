@@ -0,0 +1,111 @@
+// Widget compositor
+// Widgets are painted back to front in the order they were added. When one
+// is repainted, anything above it that overlaps gets repainted too, so
+// overlays (cursor lines, labels) survive without a full-screen redraw.
+
+#include "ui.h"
+#include "pico/stdlib.h"
+
+#define UI_MAX_DAMAGE 8
+
+typedef struct rect {
+    short x, y, w, h;
+} rect_t;
+
+static widget_t *widgets[UI_MAX_WIDGETS];
+static int widget_count = 0;
+static ui_background_t paint_background = NULL;
+
+// Areas uncovered by a widget moving or hiding, still showing stale pixels
+static rect_t damage[UI_MAX_DAMAGE];
+static int damage_count = 0;
+static bool damage_overflow = false;
+
+static bool rects_overlap(short ax, short ay, short aw, short ah, short bx, short by, short bw, short bh){
+    return ax < bx + bw && bx < ax + aw && ay < by + bh && by < ay + ah;
+}
+
+static void add_damage(short x, short y, short w, short h){
+    if (w <= 0 || h <= 0) return;
+    if (damage_count >= UI_MAX_DAMAGE) { damage_overflow = true; return; }
+    damage[damage_count].x = x; damage[damage_count].y = y;
+    damage[damage_count].w = w; damage[damage_count].h = h;
+    damage_count++;
+}
+
+void ui_init(ui_background_t background){
+    paint_background = background;
+    widget_count = 0;
+    damage_count = 0;
+    damage_overflow = false;
+}
+
+void ui_add(widget_t *w){
+    if (widget_count >= UI_MAX_WIDGETS) return;
+    w->dirty = true;
+    widgets[widget_count++] = w;
+}
+
+void ui_invalidate(widget_t *w){
+    w->dirty = true;
+}
+
+void ui_invalidate_all(){
+    for (int i = 0; i < widget_count; i++) widgets[i]->dirty = true;
+    damage_count = 0;
+    damage_overflow = false;
+}
+
+// Change a widget's bounds, leaving the old area to be repainted
+void ui_move(widget_t *w, short x, short y, short width, short height){
+    if (w->x == x && w->y == y && w->w == width && w->h == height) return;
+    if (w->visible) add_damage(w->x, w->y, w->w, w->h);
+    w->x = x; w->y = y; w->w = width; w->h = height;
+    w->dirty = true;
+}
+
+void ui_set_visible(widget_t *w, bool visible){
+    if (w->visible == visible) return;
+    if (!visible) add_damage(w->x, w->y, w->w, w->h);
+    w->visible = visible;
+    w->dirty = true;
+}
+
+void ui_compose(){
+    if (damage_overflow) {
+        // Lost track of what moved, just repaint everything
+        ui_invalidate_all();
+        if (paint_background) paint_background(0, 0, 320, 240);
+    }
+
+    // Clear the stale areas and flag everything drawn on top of them
+    for (int d = 0; d < damage_count; d++) {
+        rect_t *r = &damage[d];
+        if (paint_background) paint_background(r->x, r->y, r->w, r->h);
+        for (int i = 0; i < widget_count; i++) {
+            widget_t *w = widgets[i];
+            if (w->visible && rects_overlap(r->x, r->y, r->w, r->h, w->x, w->y, w->w, w->h)) w->dirty = true;
+        }
+    }
+    damage_count = 0;
+    damage_overflow = false;
+
+    // A repaint covers whatever is above it, so those need repainting too
+    for (int i = 0; i < widget_count; i++) {
+        widget_t *w = widgets[i];
+        if (!w->visible || !w->dirty) continue;
+        for (int j = i + 1; j < widget_count; j++) {
+            widget_t *o = widgets[j];
+            if (o->visible && rects_overlap(w->x, w->y, w->w, w->h, o->x, o->y, o->w, o->h)) o->dirty = true;
+        }
+    }
+
+    for (int i = 0; i < widget_count; i++) {
+        widget_t *w = widgets[i];
+        if (!w->dirty) continue;
+        w->dirty = false;
+        if (!w->visible) continue;
+        if (!w->opaque && paint_background) paint_background(w->x, w->y, w->w, w->h);
+        w->draw(w);
+    }
+}
@@ -0,0 +1,41 @@
+#ifndef UI_H
+#define UI_H
+
+#include "pico/stdlib.h"
+
+// Retained-mode widgets. Each one knows its own bounds and whether it needs
+// repainting; ui_compose() repaints only the dirty ones.
+
+#define UI_MAX_WIDGETS 48
+
+typedef struct widget widget_t;
+
+typedef void (*widget_draw_t)(widget_t *w);
+
+// Repaints whatever sits underneath the widgets in the given rectangle
+typedef void (*ui_background_t)(short x, short y, short w, short h);
+
+struct widget {
+    short x, y, w, h;
+    bool dirty;
+    bool visible;
+    bool opaque;        // draw() covers its whole rect, no background needed
+    widget_draw_t draw;
+    int id;             // free for the owner, e.g. a menu row index
+};
+
+void ui_init(ui_background_t background);
+
+void ui_add(widget_t *w);
+
+void ui_invalidate(widget_t *w);
+
+void ui_invalidate_all();
+
+void ui_move(widget_t *w, short x, short y, short width, short height);
+
+void ui_set_visible(widget_t *w, bool visible);
+
+void ui_compose();
+
+#endif
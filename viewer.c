@@ -0,0 +1,241 @@
+// Stopped-mode viewer
+// Keeps the zoom/pan state and turns plot columns into sample ranges. The
+// samples themselves come from a source: the deep record's own pyramid, or
+// a copy of the last screen frame with a small pyramid built here.
+
+#include "viewer.h"
+#include "pico/stdlib.h"
+#include <string.h>
+
+#if VIEWER_FRAC_BITS != INTERP_FRAC_BITS
+#error "viewer and interp positions must use the same fraction"
+#endif
+
+#define LEVEL_ENTRIES(l) (VIEWER_FRAME_MAX / (VIEWER_BLOCK << (2 * (l))))
+#define MIP_ENTRIES (LEVEL_ENTRIES(0) + LEVEL_ENTRIES(1) + LEVEL_ENTRIES(2) + LEVEL_ENTRIES(3))
+
+// Frame source
+static uint8_t frame[VIEWER_FRAME_MAX];
+static uint32_t frame_len = 0;
+static uint8_t mip_min[MIP_ENTRIES];
+static uint8_t mip_max[MIP_ENTRIES];
+static uint16_t mip_base[VIEWER_LEVELS];
+
+// Current source
+static uint32_t length = 0;
+static uint32_t trigger = 0;
+static viewer_minmax_t source_minmax = NULL;
+static viewer_sample_t source_sample = NULL;
+static interp_mode_t interp = INTERP_SINC;
+
+// View, in 1/VIEWER_ONE samples
+static int columns = 1;
+static uint32_t step = VIEWER_ONE;  // per column
+static uint32_t start = 0;          // at column 0
+
+static inline uint32_t block_size(int level){
+    return VIEWER_BLOCK << (2 * level);
+}
+
+// Same climb as the deep pyramid: biggest aligned entry that fits each step
+static void frame_minmax(uint32_t a, uint32_t count, uint8_t *lo, uint8_t *hi){
+    uint32_t b = a + count;
+    *lo = 255;
+    *hi = 0;
+    if (b > frame_len) b = frame_len;
+    while (a < b) {
+        int level = -1;
+        for (int l = VIEWER_LEVELS - 1; l >= 0; l--) {
+            uint32_t bs = block_size(l);
+            if (a % bs == 0 && a + bs <= b) { level = l; break; }
+        }
+        if (level < 0) {
+            uint8_t s = frame[a++];
+            if (s < *lo) *lo = s;
+            if (s > *hi) *hi = s;
+        } else {
+            uint32_t e = mip_base[level] + a / block_size(level);
+            if (mip_min[e] < *lo) *lo = mip_min[e];
+            if (mip_max[e] > *hi) *hi = mip_max[e];
+            a += block_size(level);
+        }
+    }
+}
+
+static uint8_t frame_sample(uint32_t index){
+    return frame[index];
+}
+
+void viewer_set_source(uint32_t len, uint32_t trig, viewer_minmax_t minmax, viewer_sample_t sample){
+    length = len;
+    trigger = trig;
+    source_minmax = minmax;
+    source_sample = sample;
+}
+
+void viewer_set_interp(interp_mode_t mode){
+    interp = mode;
+}
+
+// Copy a frame (it keeps getting overwritten while stopped) and index it
+void viewer_load_frame(const uint8_t *samples, uint32_t count, uint32_t trig){
+    if (count > VIEWER_FRAME_MAX) count = VIEWER_FRAME_MAX;
+    memcpy(frame, samples, count);
+    frame_len = count;
+
+    uint16_t base = 0;
+    for (int l = 0; l < VIEWER_LEVELS; l++) {
+        mip_base[l] = base;
+        uint32_t entries = count / block_size(l);
+        for (uint32_t e = 0; e < entries; e++) {
+            uint8_t lo = 255, hi = 0;
+            if (l == 0) {
+                for (int i = 0; i < VIEWER_BLOCK; i++) {
+                    uint8_t s = frame[e * VIEWER_BLOCK + i];
+                    if (s < lo) lo = s;
+                    if (s > hi) hi = s;
+                }
+            } else {
+                uint32_t child = mip_base[l - 1] + e * VIEWER_FANOUT;
+                for (int c = 0; c < VIEWER_FANOUT; c++) {
+                    if (mip_min[child + c] < lo) lo = mip_min[child + c];
+                    if (mip_max[child + c] > hi) hi = mip_max[child + c];
+                }
+            }
+            mip_min[base + e] = lo;
+            mip_max[base + e] = hi;
+        }
+        base += LEVEL_ENTRIES(l);
+    }
+    viewer_set_source(count, trig, frame_minmax, frame_sample);
+}
+
+// Step that fits the whole record across the plot
+static uint32_t fit_step(){
+    uint32_t s = (length * VIEWER_ONE + columns - 1) / columns;
+    return (s < VIEWER_ONE / VIEWER_MAX_COLS_PER_SAMPLE) ? VIEWER_ONE / VIEWER_MAX_COLS_PER_SAMPLE : s;
+}
+
+// Keep the zoom in range and the window inside the record
+static void clamp(){
+    uint32_t min_step = VIEWER_ONE / VIEWER_MAX_COLS_PER_SAMPLE;
+    if (step < min_step) step = min_step;
+    if (step > fit_step()) step = fit_step();
+    uint32_t visible = step * columns;
+    uint32_t total = length * VIEWER_ONE;
+    if (visible >= total) start = 0;
+    else if (start > total - visible) start = total - visible;
+}
+
+void viewer_set_columns(int n){
+    uint32_t center = start + step * (columns / 2);
+    columns = (n < 1) ? 1 : n;
+    uint32_t half = step * (columns / 2);
+    start = (center > half) ? center - half : 0;
+    clamp();
+}
+
+void viewer_set(uint32_t s, uint32_t first){
+    step = s;
+    start = first;
+    clamp();
+}
+
+void viewer_fit(){
+    step = fit_step();
+    start = 0;
+    clamp();
+}
+
+// Halve (in) or double (out) the step per notch, keeping the middle still
+void viewer_zoom(int steps){
+    uint32_t center = start + step * (columns / 2);
+    while (steps > 0 && step > VIEWER_ONE / VIEWER_MAX_COLS_PER_SAMPLE) { step /= 2; steps--; }
+    while (steps < 0 && step < fit_step()) { step *= 2; steps++; }
+    if (step > fit_step()) step = fit_step();
+    uint32_t half = step * (columns / 2);
+    start = (center > half) ? center - half : 0;
+    clamp();
+}
+
+// Positive pans later into the record
+void viewer_pan(int cols){
+    int64_t s = (int64_t)start + (int64_t)cols * step;
+    start = (s < 0) ? 0 : (uint32_t)s;
+    clamp();
+}
+
+uint32_t viewer_step(){
+    return step;
+}
+
+uint32_t viewer_start(){
+    return start;
+}
+
+uint32_t viewer_length(){
+    return length;
+}
+
+uint32_t viewer_trigger(){
+    return trigger;
+}
+
+// Raw samples of whatever is being viewed, for decoding
+uint8_t viewer_sample(uint32_t index){
+    return source_sample ? source_sample(index) : 0;
+}
+
+void viewer_minmax(uint32_t first, uint32_t count, uint8_t *lo, uint8_t *hi){
+    *lo = 255;
+    *hi = 0;
+    if (source_minmax && count) source_minmax(first, count, lo, hi);
+}
+
+// Reconstructed signal at a fractional position, edges held
+static uint8_t value_at(uint32_t pos){
+    uint8_t window[INTERP_TAPS];
+    int first = (int)(pos >> VIEWER_FRAC_BITS) - (INTERP_TAPS / 2 - 1);
+    for (int k = 0; k < INTERP_TAPS; k++) {
+        int j = first + k;
+        window[k] = source_sample((j < 0) ? 0 : (j >= (int)length) ? length - 1 : j);
+    }
+    return interp_point(window, pos & (VIEWER_ONE - 1), interp);
+}
+
+// Min and max for one column, false once it's past the end of the record.
+// A column that starts a new sample also covers the one before, so the
+// spans join up into a trace. trig is set on the first column of the
+// trigger sample.
+bool viewer_column(int column, uint8_t *lo, uint8_t *hi, bool *trig){
+    uint32_t pos = start + column * step;
+    uint32_t a = pos >> VIEWER_FRAC_BITS;
+    uint32_t b = (pos + step) >> VIEWER_FRAC_BITS;
+    if (a >= length || !source_minmax) return false;
+    if (b <= a) b = a + 1;
+    if (b > length) b = length;
+
+    bool first = (column == 0) || (((pos - step) >> VIEWER_FRAC_BITS) != a);
+    *trig = first && trigger >= a && trigger < b;
+
+    // Zoomed in: span from the previous column's point to this one's
+    if (step < VIEWER_ONE && interp != INTERP_NONE && source_sample) {
+        uint8_t v0 = value_at((pos >= step) ? pos - step : pos);
+        uint8_t v1 = value_at(pos);
+        *lo = (v0 < v1) ? v0 : v1;
+        *hi = (v0 < v1) ? v1 : v0;
+        return true;
+    }
+
+    uint32_t from = (first && a > 0) ? a - 1 : a;
+    source_minmax(from, b - from, lo, hi);
+    return true;
+}
+
+// Samples currently on screen, for the overview bar
+void viewer_window(uint32_t *first, uint32_t *count){
+    *first = start >> VIEWER_FRAC_BITS;
+    uint32_t end = (start + step * columns) >> VIEWER_FRAC_BITS;
+    if (end > length) end = length;
+    *count = (end > *first) ? end - *first : 0;
+}
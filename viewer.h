@@ -0,0 +1,62 @@
+#ifndef VIEWER_H
+#define VIEWER_H
+
+#include "pico/stdlib.h"
+#include "adc.h"
+#include "interp.h"
+
+// Stopped-mode viewer
+//
+// Zoom and pan over a finished acquisition. Whatever holds the samples
+// answers min/max queries from a pyramid of block minima and maxima, so a
+// plot column costs about the same at every zoom level. Positions are in
+// samples with VIEWER_FRAC_BITS of fraction, so the view can also zoom in
+// past one sample per column; there the columns are interpolated from the
+// raw samples instead.
+
+#define VIEWER_FRAC_BITS            8
+#define VIEWER_ONE                  (1u << VIEWER_FRAC_BITS)
+#define VIEWER_MAX_COLS_PER_SAMPLE  16
+
+// Pyramid over a copied screen frame
+#define VIEWER_FRAME_MAX    CAPTURE_DEPTH
+#define VIEWER_BLOCK        4       // samples per level 1 entry
+#define VIEWER_FANOUT       4
+#define VIEWER_LEVELS       4       // 4, 16, 64, 256 samples
+
+typedef void (*viewer_minmax_t)(uint32_t start, uint32_t count, uint8_t *lo, uint8_t *hi);
+typedef uint8_t (*viewer_sample_t)(uint32_t index);
+
+void viewer_set_source(uint32_t length, uint32_t trigger, viewer_minmax_t minmax, viewer_sample_t sample);
+
+void viewer_set_interp(interp_mode_t mode);
+
+void viewer_load_frame(const uint8_t *samples, uint32_t count, uint32_t trigger);
+
+void viewer_set_columns(int columns);
+
+void viewer_set(uint32_t step, uint32_t start);
+
+void viewer_fit();
+
+void viewer_zoom(int steps);
+
+void viewer_pan(int columns);
+
+uint32_t viewer_step();
+
+uint32_t viewer_start();
+
+uint32_t viewer_length();
+
+uint32_t viewer_trigger();
+
+uint8_t viewer_sample(uint32_t index);
+
+void viewer_minmax(uint32_t start, uint32_t count, uint8_t *lo, uint8_t *hi);
+
+bool viewer_column(int column, uint8_t *lo, uint8_t *hi, bool *trig);
+
+void viewer_window(uint32_t *first, uint32_t *count);
+
+#endif
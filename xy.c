@@ -0,0 +1,102 @@
+// XY display
+// Even ring slots are the probe (Y), odd ones the second input (X): the ADC
+// restarts on its lowest input whenever the ring does. The pairs are split
+// up in the same loop that maps them to pixels, so the samples are only
+// read once.
+
+#include "xy.h"
+#include "pico/stdlib.h"
+#include "adc.h"
+#include <string.h>
+
+#if CAPTURE_DEPTH % 2
+#error "the ring has to hold whole X/Y pairs"
+#endif
+
+// Code -> pixel, -1 if it's off the plot
+static int16_t columns[256];
+static int16_t rows[256];
+
+// Core 1 sets bits in maps[active], core 0 takes the other one
+static uint32_t maps[2][XY_MAP_WORDS];
+static volatile int active = 0;
+
+static volatile bool enabled = false;
+static volatile uint32_t dropped = 0;
+
+// Core 1 only
+static bool running = false;
+static adc_follower_t follower;
+static uint32_t *pass_map;          // maps[active] when the pass began
+
+void xy_enable(bool on){
+    enabled = on;
+}
+
+// Core 0, whenever the scale or plot width changes. Core 1 can be using
+// them at the time; a point or two lands at the old scale.
+void xy_set_maps(const int16_t *column_of_x, const int16_t *row_of_y){
+    memcpy(columns, column_of_x, sizeof(columns));
+    memcpy(rows, row_of_y, sizeof(rows));
+}
+
+static void __time_critical_func(plot_pairs)(const uint8_t *p, uint count){
+    uint32_t *map = pass_map;
+    uint pairs = count / 2;
+    while (pairs--) {
+        int r = rows[p[0]];
+        int c = columns[p[1]];
+        p += 2;
+        if ((r | c) < 0) continue;
+        uint bit = c * XY_ROWS + r;
+        map[bit >> 5] |= 1u << (bit & 31);
+    }
+}
+
+// Plot whatever pairs the DMA has finished since the last pass. Returns
+// true if it's falling behind and wants to be called again straight away.
+bool xy_service(){
+    if (!enabled) { running = false; return false; }
+
+    if (!running) {
+        adc_follow_start(&follower, 2);
+        running = true;
+        return false;
+    }
+
+    uint32_t lost = adc_follow_lapped(&follower, CAPTURE_DEPTH - XY_LAP_MARGIN);
+    if (lost) {
+        dropped += lost / 2;
+        return false;
+    }
+
+    pass_map = maps[active];
+    return adc_follow(&follower, plot_pairs) > CAPTURE_DEPTH / 2;
+}
+
+// Core 0: swap maps and report every pixel hit since the last drain.
+// Core 1 may finish a pass into the old map after the swap; those points
+// either make this drain or get cleared with it. Returns the pixels lit.
+uint32_t xy_drain(xy_hit_t hit){
+    int full = active;
+    active = full ^ 1;
+    uint32_t *map = maps[full];
+    uint32_t lit = 0;
+    for (int i = 0; i < XY_MAP_WORDS; i++) {
+        uint32_t w = map[i];
+        if (!w) continue;
+        map[i] = 0;
+        while (w) {
+            int b = __builtin_ctz(w);
+            w &= w - 1;
+            uint bit = i * 32 + b;
+            hit(bit / XY_ROWS, bit % XY_ROWS);
+            lit++;
+        }
+    }
+    return lit;
+}
+
+uint32_t xy_dropped(){
+    return dropped;
+}
@@ -0,0 +1,34 @@
+#ifndef XY_H
+#define XY_H
+
+#include "pico/stdlib.h"
+#include "persist.h"
+
+// XY display
+//
+// The ADC takes turns between the probe input (Y) and a second input on
+// GPIO27 (X), so the ring holds the two interleaved at 250 kS/s each. Core
+// 1 follows the ring behind the DMA and turns each pair straight into a
+// pixel through two lookup tables, setting a bit in a hit map. Core 0
+// swaps the map once a frame and hands the hits to the persistence
+// histogram, which already only sends the columns that changed.
+
+#define XY_INPUT        1           // ADC channel for X, GPIO27
+#define XY_COLS         PERSIST_COLS
+#define XY_ROWS         PERSIST_ROWS
+#define XY_MAP_WORDS    ((XY_COLS * XY_ROWS + 31) / 32)
+#define XY_LAP_MARGIN   32          // samples the DMA may get within before we call it lapped
+
+typedef void (*xy_hit_t)(int column, int row);
+
+void xy_enable(bool on);
+
+void xy_set_maps(const int16_t *column_of_x, const int16_t *row_of_y);
+
+bool xy_service();
+
+uint32_t xy_drain(xy_hit_t hit);
+
+uint32_t xy_dropped();
+
+#endif